@@ -11,6 +11,8 @@
 #include <syslog.h>
 #include <unistd.h>
 
+#include "bbox_scheduler.h"
+
 /* ---------------- Animation state ---------------- */
 static double xpos = 0.0;           // current left x (normalized 0..1)
 static const double box_width = 0.1;
@@ -19,8 +21,9 @@ static const double height = 0.1;
 static int dir = -1;                // -1 left, +1 right
 
 /* --------------- Frame timing (FPS) --------------- */
-/* ~30 FPS → 33 ms; 10 FPS → 100 ms */
-#define TICK_MS 33
+/* Speed in frame widths per second, independent of the stream frame rate */
+static const double speed = 0.6;
+static uint64_t last_frame_us = 0;
 
 /* --------------- Global resources ---------------- */
 static GMainLoop* loop = NULL;
@@ -48,10 +51,17 @@ static void clear_all(void) {
 }
 
 /* ----------------- Animation tick ---------------- */
-static gboolean update_bbox(gpointer user_data) {
+/* Called by bbox_scheduler once per displayed frame */
+static void update_bbox(uint64_t frame_time_us, unsigned frames, gpointer user_data) {
+    (void)frames;
     (void)user_data;
 
-    if (!g_bbox) return G_SOURCE_CONTINUE;
+    if (!g_bbox) return;
+
+    // Move by elapsed time, so late or paused frames do not slow the box down
+    double dt = last_frame_us ? (double)(frame_time_us - last_frame_us) / 1e6 : 0.0;
+    last_frame_us = frame_time_us;
+    if (dt > 0.5) dt = 0.0;  // resumed after a pause, continue from where we were
 
     // Enable OSD (no-op if already enabled)
     if (!bbox_video_output(g_bbox, true))
@@ -68,7 +78,7 @@ static gboolean update_bbox(gpointer user_data) {
     bbox_color(g_bbox, yellow);
 
     // Update horizontal position
-    xpos += dir * 0.02;
+    xpos += dir * speed * dt;
     if (xpos + box_width >= 1.0) {
         xpos = 1.0 - box_width;
         dir = -1;
@@ -84,8 +94,7 @@ static gboolean update_bbox(gpointer user_data) {
     if (!bbox_commit(g_bbox, 0u))
         panic("bbox_commit failed: %s", strerror(errno));
 
-    // IMPORTANT: no sleep(). The GLib timer cadence controls FPS.
-    return G_SOURCE_CONTINUE; // keep timer running
+    // IMPORTANT: no sleep(). The scheduler calls us once per frame.
 }
 
 /* ----------------- Signal handler ---------------- */
@@ -121,13 +130,15 @@ int main(void) {
     if (!bbox_video_output(g_bbox, true))
         panic("Failed enabling video-output: %s", strerror(errno));
 
-    // Start animation timer (no blocking sleeps inside update loop)
-    g_timeout_add(TICK_MS, update_bbox, NULL);
+    // Start animating at the stream frame rate, paused while no stream is open
+    if (!bbox_scheduler_start(update_bbox, NULL))
+        panic("Failed starting bbox scheduler");
 
     // Run
     g_main_loop_run(loop);
 
     // Shutdown: clear what we drew and destroy resources
+    bbox_scheduler_stop();
     clear_all();
 
     if (g_bbox) {
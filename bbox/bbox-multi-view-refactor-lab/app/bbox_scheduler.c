@@ -0,0 +1,224 @@
+#include "bbox_scheduler.h"
+
+#include <errno.h>
+#include <glib-unix.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <vdo-error.h>
+#include <vdo-stream.h>
+
+/*
+ * bbox frame scheduler
+ *
+ * Paces bbox updates by the frame rate of the streams that are actually
+ * open. VDO stream events tell which streams exist, a timerfd ticks at the
+ * fastest of their frame rates. The timerfd is periodic in the kernel, so
+ * it does not drift like a re-armed GLib timeout, and it is disarmed
+ * entirely while no stream is open.
+ */
+
+// Used when a stream does not report its frame rate
+#define DEFAULT_FRAMERATE 30.0
+
+static bbox_frame_func frame_func = NULL;
+static gpointer frame_user_data   = NULL;
+
+static VdoStream* event_stream = NULL;
+static guint event_watch_id    = 0;
+static int timer_fd            = -1;
+static guint timer_watch_id    = 0;
+static uint64_t period_ns      = 0;
+
+// Open stream id -> frame rate
+static GHashTable* streams = NULL;
+
+static void update_timer(void) {
+    double framerate = 0.0;
+    GHashTableIter iter;
+    gpointer value = NULL;
+
+    g_hash_table_iter_init(&iter, streams);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+        framerate = MAX(framerate, *(double*)value);
+
+    uint64_t new_period_ns = framerate > 0.0 ? (uint64_t)(1e9 / framerate) : 0;
+    if (new_period_ns == period_ns)
+        return;
+
+    struct itimerspec spec = {0};
+    spec.it_interval.tv_sec  = (time_t)(new_period_ns / 1000000000u);
+    spec.it_interval.tv_nsec = (long)(new_period_ns % 1000000000u);
+    // A zero it_value disarms the timer
+    spec.it_value = spec.it_interval;
+
+    if (timerfd_settime(timer_fd, 0, &spec, NULL) < 0) {
+        syslog(LOG_ERR, "Failed to set frame timer: %s", strerror(errno));
+        return;
+    }
+
+    period_ns = new_period_ns;
+    if (period_ns)
+        syslog(LOG_INFO, "bbox updates paced at %.1f fps", framerate);
+    else
+        syslog(LOG_INFO, "No stream open, bbox updates paused");
+}
+
+static gboolean timer_callback(gint fd, GIOCondition condition, gpointer user_data) {
+    (void)condition;
+    (void)user_data;
+
+    uint64_t expirations = 0;
+    if (read(fd, &expirations, sizeof(expirations)) != (ssize_t)sizeof(expirations))
+        return G_SOURCE_CONTINUE;
+
+    frame_func((uint64_t)g_get_monotonic_time(),
+               (unsigned)MIN(expirations, G_MAXUINT),
+               frame_user_data);
+    return G_SOURCE_CONTINUE;
+}
+
+static void add_stream(unsigned stream_id) {
+    GError* error     = NULL;
+    VdoStream* stream = vdo_stream_get(stream_id, &error);
+    VdoMap* info      = NULL;
+    double* framerate = g_new(double, 1);
+
+    *framerate = DEFAULT_FRAMERATE;
+    if (stream)
+        info = vdo_stream_get_info(stream, &error);
+    if (info)
+        *framerate = vdo_map_get_double(info, "framerate", DEFAULT_FRAMERATE);
+    if (*framerate <= 0.0)
+        *framerate = DEFAULT_FRAMERATE;
+    if (error)
+        syslog(LOG_WARNING,
+               "No info for stream %u, assuming %.0f fps: %s",
+               stream_id,
+               DEFAULT_FRAMERATE,
+               error->message);
+
+    g_hash_table_replace(streams, GUINT_TO_POINTER(stream_id), framerate);
+
+    g_clear_error(&error);
+    if (info)
+        g_object_unref(info);
+    if (stream)
+        g_object_unref(stream);
+}
+
+static gboolean stream_event_callback(gint fd, GIOCondition condition, gpointer user_data) {
+    (void)fd;
+    (void)user_data;
+
+    if (condition & (G_IO_ERR | G_IO_HUP)) {
+        syslog(LOG_ERR, "Connection to VDO was broken, bbox updates paused");
+        g_hash_table_remove_all(streams);
+        update_timer();
+        event_watch_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    GError* error = NULL;
+    VdoMap* event = vdo_stream_get_event(event_stream, &error);
+    if (!event) {
+        if (!g_error_matches(error, VDO_ERROR, VDO_ERROR_NO_EVENT))
+            syslog(LOG_WARNING, "Failed to get VDO stream event: %s", error->message);
+        g_clear_error(&error);
+        return G_SOURCE_CONTINUE;
+    }
+
+    unsigned event_type = vdo_map_get_uint32(event, "event", 0);
+    unsigned stream_id  = vdo_map_get_uint32(event, "id", 0);
+
+    switch (event_type) {
+        case VDO_STREAM_EVENT_EXISTING:
+        case VDO_STREAM_EVENT_CREATED:
+        case VDO_STREAM_EVENT_STARTED:
+            add_stream(stream_id);
+            break;
+        case VDO_STREAM_EVENT_STOPPED:
+        case VDO_STREAM_EVENT_CLOSED:
+            g_hash_table_remove(streams, GUINT_TO_POINTER(stream_id));
+            break;
+        default:
+            break;
+    }
+    update_timer();
+
+    g_object_unref(event);
+    return G_SOURCE_CONTINUE;
+}
+
+/**
+ * Start calling frame_func once per displayed frame.
+ */
+bool bbox_scheduler_start(bbox_frame_func func, gpointer user_data) {
+    GError* error  = NULL;
+    VdoMap* filter = NULL;
+    bool ok        = false;
+
+    frame_func      = func;
+    frame_user_data = user_data;
+    streams         = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0) {
+        syslog(LOG_ERR, "Failed to create frame timer: %s", strerror(errno));
+        goto out;
+    }
+    timer_watch_id = g_unix_fd_add(timer_fd, G_IO_IN, timer_callback, NULL);
+
+    // Stream 0 delivers events about all other streams
+    event_stream = vdo_stream_get(0, &error);
+    if (!event_stream) {
+        syslog(LOG_ERR, "Failed to open VDO event stream: %s", error->message);
+        goto out;
+    }
+
+    filter = vdo_map_new();
+    vdo_map_set_string(filter, "filter", "overlay");
+    if (!vdo_stream_attach(event_stream, filter, &error)) {
+        syslog(LOG_ERR, "Failed to attach VDO overlay filter: %s", error->message);
+        goto out;
+    }
+
+    int event_fd = vdo_stream_get_event_fd(event_stream, &error);
+    if (event_fd < 0) {
+        syslog(LOG_ERR, "Failed to get VDO event fd: %s", error->message);
+        goto out;
+    }
+    event_watch_id =
+        g_unix_fd_add(event_fd, G_IO_IN | G_IO_ERR | G_IO_HUP, stream_event_callback, NULL);
+    ok = true;
+
+out:
+    g_clear_error(&error);
+    if (filter)
+        g_object_unref(filter);
+    if (!ok)
+        bbox_scheduler_stop();
+    return ok;
+}
+
+void bbox_scheduler_stop(void) {
+    if (event_watch_id)
+        g_source_remove(event_watch_id);
+    event_watch_id = 0;
+    if (event_stream)
+        g_object_unref(event_stream);
+    event_stream = NULL;
+
+    if (timer_watch_id)
+        g_source_remove(timer_watch_id);
+    timer_watch_id = 0;
+    if (timer_fd >= 0)
+        close(timer_fd);
+    timer_fd  = -1;
+    period_ns = 0;
+
+    if (streams)
+        g_hash_table_unref(streams);
+    streams = NULL;
+}
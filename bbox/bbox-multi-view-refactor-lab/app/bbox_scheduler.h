@@ -0,0 +1,16 @@
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Called once per displayed frame. frame_time_us is the monotonic time of
+ * the frame and frames is how many frame periods passed since the last
+ * call, more than one if the main loop was late. All bbox updates for the
+ * frame are expected to go into one commit.
+ */
+typedef void (*bbox_frame_func)(uint64_t frame_time_us, unsigned frames, gpointer user_data);
+
+bool bbox_scheduler_start(bbox_frame_func frame_func, gpointer user_data);
+void bbox_scheduler_stop(void);
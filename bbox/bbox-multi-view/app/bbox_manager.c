@@ -0,0 +1,259 @@
+#include "bbox_manager.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#define BBOX_MANAGER_MAX_SETS 8u
+
+// Style as requested by the app. bbox_color_from_rgb() is slow, so the
+// converted color is kept next to the rgb value it was made from.
+struct style_state {
+    enum bbox_manager_style style;
+    enum bbox_manager_thickness thickness;
+    uint32_t rgb;
+    bbox_color_t color;
+};
+
+struct bbox_set {
+    uint32_t view_mask;
+    bbox_t* bbox;
+
+    struct style_state style;
+    // Set when the style changed since the last commit
+    bool style_dirty;
+
+    // Boxes built since bbox_set_begin() and boxes currently on screen
+    struct bbox_manager_box pending[BBOX_MANAGER_MAX_BOXES];
+    size_t pending_count;
+    struct bbox_manager_box committed[BBOX_MANAGER_MAX_BOXES];
+    size_t committed_count;
+    bool has_committed;
+};
+
+static struct bbox_set sets[BBOX_MANAGER_MAX_SETS];
+static size_t num_sets = 0;
+
+static unsigned long commits   = 0;
+static unsigned long skipped   = 0;
+static unsigned long overflows = 0;
+
+static bbox_t* create_handle(size_t num_views, const unsigned* views) {
+    // bbox_new() is variadic, so each view count needs its own call
+    switch (num_views) {
+        case 1:
+            return bbox_view_new(views[0]);
+        case 2:
+            return bbox_new(2u, views[0], views[1]);
+        case 3:
+            return bbox_new(3u, views[0], views[1], views[2]);
+        case 4:
+            return bbox_new(4u, views[0], views[1], views[2], views[3]);
+        case 5:
+            return bbox_new(5u, views[0], views[1], views[2], views[3], views[4]);
+        case 6:
+            return bbox_new(6u, views[0], views[1], views[2], views[3], views[4], views[5]);
+        case 7:
+            return bbox_new(7u, views[0], views[1], views[2], views[3], views[4], views[5], views[6]);
+        case 8:
+            return bbox_new(8u,
+                            views[0],
+                            views[1],
+                            views[2],
+                            views[3],
+                            views[4],
+                            views[5],
+                            views[6],
+                            views[7]);
+        default:
+            errno = EINVAL;
+            return NULL;
+    }
+}
+
+/**
+ * Return the persistent handle for a set of views, creating it on first use.
+ *
+ * The same views in any order give the same handle. The handle has video
+ * output enabled and stays alive until bbox_manager_destroy_all().
+ */
+bbox_set_t* bbox_manager_get(size_t num_views, const unsigned* views) {
+    uint32_t view_mask = 0;
+
+    if (num_views == 0 || num_views > BBOX_MANAGER_MAX_VIEWS) {
+        errno = EINVAL;
+        return NULL;
+    }
+    for (size_t i = 0; i < num_views; i++) {
+        if (views[i] < 1 || views[i] > BBOX_MANAGER_MAX_VIEWS) {
+            errno = EINVAL;
+            return NULL;
+        }
+        view_mask |= 1u << (views[i] - 1);
+    }
+
+    for (size_t i = 0; i < num_sets; i++) {
+        if (sets[i].view_mask == view_mask)
+            return &sets[i];
+    }
+
+    if (num_sets == BBOX_MANAGER_MAX_SETS) {
+        errno = ENOSPC;
+        return NULL;
+    }
+
+    bbox_t* bbox = create_handle(num_views, views);
+    if (!bbox)
+        return NULL;
+
+    if (!bbox_video_output(bbox, true)) {
+        int saved_errno = errno;
+        bbox_destroy(bbox);
+        errno = saved_errno;
+        return NULL;
+    }
+
+    struct bbox_set* set = &sets[num_sets++];
+    memset(set, 0, sizeof(*set));
+    set->view_mask   = view_mask;
+    set->bbox        = bbox;
+    set->style_dirty = true;
+    bbox_set_style(set, BBOX_MANAGER_STYLE_OUTLINE, BBOX_MANAGER_THICKNESS_THIN, 0xff, 0x00, 0x00);
+
+    syslog(LOG_INFO, "Created bbox handle for view mask 0x%x", view_mask);
+    return set;
+}
+
+/**
+ * Clear and destroy all handles. Used on shutdown.
+ */
+void bbox_manager_destroy_all(void) {
+    for (size_t i = 0; i < num_sets; i++) {
+        if (!bbox_clear(sets[i].bbox) || !bbox_commit(sets[i].bbox, 0u))
+            syslog(LOG_ERR, "Failed clearing view mask 0x%x: %s", sets[i].view_mask, strerror(errno));
+        bbox_destroy(sets[i].bbox);
+    }
+    num_sets = 0;
+    bbox_manager_log_stats();
+}
+
+void bbox_manager_log_stats(void) {
+    syslog(LOG_INFO,
+           "bbox manager: %lu commits, %lu unchanged frames skipped, %lu boxes dropped",
+           commits,
+           skipped,
+           overflows);
+}
+
+/**
+ * Select style, thickness and color for the next commit.
+ *
+ * Calling this every frame with the same values is cheap. The color is only
+ * converted and the frame only marked changed when a value differs.
+ */
+void bbox_set_style(bbox_set_t* set,
+                    enum bbox_manager_style style,
+                    enum bbox_manager_thickness thickness,
+                    uint8_t r,
+                    uint8_t g,
+                    uint8_t b) {
+    uint32_t rgb = ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+
+    if (!set->style_dirty && set->style.style == style && set->style.thickness == thickness &&
+        set->style.rgb == rgb)
+        return;
+
+    if (set->style_dirty || set->style.rgb != rgb)
+        set->style.color = bbox_color_from_rgb(r, g, b);
+    set->style.style     = style;
+    set->style.thickness = thickness;
+    set->style.rgb       = rgb;
+    set->style_dirty     = true;
+}
+
+/**
+ * Start building the next frame. Nothing is sent to bbox until commit.
+ */
+void bbox_set_begin(bbox_set_t* set) {
+    set->pending_count = 0;
+}
+
+bool bbox_set_rectangle(bbox_set_t* set, double x1, double y1, double x2, double y2) {
+    if (set->pending_count == BBOX_MANAGER_MAX_BOXES) {
+        overflows++;
+        return false;
+    }
+
+    set->pending[set->pending_count++] = (struct bbox_manager_box){x1, y1, x2, y2};
+    return true;
+}
+
+static void apply_style(bbox_set_t* set) {
+    if (set->style.style == BBOX_MANAGER_STYLE_CORNERS)
+        bbox_style_corners(set->bbox);
+    else
+        bbox_style_outline(set->bbox);
+
+    switch (set->style.thickness) {
+        case BBOX_MANAGER_THICKNESS_MEDIUM:
+            bbox_thickness_medium(set->bbox);
+            break;
+        case BBOX_MANAGER_THICKNESS_THICK:
+            bbox_thickness_thick(set->bbox);
+            break;
+        case BBOX_MANAGER_THICKNESS_THIN:
+        default:
+            bbox_thickness_thin(set->bbox);
+            break;
+    }
+
+    bbox_color(set->bbox, set->style.color);
+}
+
+/**
+ * Show the frame built since bbox_set_begin().
+ *
+ * The frame is compared against the last committed one. When boxes and
+ * style are the same no bbox call is made at all, so a static scene costs
+ * no overlay IPC.
+ *
+ * return false if bbox failed, errno is set.
+ */
+bool bbox_set_commit(bbox_set_t* set) {
+    if (set->has_committed && !set->style_dirty && set->pending_count == set->committed_count &&
+        memcmp(set->pending, set->committed, set->pending_count * sizeof(set->pending[0])) == 0) {
+        skipped++;
+        return true;
+    }
+
+    if (!bbox_clear(set->bbox))
+        return false;
+
+    apply_style(set);
+    for (size_t i = 0; i < set->pending_count; i++) {
+        const struct bbox_manager_box* box = &set->pending[i];
+        bbox_rectangle(set->bbox, box->x1, box->y1, box->x2, box->y2);
+    }
+
+    if (!bbox_commit(set->bbox, 0u)) {
+        // Unknown what is on screen now, make sure the next commit goes out
+        set->has_committed = false;
+        return false;
+    }
+
+    memcpy(set->committed, set->pending, set->pending_count * sizeof(set->pending[0]));
+    set->committed_count = set->pending_count;
+    set->has_committed   = true;
+    set->style_dirty     = false;
+    commits++;
+    return true;
+}
+
+/**
+ * Remove all boxes from the views of this set.
+ */
+bool bbox_set_clear(bbox_set_t* set) {
+    bbox_set_begin(set);
+    return bbox_set_commit(set);
+}
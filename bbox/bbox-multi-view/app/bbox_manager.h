@@ -0,0 +1,46 @@
+#pragma once
+
+#include <bbox.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Views are numbered 1..BBOX_MANAGER_MAX_VIEWS
+#define BBOX_MANAGER_MAX_VIEWS 8u
+#define BBOX_MANAGER_MAX_BOXES 64u
+
+enum bbox_manager_style {
+    BBOX_MANAGER_STYLE_OUTLINE,
+    BBOX_MANAGER_STYLE_CORNERS,
+};
+
+enum bbox_manager_thickness {
+    BBOX_MANAGER_THICKNESS_THIN,
+    BBOX_MANAGER_THICKNESS_MEDIUM,
+    BBOX_MANAGER_THICKNESS_THICK,
+};
+
+struct bbox_manager_box {
+    double x1;
+    double y1;
+    double x2;
+    double y2;
+};
+
+// One persistent bbox handle for a fixed set of views
+typedef struct bbox_set bbox_set_t;
+
+bbox_set_t* bbox_manager_get(size_t num_views, const unsigned* views);
+void bbox_manager_destroy_all(void);
+void bbox_manager_log_stats(void);
+
+void bbox_set_style(bbox_set_t* set,
+                    enum bbox_manager_style style,
+                    enum bbox_manager_thickness thickness,
+                    uint8_t r,
+                    uint8_t g,
+                    uint8_t b);
+void bbox_set_begin(bbox_set_t* set);
+bool bbox_set_rectangle(bbox_set_t* set, double x1, double y1, double x2, double y2);
+bool bbox_set_commit(bbox_set_t* set);
+bool bbox_set_clear(bbox_set_t* set);
@@ -12,12 +12,20 @@
 #include <syslog.h>
 #include <unistd.h>
 
+#include "bbox_manager.h"
+#include "bbox_scheduler.h"
+
 
 static double xpos = 0.0;  // starting x position
 static const double box_width = 0.1;
 static const double y = 0.3;
 static const double height = 0.1;
 static int dir = -1;
+// Frame widths per second, and how long the box rests at each edge
+static const double speed = 0.2;
+static const uint64_t edge_pause_us = 2000000;
+static uint64_t pause_until_us = 0;
+static uint64_t last_frame_us = 0;
 
 
 
@@ -32,74 +40,55 @@ panic(const char* format, ...) {
 }
 
 
-static gboolean update_bbox(gpointer user_data) {
+// Called by bbox_scheduler once per displayed frame
+static void update_bbox(uint64_t frame_time_us, unsigned frames, gpointer user_data) {
+    (void)frames;
     (void)user_data;
 
-    // Draw on a multiple views - 4 (4u): 1(1u), 2(2u), 3(3u) and 4(4u)
-    bbox_t* bbox = bbox_new(3u, 1u, 2u, 3u);
-    if (!bbox)
+    // Move by elapsed time, a long gap means updates were paused
+    double dt = last_frame_us ? (double)(frame_time_us - last_frame_us) / 1e6 : 0.0;
+    last_frame_us = frame_time_us;
+    if (dt > 0.5)
+        dt = 0.0;
+
+    // Draw on multiple views - 3 (3u): 1(1u), 2(2u) and 3(3u). The manager
+    // creates the handle on the first call and returns the same one after.
+    static const unsigned views[] = {1u, 2u, 3u};
+    bbox_set_t* set = bbox_manager_get(G_N_ELEMENTS(views), views);
+    if (!set)
         panic("Failed creating: %s", strerror(errno));
 
-    if (!bbox_video_output(bbox, true))
-    panic("Failed enabling video-output: %s", strerror(errno));
-    
-    //bbox_coordinates_frame_normalized(bbox);
-
-    bbox_clear(bbox);  // Remove all old bounding-boxes
-
-    // Create all needed colors [These operations are slow!]
-    //const bbox_color_t red   = bbox_color_from_rgb(0xff, 0x00, 0x00);
-    //const bbox_color_t blue  = bbox_color_from_rgb(0x00, 0x00, 0xff);
-    //const bbox_color_t green = bbox_color_from_rgb(0x00, 0xff, 0x00);
-    const bbox_color_t yellow = bbox_color_from_rgb(0xff, 0xff, 0x00);  // Yellow
-
-    bbox_style_corners(bbox);                      
-    bbox_thickness_medium(bbox);                     
-    bbox_color(bbox, yellow);                         
-
-    xpos += dir * 0.02;
-
-    // Change direction at bounds
-    if (xpos + box_width >= 1.0) {
-        xpos = 1.0 - box_width;  // clamp
-        dir = -1;  // switch to left
-    } else if (xpos <= 0.0) {
-        xpos = 0.0;
-        dir = 1;  // switch to right
+    // Same values every tick, so this is only converted once
+    bbox_set_style(set, BBOX_MANAGER_STYLE_CORNERS, BBOX_MANAGER_THICKNESS_MEDIUM, 0xff, 0xff, 0x00);
+
+    if (frame_time_us < pause_until_us) {
+        // Box stands still, the commit below finds nothing changed
+    } else {
+        xpos += dir * speed * dt;
+
+        // Change direction at bounds, and rest there for a while
+        if (xpos + box_width >= 1.0) {
+            xpos           = 1.0 - box_width;  // clamp
+            dir            = -1;               // switch to left
+            pause_until_us = frame_time_us + edge_pause_us;
+        } else if (xpos <= 0.0) {
+            xpos           = 0.0;
+            dir            = 1;  // switch to right
+            pause_until_us = frame_time_us + edge_pause_us;
+        }
     }
 
-    bbox_rectangle(bbox, xpos, y, xpos + box_width, y + height);
+    bbox_set_begin(set);
+    bbox_set_rectangle(set, xpos, y, xpos + box_width, y + height);
 
-    // Draw all queued geometry simultaneously
-    if (!bbox_commit(bbox, 0u))
+    // Draw all queued geometry simultaneously, skipped if nothing changed
+    if (!bbox_set_commit(set))
         panic("Failed committing: %s", strerror(errno));
-
-    sleep(1);
-    bbox_destroy(bbox);
-    
-    return G_SOURCE_CONTINUE;  // keep the timer running
 }
 
-static void clear(void) {
-    // Draw on a single channel: 1
-    bbox_t* bbox = bbox_new(1u, 1u);
-    if (!bbox)
-        panic("Failed creating: %s", strerror(errno));
-
-    bbox_clear(bbox);  // Remove all old bounding-boxes
-
-    // Clear everything simultaneously
-    if (!bbox_commit(bbox, 0u))
-        panic("Failed committing: %s", strerror(errno));
-
-    
-    sleep(1);
-    bbox_destroy(bbox);
-}
 static gboolean signal_handler(gpointer loop) {
     g_main_loop_quit((GMainLoop*)loop);
-    
-    clear();
+
     syslog(LOG_INFO, "Application was stopped by SIGTERM or SIGINT.");
 
     return G_SOURCE_REMOVE;
@@ -114,13 +103,16 @@ int main(void) {
     g_unix_signal_add(SIGTERM, signal_handler, loop);
     g_unix_signal_add(SIGINT, signal_handler, loop);
 
-    // Add update loop every 100ms
-    g_timeout_add(100, update_bbox, NULL);
-    
+    // Update once per displayed frame, paused while no stream is open
+    if (!bbox_scheduler_start(update_bbox, NULL))
+        panic("Failed starting bbox scheduler");
 
     g_main_loop_run(loop);
 
-    clear();
+    bbox_scheduler_stop();
+
+    // Remove the boxes from every view and destroy the handles
+    bbox_manager_destroy_all();
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,146 @@
+/*
+ * Coalescing data event publisher
+ *
+ * A sensor read at 100 Hz would otherwise mean 100 key/value sets, 100
+ * events and 100 deliveries to every subscriber per second. Here an update
+ * is a store into an array. The window timer decides whether anything
+ * changed enough to be worth an event, writes only the changed values into
+ * the key/value set that was allocated at start, and sends one event.
+ */
+#include "data_publisher.h"
+
+#include <math.h>
+#include <syslog.h>
+
+typedef struct {
+  gdouble current;  // newest value, written by every update
+  gdouble sent;     // value in the key/value set, last published
+  gboolean has_value;
+  gboolean has_sent;
+} FieldState;
+
+struct DataPublisher {
+  AXEventHandler *event_handler;
+  guint event_id;
+  const DataField *fields;
+  gsize num_fields;
+  FieldState *state;
+  AXEventKeyValueSet *key_value_set;
+  guint timer;
+
+  guint64 updates;
+  guint64 sent;
+  guint64 suppressed;
+};
+
+static gboolean field_changed(const DataField *field, const FieldState *state) {
+  if (!state->has_value) return FALSE;
+  if (!state->has_sent) return TRUE;
+  return fabs(state->current - state->sent) > field->deadband;
+}
+
+/* Write the value into the set, replacing the one that is there */
+static gboolean store_value(DataPublisher *publisher, gsize i) {
+  const DataField *field = &publisher->fields[i];
+  GError *error = NULL;
+  gboolean ok;
+
+  if (field->type == AX_VALUE_TYPE_INT) {
+    gint value = lround(publisher->state[i].current);
+    ok = ax_event_key_value_set_add_key_value(publisher->key_value_set, field->key, NULL,
+                                              &value, AX_VALUE_TYPE_INT, &error);
+  } else {
+    gdouble value = publisher->state[i].current;
+    ok = ax_event_key_value_set_add_key_value(publisher->key_value_set, field->key, NULL,
+                                              &value, AX_VALUE_TYPE_DOUBLE, &error);
+  }
+
+  if (!ok) {
+    syslog(LOG_WARNING, "Could not update %s: %s", field->key, error ? error->message : "unknown");
+    g_clear_error(&error);
+  }
+  return ok;
+}
+
+static gboolean publish_window(gpointer data) {
+  DataPublisher *publisher = data;
+  gboolean changed = FALSE;
+
+  for (gsize i = 0; i < publisher->num_fields; i++) {
+    if (!field_changed(&publisher->fields[i], &publisher->state[i])) continue;
+    if (store_value(publisher, i)) {
+      publisher->state[i].sent = publisher->state[i].current;
+      publisher->state[i].has_sent = TRUE;
+      changed = TRUE;
+    }
+  }
+
+  if (!changed) {
+    publisher->suppressed++;
+    return G_SOURCE_CONTINUE;
+  }
+
+  // Fields that did not change keep the value they were last sent with
+  AXEvent *event = ax_event_new2(publisher->key_value_set, NULL);
+  GError *error = NULL;
+  if (!ax_event_handler_send_event(publisher->event_handler, publisher->event_id, event, &error)) {
+    syslog(LOG_CRIT, "Could not send data event: %s", error ? error->message : "unknown");
+    g_clear_error(&error);
+  } else {
+    publisher->sent++;
+  }
+  ax_event_free(event);
+
+  return G_SOURCE_CONTINUE;
+}
+
+DataPublisher *data_publisher_new(AXEventHandler *event_handler,
+                                  guint event_id,
+                                  const DataField *fields,
+                                  gsize num_fields,
+                                  guint window_ms) {
+  DataPublisher *publisher = g_new0(DataPublisher, 1);
+
+  publisher->event_handler = event_handler;
+  publisher->event_id = event_id;
+  publisher->fields = fields;
+  publisher->num_fields = num_fields;
+  publisher->state = g_new0(FieldState, num_fields);
+
+  // Every field gets a slot now, so publishing never adds keys
+  publisher->key_value_set = ax_event_key_value_set_new();
+  for (gsize i = 0; i < num_fields; i++) store_value(publisher, i);
+
+  publisher->timer = g_timeout_add(window_ms, publish_window, publisher);
+  return publisher;
+}
+
+void data_publisher_free(DataPublisher *publisher) {
+  if (!publisher) return;
+
+  if (publisher->timer) g_source_remove(publisher->timer);
+  ax_event_key_value_set_free(publisher->key_value_set);
+  g_free(publisher->state);
+  g_free(publisher);
+}
+
+void data_publisher_set_double(DataPublisher *publisher, gsize field, gdouble value) {
+  if (field >= publisher->num_fields) return;
+
+  publisher->state[field].current = value;
+  publisher->state[field].has_value = TRUE;
+  publisher->updates++;
+}
+
+void data_publisher_set_int(DataPublisher *publisher, gsize field, gint value) {
+  data_publisher_set_double(publisher, field, value);
+}
+
+void data_publisher_get_stats(const DataPublisher *publisher,
+                              guint64 *updates,
+                              guint64 *sent,
+                              guint64 *suppressed) {
+  *updates = publisher->updates;
+  *sent = publisher->sent;
+  *suppressed = publisher->suppressed;
+}
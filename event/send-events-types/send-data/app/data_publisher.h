@@ -0,0 +1,37 @@
+#pragma once
+
+#include <axsdk/axevent.h>
+#include <glib.h>
+
+/*
+ * Publishes a declared data event from values that are updated much more
+ * often than they should be sent. Updates only store the newest value. Once
+ * per window the values are compared with what was last sent, and an event
+ * is sent only if one of them moved by more than its deadband.
+ *
+ * The key/value set is allocated once and updated in place.
+ * Use from the GLib main loop thread only.
+ */
+typedef struct {
+  const gchar *key;
+  AXEventValueType type;  // AX_VALUE_TYPE_DOUBLE or AX_VALUE_TYPE_INT
+  gdouble deadband;       // change needed before the value is sent again
+} DataField;
+
+typedef struct DataPublisher DataPublisher;
+
+DataPublisher *data_publisher_new(AXEventHandler *event_handler,
+                                  guint event_id,
+                                  const DataField *fields,
+                                  gsize num_fields,
+                                  guint window_ms);
+void data_publisher_free(DataPublisher *publisher);
+
+void data_publisher_set_double(DataPublisher *publisher, gsize field, gdouble value);
+void data_publisher_set_int(DataPublisher *publisher, gsize field, gint value);
+
+// Counts since start: updates received, events sent, windows with nothing worth sending
+void data_publisher_get_stats(const DataPublisher *publisher,
+                              guint64 *updates,
+                              guint64 *sent,
+                              guint64 *suppressed);
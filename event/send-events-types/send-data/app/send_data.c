@@ -6,6 +6,8 @@
 #include <glib-object.h>
 #include <glib.h>
 
+#include "data_publisher.h"
+
 #define LOG(fmt, args...)    { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args); }
 #define LOG_ERROR(fmt, args...)    { syslog(LOG_CRIT, fmt, ## args); printf(fmt, ## args); }
 
@@ -20,10 +22,25 @@
 
 #define TOTAL_MEMORY 500 // Simulate total memory (e.g. 500MB)
 
+#define SAMPLE_INTERVAL_MS 10    // simulated sensor read at 100 Hz
+#define PUBLISH_WINDOW_MS  1000  // at most one event per window
+#define STATS_INTERVAL_S   60
+
+// Fields of the data event, in the order of the FIELD_ indexes
+static const DataField data_fields[] = {
+  {"Temperature", AX_VALUE_TYPE_DOUBLE, 0.5},  // deadband 0.5 degrees
+  {"Load",        AX_VALUE_TYPE_DOUBLE, 0.1},
+  {"UsedMemory",  AX_VALUE_TYPE_INT,    5.0},  // MB
+  {"FreeMemory",  AX_VALUE_TYPE_INT,    5.0},
+};
+enum { FIELD_TEMPERATURE, FIELD_LOAD, FIELD_USED_MEMORY, FIELD_FREE_MEMORY };
+
 typedef struct {
   AXEventHandler *event_handler;
   guint event_id;
   guint timer;
+  guint stats_timer;
+  DataPublisher *publisher;
   gdouble temperature;
   gdouble load;
   guint free_memory;
@@ -32,79 +49,56 @@ typedef struct {
 
 static AppData* app_data = NULL;
 
+// Move value by up to max_step in either direction, within [min, max]
+static gdouble random_step(gdouble value, gdouble max_step, gdouble min, gdouble max) {
+
+  value += max_step * ((rand() % 2001) / 1000.0 - 1.0);
+  return CLAMP(value, min, max);
+}
+
 static void generate_random_data(AppData *app_data) {
 
-  // Simulate temperature between 20.0 and 80.0 degrees Celsius
-  app_data->temperature = 20.0 + (rand() % 6000) / 100.0;  // 20.0 to 80.0
+  // Readings drift like a real sensor instead of jumping on every sample
 
-  // Simulate system load as a float between 0.0 and 4.0 (e.g. CPU load avg)
-  app_data->load = (rand() % 400) / 100.0;
+  // Temperature between 20.0 and 80.0 degrees Celsius
+  app_data->temperature = random_step(app_data->temperature, 0.05, 20.0, 80.0);
 
-  
+  // System load as a float between 0.0 and 4.0 (e.g. CPU load avg)
+  app_data->load = random_step(app_data->load, 0.01, 0.0, 4.0);
 
-  // Simulate used memory between 0 and total
-  app_data->used_memory = rand() % TOTAL_MEMORY;
-  
-  // Free memory is the rest
+  // Used memory between 0 and total, free memory is the rest
+  gdouble used_memory = random_step(app_data->used_memory, 1.0, 0.0, TOTAL_MEMORY);
+  app_data->used_memory = (guint)(used_memory + 0.5);
   app_data->free_memory = TOTAL_MEMORY - app_data->used_memory;
-
-  LOG("used memory: %u MB, free memory: %u MB\n", app_data->used_memory, app_data->free_memory);
 }
 
+/*
+ * Called for every sample. The publisher only stores the values and sends
+ * one event per window, and only when a value moved past its deadband.
+ */
 static gboolean send_data(AppData *send_data) {
 
-  AXEventKeyValueSet *key_value_set = NULL;
-  AXEvent *event = NULL;
-
   generate_random_data(send_data);
-  key_value_set = ax_event_key_value_set_new();
 
-  // Add the variable elements of the event to the set
-    
-    if(!ax_event_key_value_set_add_key_value(key_value_set, "Temperature", NULL,
-                                         &send_data->temperature,
-                                         AX_VALUE_TYPE_DOUBLE, NULL)) {
-        syslog(LOG_WARNING, "Could not add temperature key/value pair");
-    }                                        
-    if(!ax_event_key_value_set_add_key_value(key_value_set, "Load", NULL,
-                                       &send_data->load, AX_VALUE_TYPE_DOUBLE,
-                                       NULL)) {
-        syslog(LOG_WARNING, "Could not add load key/value pair");
-    }
-  
-    if(!ax_event_key_value_set_add_key_value(key_value_set, "UsedMemory", NULL,
-                                        &send_data->used_memory, AX_VALUE_TYPE_INT,
-                                        NULL)) {
-        syslog(LOG_WARNING, "Could not add used memory key/value pair");
-    }
-
-    if(!ax_event_key_value_set_add_key_value(key_value_set, "FreeMemory", NULL,
-                                        &send_data->free_memory, AX_VALUE_TYPE_INT,
-                                        NULL)) {
-        syslog(LOG_WARNING, "Could not add free memory key/value pair");
-    }
-
-  // Create the event
-  event = ax_event_new2(key_value_set, NULL);
-
-  // The key/value set is no longer needed
-  ax_event_key_value_set_free(key_value_set);
-
-  if (!ax_event_handler_send_event(send_data->event_handler, 
-                                        send_data->event_id, 
-                                        event, 
-                                        NULL)) {
-    LOG_ERROR("Could not fire event\n");
-  }
-  else
-    LOG("sent data event");
-
-  ax_event_free(event);
+  data_publisher_set_double(send_data->publisher, FIELD_TEMPERATURE, send_data->temperature);
+  data_publisher_set_double(send_data->publisher, FIELD_LOAD, send_data->load);
+  data_publisher_set_int(send_data->publisher, FIELD_USED_MEMORY, (gint)send_data->used_memory);
+  data_publisher_set_int(send_data->publisher, FIELD_FREE_MEMORY, (gint)send_data->free_memory);
 
   // Returning TRUE keeps the timer going
   return TRUE;
 }
 
+static gboolean log_stats(AppData *app_data) {
+
+  guint64 updates, sent, suppressed;
+
+  data_publisher_get_stats(app_data->publisher, &updates, &sent, &suppressed);
+  LOG("%" G_GUINT64_FORMAT " updates, %" G_GUINT64_FORMAT " events sent, %" G_GUINT64_FORMAT " windows without change\n",
+      updates, sent, suppressed);
+  return TRUE;
+}
+
 static void declaration_complete(guint declaration, gdouble *start_value) {
 
     LOG("Declaration complete for: %d\n", declaration);
@@ -121,8 +115,13 @@ static void declaration_complete(guint declaration, gdouble *start_value) {
         app_data->used_memory,
         app_data->free_memory);
 
-    // timer to be called every 3th second
-    app_data->timer = g_timeout_add_seconds(3, (GSourceFunc)send_data, app_data);
+    app_data->publisher = data_publisher_new(app_data->event_handler, app_data->event_id,
+                                             data_fields, G_N_ELEMENTS(data_fields),
+                                             PUBLISH_WINDOW_MS);
+
+    // Sample at sensor rate, the publisher decides what is sent
+    app_data->timer = g_timeout_add(SAMPLE_INTERVAL_MS, (GSourceFunc)send_data, app_data);
+    app_data->stats_timer = g_timeout_add_seconds(STATS_INTERVAL_S, (GSourceFunc)log_stats, app_data);
 
 }
 
@@ -219,6 +218,7 @@ int main(void) {
       g_main_loop_run(main_loop);
 
       /// Cleanup event handler
+      data_publisher_free(app_data->publisher);
       ax_event_handler_undeclare(app_data->event_handler, app_data->event_id, NULL);
       ax_event_handler_free(app_data->event_handler);
       free(app_data);
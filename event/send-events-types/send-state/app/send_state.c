@@ -1,10 +1,13 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <syslog.h>
 #include <time.h>
 #include <axsdk/axevent.h>
 #include <glib-object.h>
 #include <glib.h>
 
+#include "state_publisher.h"
+
 #define LOG(fmt, args...)    { syslog(LOG_INFO, fmt, ## args); printf(fmt, ## args); }
 #define LOG_ERROR(fmt, args...)    { syslog(LOG_CRIT, fmt, ## args); printf(fmt, ## args); }
 
@@ -17,54 +20,73 @@
 #define EVENT_TAG   "SendStateEvent"
 #define EVENT_NAME  "Send State Event"
 
+#define FRAME_INTERVAL_MS 33   // simulated detector at 30 Hz
+#define SCENE_PERIOD_S    8    // object enters and leaves the zone every 8 s
+#define STATS_INTERVAL_S  60
+
+// Edge filtering for the "object in zone" state
+static const StateConfig state_config = {
+    .on_threshold  = 0.6,
+    .off_threshold = 0.4,
+    .debounce_ms   = 300,
+    .min_hold_ms   = 2000,
+};
+
 typedef struct {
     AXEventHandler* event_handler;
     guint event_id;
     guint timer;
+    guint stats_timer;
     guint state_value;
+    StatePublisher* publisher;
 } AppData;
 
 static AppData* app_data = NULL;
 
 
-static gboolean send_event(AppData *send_data) {
+/*
+ * Simulated per-frame detection confidence for one zone. The object is in
+ * the zone for half of every scene period, and the detector is noisy and
+ * misses some frames, like a real one near the zone border.
+ */
+static gdouble detection_score(void) {
+    gboolean present = (g_get_monotonic_time() / (SCENE_PERIOD_S * G_USEC_PER_SEC)) % 2;
+    gdouble noise = (rand() % 1000) / 1000.0 - 0.5;
 
-    AXEventKeyValueSet *key_value_set = NULL;
-    AXEvent  *event                   = NULL;
-    //GDateTime *time_stamp;
-    
-    key_value_set = ax_event_key_value_set_new();
+    if (present && rand() % 30 == 0) return 0.0;  // missed detection
+    return present ? 0.75 + 0.5 * noise : 0.2 + 0.5 * noise;
+}
 
-    ax_event_key_value_set_add_key_value( key_value_set, "active", NULL, &send_data->state_value, AX_VALUE_TYPE_BOOL, NULL);
-    
-    //time_stamp = g_date_time_new_now_local();
+// Called for every frame, the publisher only sends real edges
+static gboolean send_event(AppData *send_data) {
 
-    // Create the event
-    // Use ax_event_new2 since ax_event_new is deprecated from 3.2
-    event = ax_event_new2(key_value_set, NULL);
-    
-    // The key/value set is no longer needed
-    ax_event_key_value_set_free(key_value_set);
+    state_publisher_update(send_data->publisher, detection_score());
+    send_data->state_value = state_publisher_get_state(send_data->publisher);
 
-    if(!ax_event_handler_send_event(send_data->event_handler, send_data->event_id, event, NULL))
-      LOG_ERROR("Could not fire event\n");
-    ax_event_free(event);
-    //g_date_time_unref(time_stamp);
+    // Returning TRUE keeps the timer going
+    return TRUE;
+}
 
+static gboolean log_stats(AppData *send_data) {
+    guint64 frames, edges, suppressed;
 
-    send_data->state_value = !send_data->state_value;
-    
-    // Returning TRUE keeps the timer going
+    state_publisher_get_stats(send_data->publisher, &frames, &edges, &suppressed);
+    LOG("%" G_GUINT64_FORMAT " frames, %" G_GUINT64_FORMAT " edges sent, %" G_GUINT64_FORMAT " transitions suppressed\n",
+        frames, edges, suppressed);
     return TRUE;
 }
+
 static void declaration_complete(guint declaration, int *start_value) {
     syslog(LOG_INFO, "Declaration complete for: %d", declaration);
     syslog(LOG_INFO, "Declaration complete start value: %u", *start_value);
 
     app_data->state_value = *start_value;
+    app_data->publisher = state_publisher_new(app_data->event_handler, declaration, "active",
+                                              &state_config, app_data->state_value);
 
-    // Set up a timer to be called every 10th second
-    app_data->timer = g_timeout_add_seconds(5, (GSourceFunc)send_event, app_data);
+    // Feed the publisher at frame rate
+    app_data->timer = g_timeout_add(FRAME_INTERVAL_MS, (GSourceFunc)send_event, app_data);
+    app_data->stats_timer = g_timeout_add_seconds(STATS_INTERVAL_S, (GSourceFunc)log_stats, app_data);
 }
 
 static guint setup_declaration(AXEventHandler* event_handler, guint *start_value) {
@@ -136,6 +158,7 @@ int main(void) {
   g_main_loop_run(main_loop);
 
   /// Cleanup event handler
+  state_publisher_free(app_data->publisher);
   ax_event_handler_undeclare(app_data->event_handler, app_data->event_id, NULL);
   ax_event_handler_free(app_data->event_handler);
   free(app_data);
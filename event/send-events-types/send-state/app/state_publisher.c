@@ -0,0 +1,138 @@
+/*
+ * Edge-only state event publisher
+ *
+ * A detector running at 30 Hz flickers: an object at the zone border, a
+ * missed detection, a confidence hovering around the threshold. Sending
+ * every flicker would storm the event daemon and every rule listening to
+ * it. The input goes through three filters instead, hysteresis on the
+ * score, a debounce time on the level and a minimum hold time on the
+ * published state, and ax_event_handler_send_event is only called when the
+ * filtered state really changes.
+ *
+ * A level change that is given up before it is published, because the
+ * input went back, counts as a suppressed transition. The state is only
+ * taken as published once the event was sent, a failed send stays pending.
+ */
+#include "state_publisher.h"
+
+#include <syslog.h>
+
+struct StatePublisher {
+    AXEventHandler* event_handler;
+    guint event_id;
+    gchar* state_key;
+    StateConfig config;
+    AXEventKeyValueSet* key_value_set;
+
+    gboolean level;          // input after hysteresis
+    gboolean published;      // state last sent
+    gboolean pending;        // level differs from published
+    gint64 pending_since;    // when level started to differ
+    gint64 published_at;
+
+    guint64 frames;
+    guint64 edges;
+    guint64 suppressed;
+};
+
+static void send_state(StatePublisher* publisher, gboolean state, gint64 now) {
+    GError* error = NULL;
+
+    // Updated in place, the set is allocated once
+    if (!ax_event_key_value_set_add_key_value(publisher->key_value_set, publisher->state_key, NULL,
+                                              &state, AX_VALUE_TYPE_BOOL, &error)) {
+        syslog(LOG_WARNING, "Could not update %s: %s", publisher->state_key, error ? error->message : "unknown");
+        g_clear_error(&error);
+        return;
+    }
+
+    AXEvent* event = ax_event_new2(publisher->key_value_set, NULL);
+    gboolean sent = ax_event_handler_send_event(publisher->event_handler, publisher->event_id, event, &error);
+    ax_event_free(event);
+
+    // Stay pending, the next frame tries again
+    if (!sent) {
+        syslog(LOG_CRIT, "Could not send state event: %s", error ? error->message : "unknown");
+        g_clear_error(&error);
+        return;
+    }
+
+    publisher->edges++;
+    publisher->published = state;
+    publisher->published_at = now;
+    publisher->pending = FALSE;
+}
+
+StatePublisher* state_publisher_new(AXEventHandler* event_handler,
+                                    guint event_id,
+                                    const gchar* state_key,
+                                    const StateConfig* config,
+                                    gboolean initial_state) {
+    StatePublisher* publisher = g_new0(StatePublisher, 1);
+
+    publisher->event_handler = event_handler;
+    publisher->event_id = event_id;
+    publisher->state_key = g_strdup(state_key);
+    publisher->config = *config;
+    publisher->level = initial_state;
+    publisher->published = initial_state;
+    publisher->published_at = g_get_monotonic_time();
+
+    publisher->key_value_set = ax_event_key_value_set_new();
+    ax_event_key_value_set_add_key_value(publisher->key_value_set, state_key, NULL,
+                                         &initial_state, AX_VALUE_TYPE_BOOL, NULL);
+    return publisher;
+}
+
+void state_publisher_free(StatePublisher* publisher) {
+    if (!publisher) return;
+
+    ax_event_key_value_set_free(publisher->key_value_set);
+    g_free(publisher->state_key);
+    g_free(publisher);
+}
+
+void state_publisher_update(StatePublisher* publisher, gdouble score) {
+    const StateConfig* config = &publisher->config;
+    gint64 now = g_get_monotonic_time();
+
+    publisher->frames++;
+
+    // Hysteresis, between the thresholds the level stays where it is
+    if (score >= config->on_threshold) publisher->level = TRUE;
+    else if (score <= config->off_threshold) publisher->level = FALSE;
+
+    if (publisher->level == publisher->published) {
+        if (publisher->pending) publisher->suppressed++;  // went back before it was sent
+        publisher->pending = FALSE;
+        return;
+    }
+
+    if (!publisher->pending) {
+        publisher->pending = TRUE;
+        publisher->pending_since = now;
+    }
+
+    // Debounce the new level, then keep the old state for its minimum time
+    if (now - publisher->pending_since < (gint64)config->debounce_ms * 1000) return;
+    if (now - publisher->published_at < (gint64)config->min_hold_ms * 1000) return;
+
+    send_state(publisher, publisher->level, now);
+}
+
+gboolean state_publisher_get_state(const StatePublisher* publisher) {
+    return publisher->published;
+}
+
+AXEventKeyValueSet* state_publisher_get_key_value_set(StatePublisher* publisher) {
+    return publisher->key_value_set;
+}
+
+void state_publisher_get_stats(const StatePublisher* publisher,
+                               guint64* frames,
+                               guint64* edges,
+                               guint64* suppressed) {
+    *frames = publisher->frames;
+    *edges = publisher->edges;
+    *suppressed = publisher->suppressed;
+}
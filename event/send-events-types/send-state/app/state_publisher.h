@@ -0,0 +1,48 @@
+#pragma once
+
+#include <axsdk/axevent.h>
+#include <glib.h>
+
+/*
+ * Turns a per-frame score, e.g. the confidence that an object is in a zone,
+ * into a stateful event that only changes on real edges.
+ *
+ * - Hysteresis: the input counts as active at on_threshold or above and as
+ *   inactive at off_threshold or below. In between it keeps its last level.
+ * - Debounce: a new level must hold for debounce_ms before it is an edge.
+ * - Minimum hold: a published state is kept for at least min_hold_ms.
+ *
+ * Use from the GLib main loop thread only.
+ */
+typedef struct {
+    gdouble on_threshold;
+    gdouble off_threshold;
+    guint debounce_ms;
+    guint min_hold_ms;
+} StateConfig;
+
+typedef struct StatePublisher StatePublisher;
+
+StatePublisher* state_publisher_new(AXEventHandler* event_handler,
+                                    guint event_id,
+                                    const gchar* state_key,
+                                    const StateConfig* config,
+                                    gboolean initial_state);
+void state_publisher_free(StatePublisher* publisher);
+
+// Feed one frame. Sends the event if this frame completes an edge.
+void state_publisher_update(StatePublisher* publisher, gdouble score);
+
+gboolean state_publisher_get_state(const StatePublisher* publisher);
+
+/*
+ * The key/value set sent with every edge. Add further data keys here once,
+ * the state key is updated by the publisher.
+ */
+AXEventKeyValueSet* state_publisher_get_key_value_set(StatePublisher* publisher);
+
+// Counts since start: frames fed, edges sent, level changes that never became an edge
+void state_publisher_get_stats(const StatePublisher* publisher,
+                               guint64* frames,
+                               guint64* edges,
+                               guint64* suppressed);
@@ -0,0 +1,149 @@
+/*
+ * Lock-free sample ring
+ *
+ * Bounded multi-producer, single-consumer ring after Dmitry Vyukov's bounded
+ * queue. Every slot carries a sequence number that says whose turn it is:
+ *
+ *   seq == pos          free, a producer at position pos may claim it
+ *   seq == pos + 1      filled, the consumer at position pos may read it
+ *   seq == pos + size   read, free again for the next lap
+ *
+ * Producers claim a position with one compare-and-swap on the tail, then
+ * copy the sample and publish it with a release store of the sequence. The
+ * single consumer needs no atomic read-modify-write at all.
+ *
+ * The consumer sleeps on a semaphore. It raises a flag before it sleeps, and
+ * only a producer that sees the flag posts, so a busy stream costs no system
+ * calls.
+ */
+#include "sample_ring.h"
+
+#include <errno.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <time.h>
+
+typedef struct {
+    atomic_size_t seq;
+    DataSample sample;
+} Slot;
+
+struct SampleRing {
+    gsize mask;
+    Slot* slots;
+
+    // Producers and the consumer on separate cache lines
+    _Alignas(64) atomic_size_t tail;
+    _Alignas(64) gsize head;
+    atomic_int sleeping;
+    sem_t wakeup;
+
+    atomic_ullong dropped;
+};
+
+SampleRing* sample_ring_new(gsize capacity) {
+    SampleRing* ring = g_new0(SampleRing, 1);
+    gsize size = 2;
+
+    while (size < capacity) size <<= 1;
+    ring->mask = size - 1;
+    ring->slots = g_new0(Slot, size);
+    for (gsize i = 0; i < size; i++) atomic_init(&ring->slots[i].seq, i);
+
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->sleeping, 0);
+    atomic_init(&ring->dropped, 0);
+    sem_init(&ring->wakeup, 0, 0);
+    return ring;
+}
+
+void sample_ring_free(SampleRing* ring) {
+    if (!ring) return;
+
+    sem_destroy(&ring->wakeup);
+    g_free(ring->slots);
+    g_free(ring);
+}
+
+gboolean sample_ring_push(SampleRing* ring, const DataSample* sample) {
+    gsize pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    Slot* slot;
+
+    for (;;) {
+        slot = &ring->slots[pos & ring->mask];
+        gsize seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        gssize diff = (gssize)(seq - pos);
+
+        if (diff == 0) {
+            // Free slot, claim it. On failure pos holds the new tail.
+            if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            // The consumer has not read this slot yet, the ring is full
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return FALSE;
+        } else {
+            pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        }
+    }
+
+    slot->sample = *sample;
+    /*
+     * Store seq, then load sleeping, while sample_ring_wait stores sleeping,
+     * then loads seq. Both sides must be seq_cst, or each can miss the other
+     * store and the wakeup is lost.
+     */
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_seq_cst);
+
+    if (atomic_exchange_explicit(&ring->sleeping, 0, memory_order_seq_cst)) sem_post(&ring->wakeup);
+    return TRUE;
+}
+
+gsize sample_ring_pop_batch(SampleRing* ring, DataSample* out, gsize max) {
+    gsize n = 0;
+
+    while (n < max) {
+        Slot* slot = &ring->slots[ring->head & ring->mask];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != ring->head + 1) break;
+
+        out[n++] = slot->sample;
+        atomic_store_explicit(&slot->seq, ring->head + ring->mask + 1, memory_order_release);
+        ring->head++;
+    }
+    return n;
+}
+
+void sample_ring_wait(SampleRing* ring, guint timeout_ms) {
+    atomic_store_explicit(&ring->sleeping, 1, memory_order_seq_cst);
+
+    // A push between the last pop and the flag would otherwise be missed
+    Slot* slot = &ring->slots[ring->head & ring->mask];
+    if (atomic_load_explicit(&slot->seq, memory_order_seq_cst) == ring->head + 1) {
+        atomic_store(&ring->sleeping, 0);
+        return;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    while (sem_timedwait(&ring->wakeup, &deadline) != 0 && errno == EINTR) {
+    }
+
+    // A producer that saw the flag may still post, that only costs one
+    // extra wakeup later
+    atomic_store(&ring->sleeping, 0);
+}
+
+void sample_ring_wake(SampleRing* ring) {
+    sem_post(&ring->wakeup);
+}
+
+guint64 sample_ring_dropped(SampleRing* ring) {
+    return atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+}
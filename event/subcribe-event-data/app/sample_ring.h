@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glib.h>
+
+/*
+ * One SendDataEvent, copied out of the AXEvent so the event can be freed
+ * right away in the subscription callback.
+ */
+typedef struct {
+    gint64 received_us;  // g_get_real_time() when the event arrived
+    gdouble temperature;
+    gdouble load;
+    gint used_memory;
+    gint free_memory;
+} DataSample;
+
+/*
+ * Bounded lock-free queue of samples, any number of producers and one
+ * consumer. A push never blocks and never allocates. When the queue is
+ * full the sample is dropped and counted.
+ */
+typedef struct SampleRing SampleRing;
+
+// capacity is rounded up to a power of two
+SampleRing* sample_ring_new(gsize capacity);
+void sample_ring_free(SampleRing* ring);
+
+gboolean sample_ring_push(SampleRing* ring, const DataSample* sample);
+
+// Consumer side, from one thread only
+gsize sample_ring_pop_batch(SampleRing* ring, DataSample* out, gsize max);
+// Sleep until a sample is pushed, sample_ring_wake is called or timeout_ms passes
+void sample_ring_wait(SampleRing* ring, guint timeout_ms);
+void sample_ring_wake(SampleRing* ring);
+
+guint64 sample_ring_dropped(SampleRing* ring);
@@ -17,114 +17,336 @@
 /**
  * - subscribe_to_event.c -
  *
- * This example illustrates how to setup an subscription to
- * an ACAP event. => SendData service / SendDataEvent
+ * This example illustrates how to setup subscriptions to
+ * ACAP events. => SendData service / SendDataEvent and the topics
+ * listed in subscriptions.conf
  *
  * Error handling has been omitted for the sake of brevity.
  */
 
+#include "sample_ring.h"
+#include "subscription_manager.h"
+#include "summary_publisher.h"
+#include "window_stats.h"
+
 #include <axsdk/axevent.h>
 #include <glib-object.h>
+#include <glib-unix.h>
 #include <glib.h>
+#include <stdatomic.h>
 #include <syslog.h>
 
+// Room for 4096 events while the worker is busy
+#define RING_CAPACITY 4096
+#define BATCH_SIZE    64
+// How long the worker sleeps at most when the ring is empty
+#define IDLE_WAIT_MS  1000
+#define STATS_PERIOD_S 60
+
+/*
+ * Samples are summarized over 1 min and 1 h. Add shorter windows here if a
+ * client needs them, every window length sends one event per period.
+ */
+static const guint window_lengths_s[] = {60, 3600};
+static const gchar* const sample_keys[] = {"Temperature", "Load", "UsedMemory", "FreeMemory"};
+
+#define CONFIG_PATH "/usr/local/packages/subscribe_event_data/subscriptions.conf"
+
+// The summary events sent by this app, never routed back to its handlers
+static const gchar* const summary_topic[TOPIC_LEVELS] = {"tnsaxis:CameraApplicationPlatform",
+                                                         "tnsaxis:SubscribeEventData",
+                                                         "tnsaxis:SummaryEvent"};
+
+typedef struct {
+    SampleRing* ring;
+    GThread* worker;
+    atomic_bool stopping;
+    WindowStats* windows;  // worker thread only
+    SummaryPublisher* summaries;
+    GAsyncQueue* pending_summaries;  // WindowSummary, from the worker to the main loop
+    SubscriptionManager* subscriptions;
+    GHashTable* topic_counts;  // "topic0/topic1/topic2" -> events since last stats
+} AppData;
+
+static AppData app_data;
+
+/**
+ * brief Send the closed windows queued by the worker.
+ *
+ * Runs as an idle source on the main loop thread, and once more at shutdown
+ * for what was queued after the main loop stopped.
+ *
+ * param data Not used.
+ * return G_SOURCE_REMOVE, the source runs once.
+ */
+static gboolean publish_summaries(gpointer data) {
+    WindowSummary* summary;
+
+    (void)data;
+
+    while ((summary = g_async_queue_try_pop(app_data.pending_summaries))) {
+        summary_publisher_send(app_data.summaries, summary);
+        g_free(summary);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * brief Called on the worker thread when a window closes.
+ *
+ * The summary is copied and sent from the main loop, where the event
+ * handler is used. Minute summaries are also logged.
+ *
+ * param summary The closed window.
+ * param user_data Not used.
+ */
+static void on_window_closed(const WindowSummary* summary, gpointer user_data) {
+    WindowSummary* copy = g_new(WindowSummary, 1);
+
+    (void)user_data;
+
+    *copy = *summary;
+    g_async_queue_push(app_data.pending_summaries, copy);
+    g_idle_add(publish_summaries, NULL);
+
+    if (summary->length_s != 60) return;
+    for (guint i = 0; i < summary->num_keys; i++) {
+        const KeySummary* key = &summary->keys[i];
+        syslog(LOG_INFO,
+               "%s over %u s, %" G_GUINT64_FORMAT " samples: min %f max %f mean %f variance %f"
+               " p50 %f p90 %f p99 %f",
+               sample_keys[i],
+               summary->length_s,
+               summary->count,
+               key->min,
+               key->max,
+               key->mean,
+               key->variance,
+               key->p50,
+               key->p90,
+               key->p99);
+    }
+}
+
 /**
- * brief Callback function which is called when event subscription is completed.
+ * brief Handle a batch of samples on the worker thread.
  *
- * This callback will be called when the subscription has been registered
- * with the event system. The event subscription can now be used for
- * subscribing to events.
+ * This is where slow consumer logic belongs, e.g. database writes or
+ * forwarding over HTTP. It may block without delaying event delivery, the
+ * event handler only pushes to the ring. Here every sample goes into the
+ * summary windows, only the summaries are published.
  *
- * param subscription Subscription id.
- * param event Subscribed event.
- * param token Token as user data to the callback function.
+ * param app The app data.
+ * param samples Samples in arrival order.
+ * param count Number of samples.
  */
-static void subscription_callback(guint subscription, AXEvent* event, gpointer *userdata) {
-    const AXEventKeyValueSet* key_value_set;
-    gdouble temperature = 0.0;
-    gdouble load = 0.0;
-    gint used_memory = 0;
-    gint free_memory = 0;
+static void process_samples(AppData* app, const DataSample* samples, gsize count) {
+    for (gsize i = 0; i < count; i++) {
+        const DataSample* sample = &samples[i];
+        const gdouble values[]   = {sample->temperature, sample->load, sample->used_memory, sample->free_memory};
+
+        window_stats_add(app->windows, sample->received_us, values);
+    }
+}
+
+/**
+ * brief Worker thread draining the ring in batches.
+ *
+ * Samples lost to a full ring are reported once per stats period together
+ * with the number of samples handled, so an overflow never floods the log.
+ *
+ * param data The app data.
+ */
+static gpointer worker_thread(gpointer data) {
+    AppData* app              = data;
+    DataSample batch[BATCH_SIZE];
+    guint64 processed         = 0;
+    guint64 reported_dropped  = 0;
+    gint64 next_report        = g_get_monotonic_time() + STATS_PERIOD_S * G_USEC_PER_SEC;
+
+    while (!atomic_load(&app->stopping)) {
+        gsize count = sample_ring_pop_batch(app->ring, batch, BATCH_SIZE);
+
+        if (count > 0) {
+            process_samples(app, batch, count);
+            processed += count;
+        } else {
+            sample_ring_wait(app->ring, IDLE_WAIT_MS);
+        }
+
+        // Close windows that ended while no sample came in
+        window_stats_flush(app->windows, g_get_real_time());
+
+        gint64 now = g_get_monotonic_time();
+        if (now < next_report) continue;
+        next_report = now + STATS_PERIOD_S * G_USEC_PER_SEC;
+
+        guint64 dropped = sample_ring_dropped(app->ring);
+        if (dropped != reported_dropped) {
+            syslog(LOG_WARNING,
+                   "Ring overflow, %" G_GUINT64_FORMAT " samples dropped in the last %d s",
+                   dropped - reported_dropped,
+                   STATS_PERIOD_S);
+            reported_dropped = dropped;
+        }
+        syslog(LOG_INFO, "Processed %" G_GUINT64_FORMAT " samples", processed);
+    }
+
+    // Whatever is still queued is handled before the thread exits
+    gsize count;
+    while ((count = sample_ring_pop_batch(app->ring, batch, BATCH_SIZE)) > 0)
+        process_samples(app, batch, count);
+    return NULL;
+}
 
-    // The subscription id is not used in this example
-    (void)subscription;
-    (void)userdata;
+/**
+ * brief Handler for SendDataEvent.
+ *
+ * The values are copied into a DataSample and pushed to the ring, nothing
+ * else happens on this thread. When the ring is full the sample is dropped
+ * and counted instead of waiting for the worker.
+ *
+ * param key_value_set Key/value set of the event, owned by the event.
+ * param topic Topic of the event.
+ * param user_data Not used.
+ */
+static void on_data_sample(const AXEventKeyValueSet* key_value_set,
+                           const EventTopic* topic,
+                           gpointer user_data) {
+    DataSample sample = {0};
 
-    // Extract the AXEventKeyValueSet from the event
-    key_value_set = ax_event_get_key_value_set(event);
+    (void)topic;
+    (void)user_data;
 
     // Get the Value of the data event
-    ax_event_key_value_set_get_double(key_value_set, "Temperature", NULL, &temperature, NULL);
-    ax_event_key_value_set_get_double(key_value_set, "Load", NULL, &load, NULL);
-    ax_event_key_value_set_get_integer(key_value_set, "UsedMemory", NULL, &used_memory, NULL);
-    ax_event_key_value_set_get_integer(key_value_set, "FreeMemory", NULL, &free_memory, NULL);
-    // Print a helpful message
-    syslog(LOG_INFO, "Temperature: %f C", temperature);
-    syslog(LOG_INFO, "Load: %f", load);
-    syslog(LOG_INFO, "Used Memory: %d (MB)", used_memory);
-    syslog(LOG_INFO, "Free Memory: %d (MB)", free_memory);
-
-    /*
-     * Free the received event, n.b. AXEventKeyValueSet should not be freed
-     * since it's owned by the event system until unsubscribing
-     */
-    ax_event_free(event);
+    sample.received_us = g_get_real_time();
+    ax_event_key_value_set_get_double(key_value_set, "Temperature", NULL, &sample.temperature, NULL);
+    ax_event_key_value_set_get_double(key_value_set, "Load", NULL, &sample.load, NULL);
+    ax_event_key_value_set_get_integer(key_value_set, "UsedMemory", NULL, &sample.used_memory, NULL);
+    ax_event_key_value_set_get_integer(key_value_set, "FreeMemory", NULL, &sample.free_memory, NULL);
+
+    sample_ring_push(app_data.ring, &sample);
+}
+
+/**
+ * brief Handler counting events per topic.
+ *
+ * The counts are logged with the other statistics.
+ *
+ * param key_value_set Not used.
+ * param topic Topic of the event.
+ * param user_data Not used.
+ */
+static void on_topic_count(const AXEventKeyValueSet* key_value_set,
+                           const EventTopic* topic,
+                           gpointer user_data) {
+    gchar name[256];
+    guint* count;
+
+    (void)key_value_set;
+    (void)user_data;
+
+    g_snprintf(name,
+               sizeof(name),
+               "%s/%s/%s",
+               topic->value[0] ? topic->value[0] : "*",
+               topic->value[1] ? topic->value[1] : "*",
+               topic->value[2] ? topic->value[2] : "*");
+
+    count = g_hash_table_lookup(app_data.topic_counts, name);
+    if (!count) {
+        count = g_new0(guint, 1);
+        g_hash_table_insert(app_data.topic_counts, g_strdup(name), count);
+    }
+    (*count)++;
+}
+
+// Handlers subscriptions.conf can refer to
+static const TopicHandler topic_handlers[] = {
+    {"data_sample", on_data_sample, NULL},
+    {"topic_count", on_topic_count, NULL},
+};
+
+/**
+ * brief Log the routing statistics and the per topic counts.
+ *
+ * param data Not used.
+ * return G_SOURCE_CONTINUE to keep the timer.
+ */
+static gboolean log_stats(gpointer data) {
+    guint filters         = 0;
+    guint subscriptions   = 0;
+    guint64 events        = 0;
+    guint64 unmatched     = 0;
+    guint64 excluded      = 0;
+    guint64 sent          = 0;
+    guint64 not_declared  = 0;
+    GHashTableIter iter;
+    gpointer name;
+    gpointer count;
+
+    (void)data;
+
+    subscription_manager_get_stats(app_data.subscriptions, &filters, &subscriptions, &events, &unmatched, &excluded);
+    syslog(LOG_INFO,
+           "%u filters on %u subscriptions, %" G_GUINT64_FORMAT " events, %" G_GUINT64_FORMAT
+           " without handler, %" G_GUINT64_FORMAT " own events dropped",
+           filters,
+           subscriptions,
+           events,
+           unmatched,
+           excluded);
+
+    summary_publisher_get_stats(app_data.summaries, &sent, &not_declared);
+    syslog(LOG_INFO,
+           "%" G_GUINT64_FORMAT " summary events sent, %" G_GUINT64_FORMAT " before the declaration",
+           sent,
+           not_declared);
+
+    g_hash_table_iter_init(&iter, app_data.topic_counts);
+    while (g_hash_table_iter_next(&iter, &name, &count))
+        syslog(LOG_INFO, "%s: %u events", (const gchar*)name, *(const guint*)count);
+    g_hash_table_remove_all(app_data.topic_counts);
+
+    return G_SOURCE_CONTINUE;
 }
 
 /**
- * brief Setup a subscription for an event.
+ * brief Set up the subscriptions.
  *
- * Initialize a subscription for AXEventKeyValueSet that matches
- * tnsaxis:SendData/tnsaxis:SendDataEvent, which is using the VAPIX namespace "tnsaxis".
+ * The filters are read from subscriptions.conf in the application
+ * directory. Without a usable file the application subscribes to
+ * tnsaxis:CameraApplicationPlatform/tnsaxis:SendData/tnsaxis:SendDataEvent
+ * only, which is using the VAPIX namespace "tnsaxis".
  *
- * Topic: tnsaxis:CameraApplicationPlatform/tnsaxis:SendData/tnsaxis:SendDataEvent
+ * param event_handler Event handler.
+ * return The started subscription manager.
+ */
+static SubscriptionManager* setup_subscriptions(AXEventHandler* event_handler) {
+    SubscriptionManager* manager = subscription_manager_new(event_handler);
+
+    if (!subscription_manager_load(manager, CONFIG_PATH, topic_handlers, G_N_ELEMENTS(topic_handlers))) {
+        const gchar* const topics[TOPIC_LEVELS] = {"tnsaxis:CameraApplicationPlatform",
+                                                   "tnsaxis:SendData",
+                                                   "tnsaxis:SendDataEvent"};
+        syslog(LOG_INFO, "Using the default SendDataEvent subscription");
+        subscription_manager_add(manager, topics, &topic_handlers[0]);
+    }
+    subscription_manager_exclude(manager, summary_topic);
+
+    subscription_manager_start(manager);
+    return manager;
+}
+
+/**
+ * brief Handles the signals.
  *
- * param handler Event handler.
- * param token Token as user data to the callback function.
- * return subscription id as integer.
+ * param loop Loop to quit
  */
-static guint send_data_event_subscription(AXEventHandler* event_handler) {
-    AXEventKeyValueSet* key_value_set = NULL;
-    guint subscription                = 0;
-
-    key_value_set = ax_event_key_value_set_new();
-
-    // Set keys and namespaces for the event to be subscribed
-    ax_event_key_value_set_add_key_value(key_value_set,
-                                         "topic0",
-                                         "tnsaxis",
-                                         "CameraApplicationPlatform",
-                                         AX_VALUE_TYPE_STRING,
-                                         NULL);
-    ax_event_key_value_set_add_key_value(key_value_set,
-                                         "topic1",
-                                         "tnsaxis",
-                                         "SendData",
-                                         AX_VALUE_TYPE_STRING,
-                                         NULL);
-    ax_event_key_value_set_add_key_value(key_value_set,
-                                         "topic2",
-                                         "tnsaxis",
-                                         "SendDataEvent",
-                                         AX_VALUE_TYPE_STRING,
-                                         NULL);
-
-    /*
-     * Time to setup the subscription. Use the "token" input argument as
-     * input data to the callback function "subscription callback"
-     */
-    ax_event_handler_subscribe(event_handler,
-                               key_value_set,
-                               &subscription,
-                               (AXSubscriptionCallback)subscription_callback,
-                               NULL,
-                               NULL);
-
-
-    // The key/value set is no longer needed
-    ax_event_key_value_set_free(key_value_set);
-
-    return subscription;
+static gboolean signal_handler(gpointer loop) {
+    g_main_loop_quit((GMainLoop*)loop);
+    syslog(LOG_INFO, "Application was stopped by SIGTERM or SIGINT.");
+    return G_SOURCE_REMOVE;
 }
 
 /**
@@ -133,25 +355,55 @@ static guint send_data_event_subscription(AXEventHandler* event_handler) {
 int main(void) {
     GMainLoop* main_loop          = NULL;
     AXEventHandler* event_handler = NULL;
-    guint subscription            = 0;
-    
 
     // Set up the user logging to syslog
     openlog(NULL, LOG_PID, LOG_USER);
     syslog(LOG_INFO, "Started logging from subscribe event application");
 
-    // Event handler
-    event_handler = ax_event_handler_new();
-    subscription  = send_data_event_subscription(event_handler);
+    // Event handler, the summary event is declared first
+    event_handler      = ax_event_handler_new();
+    app_data.summaries = summary_publisher_new(event_handler, sample_keys, G_N_ELEMENTS(sample_keys));
+
+    // The worker must be running before the first event arrives
+    app_data.ring              = sample_ring_new(RING_CAPACITY);
+    app_data.pending_summaries = g_async_queue_new();
+    app_data.windows = window_stats_new(G_N_ELEMENTS(sample_keys),
+                                        window_lengths_s,
+                                        G_N_ELEMENTS(window_lengths_s),
+                                        on_window_closed,
+                                        NULL);
+    atomic_init(&app_data.stopping, FALSE);
+    app_data.worker = g_thread_new("sample-worker", worker_thread, &app_data);
+
+    app_data.topic_counts  = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    app_data.subscriptions = setup_subscriptions(event_handler);
 
     // Main loop
     main_loop = g_main_loop_new(NULL, FALSE);
+    g_unix_signal_add(SIGTERM, signal_handler, main_loop);
+    g_unix_signal_add(SIGINT, signal_handler, main_loop);
+    g_timeout_add_seconds(STATS_PERIOD_S, log_stats, NULL);
     g_main_loop_run(main_loop);
 
+    // Unsubscribe, no handler runs after this
+    subscription_manager_free(app_data.subscriptions);
+    g_hash_table_destroy(app_data.topic_counts);
+
+    // Stop the worker once the ring is drained, windows still open are not sent
+    atomic_store(&app_data.stopping, TRUE);
+    sample_ring_wake(app_data.ring);
+    g_thread_join(app_data.worker);
+    sample_ring_free(app_data.ring);
+    window_stats_free(app_data.windows);
+
+    // The main loop no longer runs the idle sources, send the rest here
+    publish_summaries(NULL);
+    g_async_queue_unref(app_data.pending_summaries);
+
     // Cleanup event handler
-    ax_event_handler_unsubscribe(event_handler, subscription, NULL);
+    summary_publisher_free(app_data.summaries);
     ax_event_handler_free(event_handler);
 
     // Free g_main_loop
     g_main_loop_unref(main_loop);
-}
\ No newline at end of file
+}
@@ -0,0 +1,442 @@
+/*
+ * Subscription manager with a topic trie
+ *
+ * The filters are stored in a trie with one level per topic key. An edge is
+ * either "namespace:value" or the wildcard, and the handlers hang at the
+ * leaves. An event is routed by reading its topic keys once and walking the
+ * trie, following both the matching edge and the wildcard edge at every
+ * level, instead of asking every handler whether the event is for it.
+ *
+ * The event system only gets the filters no other filter covers, and all of
+ * them share one callback, so an event that matches several filters still
+ * arrives once.
+ *
+ * Excluded topics are inserted in the same trie with a route of their own.
+ * An event that reaches it is dropped before any handler runs.
+ */
+#include "subscription_manager.h"
+
+#include <string.h>
+#include <syslog.h>
+
+static const gchar* const topic_keys[TOPIC_LEVELS] = {"topic0", "topic1", "topic2"};
+
+typedef struct {
+    gchar* name_space[TOPIC_LEVELS];  // NULL at a wildcard level
+    gchar* value[TOPIC_LEVELS];
+    const gchar* handler_name;
+} Filter;
+
+// One per distinct handler, so one reached by several filters runs once
+typedef struct {
+    TopicHandlerFunc func;
+    gpointer user_data;
+} Route;
+
+// Leaf route of the excluded topics, never run
+static Route excluded_route;
+
+typedef struct TrieNode {
+    GHashTable* children;      // "namespace:value" -> TrieNode
+    struct TrieNode* wildcard;
+    GPtrArray* name_spaces;    // namespaces used by children, tried when reading the topic
+    GPtrArray* routes;         // Route, last level only
+} TrieNode;
+
+struct SubscriptionManager {
+    AXEventHandler* event_handler;
+    GPtrArray* filters;
+    GPtrArray* routes;
+    TrieNode* root;
+    GArray* subscriptions;
+    Route** matched;  // scratch for one event, sized at start
+    gboolean started;
+
+    guint64 events;
+    guint64 unmatched;
+    guint64 excluded;
+};
+
+// What is known about the event being routed, each level read at most once
+typedef struct {
+    const AXEventKeyValueSet* key_value_set;
+    EventTopic topic;
+    gchar* value[TOPIC_LEVELS];
+    gchar* key[TOPIC_LEVELS];
+    guint num_matched;
+} RouteState;
+
+static void trie_node_free(gpointer data);
+
+static TrieNode* trie_node_new(void) {
+    TrieNode* node = g_new0(TrieNode, 1);
+
+    node->children    = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, trie_node_free);
+    node->name_spaces = g_ptr_array_new_with_free_func(g_free);
+    node->routes      = g_ptr_array_new();
+    return node;
+}
+
+static void trie_node_free(gpointer data) {
+    TrieNode* node = data;
+
+    if (!node) return;
+    g_hash_table_destroy(node->children);
+    trie_node_free(node->wildcard);
+    g_ptr_array_free(node->name_spaces, TRUE);
+    g_ptr_array_free(node->routes, TRUE);
+    g_free(node);
+}
+
+static void filter_free(gpointer data) {
+    Filter* filter = data;
+
+    for (guint i = 0; i < TOPIC_LEVELS; i++) {
+        g_free(filter->name_space[i]);
+        g_free(filter->value[i]);
+    }
+    g_free(filter);
+}
+
+static gboolean has_string(const GPtrArray* array, const gchar* string) {
+    for (guint i = 0; i < array->len; i++)
+        if (strcmp(g_ptr_array_index(array, i), string) == 0) return TRUE;
+    return FALSE;
+}
+
+// "namespace:value", or NULL and "*" for a wildcard
+static gboolean parse_token(const gchar* token, gchar** name_space, gchar** value) {
+    *name_space = NULL;
+    *value      = NULL;
+    if (!token || !*token || strcmp(token, "*") == 0) return TRUE;
+
+    const gchar* colon = strchr(token, ':');
+    if (!colon || colon == token || !colon[1]) return FALSE;
+
+    *name_space = g_strndup(token, colon - token);
+    *value      = g_strdup(colon + 1);
+    return TRUE;
+}
+
+static Route* get_route(SubscriptionManager* manager, const TopicHandler* handler) {
+    for (guint i = 0; i < manager->routes->len; i++) {
+        Route* route = g_ptr_array_index(manager->routes, i);
+        if (route->func == handler->func && route->user_data == handler->user_data) return route;
+    }
+
+    Route* route     = g_new0(Route, 1);
+    route->func      = handler->func;
+    route->user_data = handler->user_data;
+    g_ptr_array_add(manager->routes, route);
+    return route;
+}
+
+static void trie_insert(SubscriptionManager* manager, const Filter* filter, Route* route) {
+    TrieNode* node = manager->root;
+
+    for (guint i = 0; i < TOPIC_LEVELS; i++) {
+        if (!filter->value[i]) {
+            if (!node->wildcard) node->wildcard = trie_node_new();
+            node = node->wildcard;
+            continue;
+        }
+
+        gchar* key      = g_strconcat(filter->name_space[i], ":", filter->value[i], NULL);
+        TrieNode* child = g_hash_table_lookup(node->children, key);
+        if (!child) {
+            child = trie_node_new();
+            g_hash_table_insert(node->children, key, child);
+            if (!has_string(node->name_spaces, filter->name_space[i]))
+                g_ptr_array_add(node->name_spaces, g_strdup(filter->name_space[i]));
+        } else {
+            g_free(key);
+        }
+        node = child;
+    }
+
+    for (guint i = 0; i < node->routes->len; i++)
+        if (g_ptr_array_index(node->routes, i) == route) return;
+    g_ptr_array_add(node->routes, route);
+}
+
+SubscriptionManager* subscription_manager_new(AXEventHandler* event_handler) {
+    SubscriptionManager* manager = g_new0(SubscriptionManager, 1);
+
+    manager->event_handler = event_handler;
+    manager->filters       = g_ptr_array_new_with_free_func(filter_free);
+    manager->routes        = g_ptr_array_new_with_free_func(g_free);
+    manager->root          = trie_node_new();
+    manager->subscriptions = g_array_new(FALSE, FALSE, sizeof(guint));
+    return manager;
+}
+
+void subscription_manager_free(SubscriptionManager* manager) {
+    if (!manager) return;
+
+    for (guint i = 0; i < manager->subscriptions->len; i++)
+        ax_event_handler_unsubscribe(manager->event_handler,
+                                     g_array_index(manager->subscriptions, guint, i),
+                                     NULL);
+    g_array_free(manager->subscriptions, TRUE);
+    trie_node_free(manager->root);
+    g_ptr_array_free(manager->filters, TRUE);
+    g_ptr_array_free(manager->routes, TRUE);
+    g_free(manager->matched);
+    g_free(manager);
+}
+
+gboolean subscription_manager_add(SubscriptionManager* manager,
+                                  const gchar* const topics[TOPIC_LEVELS],
+                                  const TopicHandler* handler) {
+    if (manager->started) {
+        syslog(LOG_ERR, "Filters can not be added after start");
+        return FALSE;
+    }
+
+    Filter* filter       = g_new0(Filter, 1);
+    filter->handler_name = handler->name;
+    for (guint i = 0; i < TOPIC_LEVELS; i++) {
+        if (!parse_token(topics[i], &filter->name_space[i], &filter->value[i])) {
+            syslog(LOG_ERR, "Invalid %s '%s', expected namespace:value or *", topic_keys[i], topics[i]);
+            filter_free(filter);
+            return FALSE;
+        }
+    }
+
+    trie_insert(manager, filter, get_route(manager, handler));
+    g_ptr_array_add(manager->filters, filter);
+    return TRUE;
+}
+
+gboolean subscription_manager_exclude(SubscriptionManager* manager, const gchar* const topics[TOPIC_LEVELS]) {
+    Filter filter = {0};
+    gboolean valid = TRUE;
+
+    if (manager->started) {
+        syslog(LOG_ERR, "Topics can not be excluded after start");
+        return FALSE;
+    }
+
+    for (guint i = 0; valid && i < TOPIC_LEVELS; i++) {
+        valid = parse_token(topics[i], &filter.name_space[i], &filter.value[i]);
+        if (!valid) syslog(LOG_ERR, "Invalid %s '%s', expected namespace:value or *", topic_keys[i], topics[i]);
+    }
+    if (valid) trie_insert(manager, &filter, &excluded_route);
+
+    for (guint i = 0; i < TOPIC_LEVELS; i++) {
+        g_free(filter.name_space[i]);
+        g_free(filter.value[i]);
+    }
+    return valid;
+}
+
+gboolean subscription_manager_load(SubscriptionManager* manager,
+                                   const gchar* path,
+                                   const TopicHandler* handlers,
+                                   gsize num_handlers) {
+    GKeyFile* key_file = g_key_file_new();
+    GError* error      = NULL;
+    guint added        = 0;
+
+    if (!g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, &error)) {
+        syslog(LOG_WARNING, "Could not read %s: %s", path, error->message);
+        g_error_free(error);
+        g_key_file_free(key_file);
+        return FALSE;
+    }
+
+    gchar** groups = g_key_file_get_groups(key_file, NULL);
+    for (gchar** group = groups; *group; group++) {
+        gchar* topics[TOPIC_LEVELS];
+        gchar* name               = g_key_file_get_string(key_file, *group, "handler", NULL);
+        const TopicHandler* found = NULL;
+
+        for (gsize i = 0; name && i < num_handlers; i++)
+            if (strcmp(handlers[i].name, name) == 0) found = &handlers[i];
+
+        for (guint i = 0; i < TOPIC_LEVELS; i++)
+            topics[i] = g_key_file_get_string(key_file, *group, topic_keys[i], NULL);
+
+        if (!found)
+            syslog(LOG_ERR, "[%s] Unknown handler '%s', skipped", *group, name ? name : "");
+        else if (subscription_manager_add(manager, (const gchar* const*)topics, found))
+            added++;
+        else
+            syslog(LOG_ERR, "[%s] Skipped", *group);
+
+        for (guint i = 0; i < TOPIC_LEVELS; i++) g_free(topics[i]);
+        g_free(name);
+    }
+    g_strfreev(groups);
+    g_key_file_free(key_file);
+
+    syslog(LOG_INFO, "Loaded %u filters from %s", added, path);
+    return added > 0;
+}
+
+/*
+ * TRUE if broad matches every event narrow matches, that is every level broad
+ * fixes, narrow fixes to the same token. A wildcard level in broad matches
+ * anything, a wildcard level in narrow is only covered by one in broad.
+ */
+static gboolean filter_covers(const Filter* broad, const Filter* narrow) {
+    for (guint i = 0; i < TOPIC_LEVELS; i++) {
+        if (!broad->value[i]) continue;
+        if (!narrow->value[i]) return FALSE;
+        if (strcmp(broad->value[i], narrow->value[i]) != 0 ||
+            strcmp(broad->name_space[i], narrow->name_space[i]) != 0)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * TRUE if the filter at index needs no subscription of its own, because
+ * another filter covers it and is either strictly broader, or equal to it and
+ * added earlier. Of a set of equal filters only the first one subscribes.
+ */
+static gboolean filter_redundant(const SubscriptionManager* manager, guint index) {
+    const Filter* filter = g_ptr_array_index(manager->filters, index);
+
+    for (guint i = 0; i < manager->filters->len; i++) {
+        const Filter* other = g_ptr_array_index(manager->filters, i);
+        if (i == index || !filter_covers(other, filter)) continue;
+
+        gboolean equal = filter_covers(filter, other);
+        if (!equal || i < index) return TRUE;
+    }
+    return FALSE;
+}
+
+static void read_topic(RouteState* state, guint level, const GPtrArray* name_spaces) {
+    if (state->value[level]) return;
+
+    // An event has one key per level, try the namespaces the filters use
+    for (guint i = 0; i < name_spaces->len; i++) {
+        const gchar* name_space = g_ptr_array_index(name_spaces, i);
+        gchar* value            = NULL;
+
+        if (!ax_event_key_value_set_get_string(state->key_value_set, topic_keys[level], name_space, &value, NULL))
+            continue;
+        state->value[level]            = value;
+        state->key[level]              = g_strconcat(name_space, ":", value, NULL);
+        state->topic.name_space[level] = name_space;
+        state->topic.value[level]      = value;
+        return;
+    }
+}
+
+static void collect(SubscriptionManager* manager, const TrieNode* node, guint level, RouteState* state) {
+    if (level == TOPIC_LEVELS) {
+        for (guint i = 0; i < node->routes->len; i++) {
+            Route* route   = g_ptr_array_index(node->routes, i);
+            gboolean known = FALSE;
+
+            for (guint j = 0; j < state->num_matched; j++) known |= manager->matched[j] == route;
+            if (!known) manager->matched[state->num_matched++] = route;
+        }
+        return;
+    }
+
+    if (node->wildcard) collect(manager, node->wildcard, level + 1, state);
+    if (node->name_spaces->len == 0) return;
+
+    read_topic(state, level, node->name_spaces);
+    if (!state->key[level]) return;
+
+    const TrieNode* child = g_hash_table_lookup(node->children, state->key[level]);
+    if (child) collect(manager, child, level + 1, state);
+}
+
+static void route_event(guint subscription, AXEvent* event, gpointer user_data) {
+    SubscriptionManager* manager = user_data;
+    RouteState state             = {0};
+
+    (void)subscription;
+
+    state.key_value_set = ax_event_get_key_value_set(event);
+    collect(manager, manager->root, 0, &state);
+
+    gboolean excluded = FALSE;
+    for (guint i = 0; i < state.num_matched; i++) excluded |= manager->matched[i] == &excluded_route;
+
+    if (excluded) {
+        manager->excluded++;
+    } else {
+        manager->events++;
+        if (state.num_matched == 0) manager->unmatched++;
+        for (guint i = 0; i < state.num_matched; i++)
+            manager->matched[i]->func(state.key_value_set, &state.topic, manager->matched[i]->user_data);
+    }
+
+    for (guint i = 0; i < TOPIC_LEVELS; i++) {
+        g_free(state.value[i]);
+        g_free(state.key[i]);
+    }
+
+    /*
+     * Free the received event, n.b. AXEventKeyValueSet should not be freed
+     * since it's owned by the event system until unsubscribing
+     */
+    ax_event_free(event);
+}
+
+gboolean subscription_manager_start(SubscriptionManager* manager) {
+    if (manager->started) return TRUE;
+    manager->started = TRUE;
+    // The handler routes and excluded_route
+    manager->matched = g_new0(Route*, manager->routes->len + 1);
+
+    for (guint i = 0; i < manager->filters->len; i++) {
+        const Filter* filter = g_ptr_array_index(manager->filters, i);
+        GError* error        = NULL;
+        guint subscription   = 0;
+
+        if (filter_redundant(manager, i)) {
+            syslog(LOG_INFO, "Filter for %s is covered by another filter", filter->handler_name);
+            continue;
+        }
+
+        // Wildcard levels are simply left out of the subscription
+        AXEventKeyValueSet* key_value_set = ax_event_key_value_set_new();
+        for (guint level = 0; level < TOPIC_LEVELS; level++) {
+            if (!filter->value[level]) continue;
+            ax_event_key_value_set_add_key_value(key_value_set,
+                                                 topic_keys[level],
+                                                 filter->name_space[level],
+                                                 filter->value[level],
+                                                 AX_VALUE_TYPE_STRING,
+                                                 NULL);
+        }
+
+        if (ax_event_handler_subscribe(manager->event_handler,
+                                       key_value_set,
+                                       &subscription,
+                                       route_event,
+                                       manager,
+                                       &error)) {
+            g_array_append_val(manager->subscriptions, subscription);
+        } else {
+            syslog(LOG_ERR, "Could not subscribe for %s: %s", filter->handler_name,
+                   error ? error->message : "unknown");
+            g_clear_error(&error);
+        }
+        ax_event_key_value_set_free(key_value_set);
+    }
+
+    syslog(LOG_INFO, "%u filters, %u subscriptions", manager->filters->len, manager->subscriptions->len);
+    return manager->subscriptions->len > 0;
+}
+
+void subscription_manager_get_stats(const SubscriptionManager* manager,
+                                    guint* filters,
+                                    guint* subscriptions,
+                                    guint64* events,
+                                    guint64* unmatched,
+                                    guint64* excluded) {
+    *filters       = manager->filters->len;
+    *subscriptions = manager->subscriptions->len;
+    *events        = manager->events;
+    *unmatched     = manager->unmatched;
+    *excluded      = manager->excluded;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <axsdk/axevent.h>
+#include <glib.h>
+
+#define TOPIC_LEVELS 3
+
+/*
+ * Topic of a delivered event, read once by the manager. A level is NULL when
+ * the event has no such topic key, or when it was only matched by a wildcard
+ * and its namespace is not used by any filter at that level.
+ */
+typedef struct {
+    const gchar* name_space[TOPIC_LEVELS];
+    const gchar* value[TOPIC_LEVELS];
+} EventTopic;
+
+typedef void (*TopicHandlerFunc)(const AXEventKeyValueSet* key_value_set,
+                                 const EventTopic* topic,
+                                 gpointer user_data);
+
+// A handler a configuration file can refer to by name
+typedef struct {
+    const gchar* name;
+    TopicHandlerFunc func;
+    gpointer user_data;
+} TopicHandler;
+
+/*
+ * Subscribes to many topic filters with as few event subscriptions as
+ * possible and routes every event to the handlers of all filters it matches.
+ *
+ * A filter has one token per topic level, "namespace:value" or "*". A level
+ * that is left out is a wildcard too. A filter that another filter already
+ * covers, e.g. the SendData topic under tnsaxis:CameraApplicationPlatform
+ * with topic1 and topic2 left out, gets no subscription of its own, so no
+ * event is delivered twice. A handler reached through several filters runs
+ * once per event.
+ *
+ * Add filters, then start. Errors are logged to syslog. Events are routed
+ * on the thread that delivers them, the GLib main loop thread.
+ */
+typedef struct SubscriptionManager SubscriptionManager;
+
+SubscriptionManager* subscription_manager_new(AXEventHandler* event_handler);
+// Unsubscribes everything
+void subscription_manager_free(SubscriptionManager* manager);
+
+gboolean subscription_manager_add(SubscriptionManager* manager,
+                                  const gchar* const topics[TOPIC_LEVELS],
+                                  const TopicHandler* handler);
+
+/*
+ * Add the filters of a key file, one group per filter with the keys topic0,
+ * topic1, topic2 and handler. The handler name is looked up in handlers.
+ * Invalid groups are logged and skipped. FALSE if the file could not be
+ * read or had no valid group.
+ */
+gboolean subscription_manager_load(SubscriptionManager* manager,
+                                   const gchar* path,
+                                   const TopicHandler* handlers,
+                                   gsize num_handlers);
+
+/*
+ * Drop events of a topic, written like a filter, even where a filter matches
+ * them, e.g. the app's own events under a wildcard filter. No subscription
+ * is made for it. Call before start.
+ */
+gboolean subscription_manager_exclude(SubscriptionManager* manager, const gchar* const topics[TOPIC_LEVELS]);
+
+gboolean subscription_manager_start(SubscriptionManager* manager);
+
+/*
+ * Filters added, event subscriptions made, events delivered, events no
+ * handler matched and events dropped as excluded
+ */
+void subscription_manager_get_stats(const SubscriptionManager* manager,
+                                    guint* filters,
+                                    guint* subscriptions,
+                                    guint64* events,
+                                    guint64* unmatched,
+                                    guint64* excluded);
@@ -0,0 +1,154 @@
+/*
+ * Summary event publisher
+ *
+ * The field names are built and the key/value set is allocated once. A
+ * summary only writes its values into that set before the event is sent.
+ */
+#include "summary_publisher.h"
+
+#include <syslog.h>
+
+#define NUM_STATS 7
+
+static const gchar* const stat_names[NUM_STATS] = {"Min", "Max", "Mean", "Variance", "P50", "P90", "P99"};
+
+struct SummaryPublisher {
+    AXEventHandler* event_handler;
+    guint declaration;
+    gboolean declared;
+    guint num_keys;
+    gchar** field_names;  // num_keys x NUM_STATS
+    AXEventKeyValueSet* key_value_set;
+
+    guint64 sent;
+    guint64 dropped;
+};
+
+static void declaration_complete(guint declaration, gpointer user_data) {
+    SummaryPublisher* publisher = user_data;
+
+    syslog(LOG_INFO, "Summary event declaration %u complete", declaration);
+    publisher->declared = TRUE;
+}
+
+static void add_int(AXEventKeyValueSet* key_value_set, const gchar* name, gint value) {
+    ax_event_key_value_set_add_key_value(key_value_set, name, NULL, &value, AX_VALUE_TYPE_INT, NULL);
+}
+
+static void add_double(AXEventKeyValueSet* key_value_set, const gchar* name, gdouble value) {
+    ax_event_key_value_set_add_key_value(key_value_set, name, NULL, &value, AX_VALUE_TYPE_DOUBLE, NULL);
+}
+
+static void mark_data(AXEventKeyValueSet* key_value_set, const gchar* name) {
+    ax_event_key_value_set_mark_as_data(key_value_set, name, NULL, NULL);
+    ax_event_key_value_set_mark_as_user_defined(key_value_set, name, NULL, "isApplicationData", NULL);
+}
+
+static void set_values(SummaryPublisher* publisher, AXEventKeyValueSet* key_value_set, const WindowSummary* summary) {
+    add_int(key_value_set, "Window", (gint)summary->length_s);
+    add_int(key_value_set, "Count", (gint)MIN(summary->count, (guint64)G_MAXINT));
+
+    for (guint i = 0; i < publisher->num_keys; i++) {
+        const KeySummary* key           = &summary->keys[i];
+        const gdouble values[NUM_STATS] = {key->min, key->max, key->mean, key->variance, key->p50, key->p90, key->p99};
+        gchar** names                   = &publisher->field_names[i * NUM_STATS];
+
+        for (guint s = 0; s < NUM_STATS; s++) add_double(key_value_set, names[s], values[s]);
+    }
+}
+
+static guint declare_summary_event(SummaryPublisher* publisher) {
+    AXEventKeyValueSet* key_value_set = ax_event_key_value_set_new();
+    WindowSummary empty               = {0};
+    guint declaration                 = 0;
+    GError* error                     = NULL;
+
+    ax_event_key_value_set_add_key_value(key_value_set, "topic0", "tnsaxis", "CameraApplicationPlatform",
+                                         AX_VALUE_TYPE_STRING, NULL);
+    ax_event_key_value_set_add_key_value(key_value_set, "topic1", "tnsaxis", "SubscribeEventData",
+                                         AX_VALUE_TYPE_STRING, NULL);
+    ax_event_key_value_set_add_nice_names(key_value_set, "topic1", "tnsaxis", "SubscribeEventData",
+                                          "Subscribe Event Data", NULL);
+    ax_event_key_value_set_add_key_value(key_value_set, "topic2", "tnsaxis", "SummaryEvent",
+                                         AX_VALUE_TYPE_STRING, NULL);
+    ax_event_key_value_set_add_nice_names(key_value_set, "topic2", "tnsaxis", "SummaryEvent",
+                                          "Summary Event", NULL);
+    // Meant for monitoring clients, not for action rules
+    ax_event_key_value_set_mark_as_user_defined(key_value_set, "topic2", "tnsaxis", "isApplicationData", NULL);
+
+    set_values(publisher, key_value_set, &empty);
+    mark_data(key_value_set, "Window");
+    mark_data(key_value_set, "Count");
+    for (guint i = 0; i < publisher->num_keys * NUM_STATS; i++) mark_data(key_value_set, publisher->field_names[i]);
+
+    // Stateless, every summary is an event of its own
+    if (!ax_event_handler_declare(publisher->event_handler,
+                                  key_value_set,
+                                  TRUE,
+                                  &declaration,
+                                  declaration_complete,
+                                  publisher,
+                                  &error)) {
+        syslog(LOG_CRIT, "Could not declare summary event: %s", error ? error->message : "unknown");
+        g_clear_error(&error);
+    }
+    ax_event_key_value_set_free(key_value_set);
+
+    return declaration;
+}
+
+SummaryPublisher* summary_publisher_new(AXEventHandler* event_handler,
+                                        const gchar* const* keys,
+                                        guint num_keys) {
+    SummaryPublisher* publisher = g_new0(SummaryPublisher, 1);
+    WindowSummary empty         = {0};
+
+    publisher->event_handler = event_handler;
+    publisher->num_keys      = MIN(num_keys, WINDOW_STATS_MAX_KEYS);
+    publisher->field_names   = g_new0(gchar*, publisher->num_keys * NUM_STATS + 1);
+    for (guint i = 0; i < publisher->num_keys; i++)
+        for (guint s = 0; s < NUM_STATS; s++)
+            publisher->field_names[i * NUM_STATS + s] = g_strconcat(keys[i], stat_names[s], NULL);
+
+    publisher->declaration = declare_summary_event(publisher);
+
+    // Every field gets a slot now, so sending never adds keys
+    publisher->key_value_set = ax_event_key_value_set_new();
+    set_values(publisher, publisher->key_value_set, &empty);
+    return publisher;
+}
+
+void summary_publisher_free(SummaryPublisher* publisher) {
+    if (!publisher) return;
+
+    if (publisher->declaration)
+        ax_event_handler_undeclare(publisher->event_handler, publisher->declaration, NULL);
+    ax_event_key_value_set_free(publisher->key_value_set);
+    g_strfreev(publisher->field_names);
+    g_free(publisher);
+}
+
+void summary_publisher_send(SummaryPublisher* publisher, const WindowSummary* summary) {
+    GError* error = NULL;
+
+    if (!publisher->declared) {
+        publisher->dropped++;
+        return;
+    }
+
+    set_values(publisher, publisher->key_value_set, summary);
+
+    AXEvent* event = ax_event_new2(publisher->key_value_set, NULL);
+    if (!ax_event_handler_send_event(publisher->event_handler, publisher->declaration, event, &error)) {
+        syslog(LOG_CRIT, "Could not send summary event: %s", error ? error->message : "unknown");
+        g_clear_error(&error);
+    } else {
+        publisher->sent++;
+    }
+    ax_event_free(event);
+}
+
+void summary_publisher_get_stats(const SummaryPublisher* publisher, guint64* sent, guint64* dropped) {
+    *sent    = publisher->sent;
+    *dropped = publisher->dropped;
+}
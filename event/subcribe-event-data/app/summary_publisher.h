@@ -0,0 +1,27 @@
+#pragma once
+
+#include "window_stats.h"
+
+#include <axsdk/axevent.h>
+#include <glib.h>
+
+/*
+ * Declares a stateless data event,
+ * tnsaxis:CameraApplicationPlatform/tnsaxis:SubscribeEventData/tnsaxis:SummaryEvent,
+ * and sends one such event per closed window. The data fields are Window
+ * (length in seconds), Count and, for every key, <key>Min, <key>Max,
+ * <key>Mean, <key>Variance, <key>P50, <key>P90 and <key>P99.
+ *
+ * Use from the GLib main loop thread only.
+ */
+typedef struct SummaryPublisher SummaryPublisher;
+
+SummaryPublisher* summary_publisher_new(AXEventHandler* event_handler,
+                                        const gchar* const* keys,
+                                        guint num_keys);
+void summary_publisher_free(SummaryPublisher* publisher);
+
+void summary_publisher_send(SummaryPublisher* publisher, const WindowSummary* summary);
+
+// Summaries sent, and summaries dropped because the declaration was not done yet
+void summary_publisher_get_stats(const SummaryPublisher* publisher, guint64* sent, guint64* dropped);
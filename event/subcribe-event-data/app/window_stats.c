@@ -0,0 +1,186 @@
+/*
+ * Windowed summary statistics
+ *
+ * Mean and variance use Welford's update, which stays accurate where the
+ * textbook sum of squares cancels out. The quantiles use a fixed sketch:
+ * bucket i holds magnitudes in (gamma^(i-1), gamma^i], so reporting the
+ * middle of the bucket is off by at most SKETCH_ACCURACY of the value,
+ * whatever the distribution. Positive and negative values have a bucket
+ * array each, and magnitudes below the smallest bucket count as zero.
+ */
+#include "window_stats.h"
+
+#include <math.h>
+#include <string.h>
+
+#define SKETCH_ACCURACY 0.02
+// 2 x 1024 buckets cover magnitudes from about 1e-9 to 8e8
+#define SKETCH_BUCKETS 1024
+#define SKETCH_OFFSET  (SKETCH_BUCKETS / 2)
+
+typedef struct {
+    guint32 positive[SKETCH_BUCKETS];
+    guint32 negative[SKETCH_BUCKETS];
+    guint64 zero;
+} Sketch;
+
+typedef struct {
+    guint64 count;
+    gdouble mean;
+    gdouble m2;  // sum of squared differences from the mean
+    gdouble min;
+    gdouble max;
+    Sketch sketch;
+} KeyStats;
+
+typedef struct {
+    gint64 length_us;
+    gint64 start_us;
+    guint64 count;
+    KeyStats keys[WINDOW_STATS_MAX_KEYS];
+} Window;
+
+struct WindowStats {
+    guint num_keys;
+    guint num_windows;
+    Window* windows;
+    WindowClosedFunc func;
+    gpointer user_data;
+
+    gdouble gamma;
+    gdouble log_gamma;
+};
+
+static gint bucket_index(const WindowStats* stats, gdouble magnitude) {
+    gdouble index = ceil(log(magnitude) / stats->log_gamma) + SKETCH_OFFSET;
+
+    if (!(index >= 0)) return -1;  // below the range or zero, counted as zero
+    if (index >= SKETCH_BUCKETS) return SKETCH_BUCKETS - 1;
+    return (gint)index;
+}
+
+static gdouble bucket_value(const WindowStats* stats, gint index) {
+    // Middle of (gamma^(i-1), gamma^i] in relative terms
+    return 2.0 * pow(stats->gamma, index - SKETCH_OFFSET) / (stats->gamma + 1.0);
+}
+
+static void sketch_add(const WindowStats* stats, Sketch* sketch, gdouble value) {
+    gint index = bucket_index(stats, fabs(value));
+
+    if (index < 0) sketch->zero++;
+    else if (value > 0) sketch->positive[index]++;
+    else sketch->negative[index]++;
+}
+
+// The value of the given rank, 0 is the smallest
+static gdouble sketch_value_at(const WindowStats* stats, const Sketch* sketch, guint64 rank) {
+    guint64 seen = 0;
+
+    // Most negative first, that is the largest negative magnitude
+    for (gint i = SKETCH_BUCKETS - 1; i >= 0; i--) {
+        seen += sketch->negative[i];
+        if (seen > rank) return -bucket_value(stats, i);
+    }
+    seen += sketch->zero;
+    if (seen > rank) return 0.0;
+    for (gint i = 0; i < SKETCH_BUCKETS; i++) {
+        seen += sketch->positive[i];
+        if (seen > rank) return bucket_value(stats, i);
+    }
+    return 0.0;
+}
+
+static gdouble key_quantile(const WindowStats* stats, const KeyStats* key, gdouble q) {
+    gdouble value = sketch_value_at(stats, &key->sketch, (guint64)(q * (gdouble)(key->count - 1)));
+
+    // The bucket middle may lie just outside what was really seen
+    return CLAMP(value, key->min, key->max);
+}
+
+static void key_add(const WindowStats* stats, KeyStats* key, gdouble value) {
+    key->count++;
+    gdouble delta = value - key->mean;
+    key->mean += delta / (gdouble)key->count;
+    key->m2 += delta * (value - key->mean);
+
+    if (key->count == 1 || value < key->min) key->min = value;
+    if (key->count == 1 || value > key->max) key->max = value;
+    sketch_add(stats, &key->sketch, value);
+}
+
+static void window_close(WindowStats* stats, Window* window) {
+    WindowSummary summary = {0};
+
+    summary.length_s = (guint)(window->length_us / G_USEC_PER_SEC);
+    summary.start_us = window->start_us;
+    summary.count    = window->count;
+    summary.num_keys = stats->num_keys;
+
+    for (guint i = 0; i < stats->num_keys; i++) {
+        const KeyStats* key  = &window->keys[i];
+        KeySummary* result   = &summary.keys[i];
+
+        result->min      = key->min;
+        result->max      = key->max;
+        result->mean     = key->mean;
+        result->variance = key->count > 1 ? key->m2 / (gdouble)(key->count - 1) : 0.0;
+        result->p50      = key_quantile(stats, key, 0.50);
+        result->p90      = key_quantile(stats, key, 0.90);
+        result->p99      = key_quantile(stats, key, 0.99);
+    }
+
+    stats->func(&summary, stats->user_data);
+
+    window->count = 0;
+    memset(window->keys, 0, stats->num_keys * sizeof(KeyStats));
+}
+
+WindowStats* window_stats_new(guint num_keys,
+                              const guint* lengths_s,
+                              guint num_windows,
+                              WindowClosedFunc func,
+                              gpointer user_data) {
+    WindowStats* stats = g_new0(WindowStats, 1);
+
+    stats->num_keys    = MIN(num_keys, WINDOW_STATS_MAX_KEYS);
+    stats->num_windows = num_windows;
+    stats->windows     = g_new0(Window, num_windows);
+    stats->func        = func;
+    stats->user_data   = user_data;
+    stats->gamma       = (1.0 + SKETCH_ACCURACY) / (1.0 - SKETCH_ACCURACY);
+    stats->log_gamma   = log(stats->gamma);
+
+    for (guint i = 0; i < num_windows; i++)
+        stats->windows[i].length_us = (gint64)MAX(lengths_s[i], 1u) * G_USEC_PER_SEC;
+    return stats;
+}
+
+void window_stats_free(WindowStats* stats) {
+    if (!stats) return;
+
+    g_free(stats->windows);
+    g_free(stats);
+}
+
+void window_stats_add(WindowStats* stats, gint64 time_us, const gdouble* values) {
+    for (guint w = 0; w < stats->num_windows; w++) {
+        Window* window = &stats->windows[w];
+        gint64 start   = time_us - time_us % window->length_us;
+
+        // Also closes the window when the clock was set back
+        if (window->count > 0 && start != window->start_us) window_close(stats, window);
+        window->start_us = start;
+
+        window->count++;
+        for (guint i = 0; i < stats->num_keys; i++) key_add(stats, &window->keys[i], values[i]);
+    }
+}
+
+void window_stats_flush(WindowStats* stats, gint64 now_us) {
+    for (guint w = 0; w < stats->num_windows; w++) {
+        Window* window = &stats->windows[w];
+
+        if (window->count > 0 && now_us >= window->start_us + window->length_us)
+            window_close(stats, window);
+    }
+}
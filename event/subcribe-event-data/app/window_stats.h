@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glib.h>
+
+#define WINDOW_STATS_MAX_KEYS 8
+
+typedef struct {
+    gdouble min;
+    gdouble max;
+    gdouble mean;
+    gdouble variance;  // sample variance, 0 below two samples
+    gdouble p50;
+    gdouble p90;
+    gdouble p99;
+} KeySummary;
+
+// One closed window, a plain value that can be copied to another thread
+typedef struct {
+    guint length_s;
+    gint64 start_us;  // wall clock, a multiple of the length
+    guint64 count;
+    guint num_keys;
+    KeySummary keys[WINDOW_STATS_MAX_KEYS];
+} WindowSummary;
+
+typedef void (*WindowClosedFunc)(const WindowSummary* summary, gpointer user_data);
+
+/*
+ * Streaming statistics over tumbling windows of several lengths, e.g. 1 s,
+ * 1 min and 1 h, aligned to the wall clock. Every sample updates all
+ * windows at once. Min, max, mean and variance are exact (Welford), the
+ * quantiles come from log-scale buckets and are within 2 % of the true
+ * value. Memory does not grow with the number of samples.
+ *
+ * A window is closed, and func called, by the first sample of the next
+ * window or by window_stats_flush once its end has passed. Windows without
+ * samples are not reported. Use from one thread.
+ */
+typedef struct WindowStats WindowStats;
+
+WindowStats* window_stats_new(guint num_keys,
+                              const guint* lengths_s,
+                              guint num_windows,
+                              WindowClosedFunc func,
+                              gpointer user_data);
+void window_stats_free(WindowStats* stats);
+
+// values holds one value per key
+void window_stats_add(WindowStats* stats, gint64 time_us, const gdouble* values);
+void window_stats_flush(WindowStats* stats, gint64 now_us);
@@ -0,0 +1,261 @@
+#include "bbox_publisher.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "channel_utils.h"
+
+/*
+ * Views that need the same transform share one bbox handle, so a
+ * detection is drawn on all of them with a single rectangle call.
+ */
+typedef struct {
+    bbox_t* bbox;
+    bbox_view_transform_t transform;
+    unsigned int views[BBOX_PUBLISHER_MAX_VIEWS];
+    size_t num_views;
+} view_group_t;
+
+struct bbox_publisher {
+    view_group_t groups[BBOX_PUBLISHER_MAX_VIEWS];
+    size_t num_groups;
+};
+
+static float aspect_of(VdoPair32u aspect_ratio, unsigned int rotation) {
+    if (aspect_ratio.w == 0u || aspect_ratio.h == 0u) {
+        return 0.0f;
+    }
+    if (rotation == 90u || rotation == 270u) {
+        return (float)aspect_ratio.h / (float)aspect_ratio.w;
+    }
+    return (float)aspect_ratio.w / (float)aspect_ratio.h;
+}
+
+/*
+ * Build the transform from source frame coordinates to view frame
+ * coordinates. The view is assumed to show the same scene centered and
+ * fitted to the same height, so only the horizontal extent changes with
+ * the aspect ratio.
+ */
+static bbox_view_transform_t make_transform(unsigned int source_channel, unsigned int view) {
+    unsigned int source_rotation = channel_util_get_image_rotation(source_channel);
+    unsigned int view_rotation = channel_util_get_image_rotation(view);
+    unsigned int rotation = (view_rotation + 360u - source_rotation) % 360u;
+    bbox_view_transform_t t = {.xx = 1.0f, .yy = 1.0f};
+
+    switch (rotation) {
+        case 90u:
+            t = (bbox_view_transform_t){.xy = -1.0f, .x0 = 1.0f, .yx = 1.0f};
+            break;
+        case 180u:
+            t = (bbox_view_transform_t){.xx = -1.0f, .x0 = 1.0f, .yy = -1.0f, .y0 = 1.0f};
+            break;
+        case 270u:
+            t = (bbox_view_transform_t){.xy = 1.0f, .yx = -1.0f, .y0 = 1.0f};
+            break;
+        default:
+            break;
+    }
+
+    /* Source aspect as seen in the view orientation */
+    float source_aspect = aspect_of(channel_util_get_aspect_ratio(source_channel), rotation);
+    float view_aspect = aspect_of(channel_util_get_aspect_ratio(view), 0u);
+    if (source_aspect > 0.0f && view_aspect > 0.0f) {
+        float scale = source_aspect / view_aspect;
+        t.xx *= scale;
+        t.xy *= scale;
+        t.x0 = t.x0 * scale + 0.5f * (1.0f - scale);
+    }
+
+    syslog(LOG_INFO,
+           "bbox view %u: rotation %u, x = %.3f*x %+.3f*y %+.3f, y = %.3f*x %+.3f*y %+.3f",
+           view,
+           rotation,
+           t.xx,
+           t.xy,
+           t.x0,
+           t.yx,
+           t.yy,
+           t.y0);
+    return t;
+}
+
+static bbox_t* create_bbox(const unsigned int* views, size_t num_views) {
+    /* bbox_new() is variadic, so each view count needs its own call */
+    switch (num_views) {
+        case 1:
+            return bbox_view_new(views[0]);
+        case 2:
+            return bbox_new(2u, views[0], views[1]);
+        case 3:
+            return bbox_new(3u, views[0], views[1], views[2]);
+        case 4:
+            return bbox_new(4u, views[0], views[1], views[2], views[3]);
+        case 5:
+            return bbox_new(5u, views[0], views[1], views[2], views[3], views[4]);
+        case 6:
+            return bbox_new(6u, views[0], views[1], views[2], views[3], views[4], views[5]);
+        case 7:
+            return bbox_new(7u, views[0], views[1], views[2], views[3], views[4], views[5], views[6]);
+        case 8:
+            return bbox_new(8u,
+                            views[0],
+                            views[1],
+                            views[2],
+                            views[3],
+                            views[4],
+                            views[5],
+                            views[6],
+                            views[7]);
+        default:
+            errno = EINVAL;
+            return NULL;
+    }
+}
+
+/*
+ * Create a publisher drawing detections from source_channel on all views.
+ * Transforms are computed here once, never per box.
+ */
+/*
+ * Clear the drawing and set up how boxes are drawn. The coordinate space and
+ * style are set again after every clear, so the normalized rectangles never
+ * land in the default coordinate space.
+ */
+static void clear_and_setup(bbox_t* bbox) {
+    bbox_clear(bbox);
+    bbox_coordinates_frame_normalized(bbox);
+    bbox_style_outline(bbox);
+    bbox_thickness_thin(bbox);
+    bbox_color(bbox, bbox_color_from_rgb(0xff, 0x00, 0x00));
+}
+
+bbox_publisher_t* bbox_publisher_new(unsigned int source_channel,
+                                     const unsigned int* views,
+                                     size_t num_views) {
+    if (num_views == 0 || num_views > BBOX_PUBLISHER_MAX_VIEWS) {
+        syslog(LOG_ERR, "bbox publisher supports 1 to %u views", BBOX_PUBLISHER_MAX_VIEWS);
+        return NULL;
+    }
+
+    bbox_publisher_t* publisher = calloc(1, sizeof(*publisher));
+    if (!publisher) {
+        syslog(LOG_ERR, "calloc bbox publisher: %s", strerror(errno));
+        return NULL;
+    }
+
+    for (size_t i = 0; i < num_views; i++) {
+        bbox_view_transform_t transform = make_transform(source_channel, views[i]);
+        view_group_t* group = NULL;
+
+        for (size_t g = 0; g < publisher->num_groups; g++) {
+            if (memcmp(&publisher->groups[g].transform, &transform, sizeof(transform)) == 0) {
+                group = &publisher->groups[g];
+                break;
+            }
+        }
+        if (!group) {
+            group = &publisher->groups[publisher->num_groups++];
+            group->transform = transform;
+        }
+        group->views[group->num_views++] = views[i];
+    }
+
+    for (size_t g = 0; g < publisher->num_groups; g++) {
+        view_group_t* group = &publisher->groups[g];
+
+        group->bbox = create_bbox(group->views, group->num_views);
+        if (!group->bbox) {
+            syslog(LOG_ERR, "Failed to create box drawer: %s", strerror(errno));
+            bbox_publisher_destroy(publisher);
+            return NULL;
+        }
+
+        clear_and_setup(group->bbox);
+    }
+
+    syslog(LOG_INFO,
+           "bbox publisher: %zu views in %zu handles",
+           num_views,
+           publisher->num_groups);
+    return publisher;
+}
+
+static float clamp01(float value) {
+    if (value < 0.0f) {
+        return 0.0f;
+    }
+    if (value > 1.0f) {
+        return 1.0f;
+    }
+    return value;
+}
+
+/*
+ * Draw one frame of detections on every view and commit them together.
+ * Boxes that end up outside a view are left out of that view only.
+ */
+bool bbox_publisher_commit(bbox_publisher_t* publisher,
+                           const bbox_detection_t* detections,
+                           size_t num_detections) {
+    if (!publisher || (num_detections > 0 && !detections)) {
+        return false;
+    }
+
+    for (size_t g = 0; g < publisher->num_groups; g++) {
+        clear_and_setup(publisher->groups[g].bbox);
+    }
+
+    for (size_t i = 0; i < num_detections; i++) {
+        const bbox_detection_t* d = &detections[i];
+
+        for (size_t g = 0; g < publisher->num_groups; g++) {
+            const bbox_view_transform_t* t = &publisher->groups[g].transform;
+            float ax = t->xx * d->x_min + t->xy * d->y_min + t->x0;
+            float ay = t->yx * d->x_min + t->yy * d->y_min + t->y0;
+            float bx = t->xx * d->x_max + t->xy * d->y_max + t->x0;
+            float by = t->yx * d->x_max + t->yy * d->y_max + t->y0;
+
+            float x_min = clamp01(ax < bx ? ax : bx);
+            float x_max = clamp01(ax < bx ? bx : ax);
+            float y_min = clamp01(ay < by ? ay : by);
+            float y_max = clamp01(ay < by ? by : ay);
+            if (x_min >= x_max || y_min >= y_max) {
+                continue;
+            }
+
+            bbox_rectangle(publisher->groups[g].bbox, x_min, y_min, x_max, y_max);
+        }
+    }
+
+    bool ok = true;
+    for (size_t g = 0; g < publisher->num_groups; g++) {
+        if (!bbox_commit(publisher->groups[g].bbox, 0u)) {
+            syslog(LOG_ERR,
+                   "Failed to commit box drawer for view %u: %s",
+                   publisher->groups[g].views[0],
+                   strerror(errno));
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+void bbox_publisher_destroy(bbox_publisher_t* publisher) {
+    if (!publisher) {
+        return;
+    }
+
+    for (size_t g = 0; g < publisher->num_groups; g++) {
+        if (publisher->groups[g].bbox) {
+            clear_and_setup(publisher->groups[g].bbox);
+            bbox_commit(publisher->groups[g].bbox, 0u);
+            bbox_destroy(publisher->groups[g].bbox);
+        }
+    }
+    free(publisher);
+}
@@ -0,0 +1,41 @@
+#ifndef BBOX_PUBLISHER_H
+#define BBOX_PUBLISHER_H
+
+#include <bbox.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define BBOX_PUBLISHER_MAX_VIEWS 8u
+
+/* One detection in frame normalized coordinates of the source channel. */
+typedef struct {
+    float x_min;
+    float y_min;
+    float x_max;
+    float y_max;
+} bbox_detection_t;
+
+/*
+ * Maps source frame coordinates into one view: rotate, then scale around
+ * the center. Computed once per view when the publisher is created.
+ */
+typedef struct {
+    float xx;
+    float xy;
+    float x0;
+    float yx;
+    float yy;
+    float y0;
+} bbox_view_transform_t;
+
+typedef struct bbox_publisher bbox_publisher_t;
+
+bbox_publisher_t* bbox_publisher_new(unsigned int source_channel,
+                                     const unsigned int* views,
+                                     size_t num_views);
+bool bbox_publisher_commit(bbox_publisher_t* publisher,
+                           const bbox_detection_t* detections,
+                           size_t num_detections);
+void bbox_publisher_destroy(bbox_publisher_t* publisher);
+
+#endif
@@ -0,0 +1,77 @@
+// Copyright (C) 2026 Axis Communications AB, Lund, Sweden
+// Licensed under the MIT License. See LICENSE file for details.
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Abstract Unix socket where the renderer hands out the ring memfd
+#define DRAW_RING_SOCKET_NAME "acap-draw-commands"
+#define DRAW_RING_MAGIC 0x44524157u
+#define DRAW_RING_VERSION 2u
+// Must be a power of two
+#define DRAW_RING_CAPACITY 256u
+// Coordinates are normalized to the frame, 0..DRAW_COORD_MAX
+#define DRAW_COORD_MAX 65535u
+// Label bytes including the terminating NUL, an empty label draws nothing
+#define DRAW_TEXT_MAX 36u
+
+enum draw_command_type {
+    // Start a new frame, drop whatever the previous frame drew
+    DRAW_CMD_CLEAR = 1,
+    DRAW_CMD_RECT,
+    DRAW_CMD_TEXT,
+    // End of frame, the renderer shows everything since DRAW_CMD_CLEAR
+    DRAW_CMD_COMMIT,
+};
+
+// One draw command, 64 bytes so each fills one cache line
+struct draw_command {
+    uint64_t timestamp_us;
+    uint16_t type;
+    uint16_t reserved;
+    uint32_t color_argb;
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint32_t channel;
+    char text[DRAW_TEXT_MAX];
+};
+
+// Shared by one producer and one consumer. head is only written by the
+// producer and tail only by the consumer, each on its own cache line.
+struct draw_ring {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t command_size;
+    _Alignas(64) atomic_uint head;
+    _Alignas(64) atomic_uint tail;
+    _Alignas(64) atomic_uint dropped_frames;
+    _Alignas(64) struct draw_command commands[DRAW_RING_CAPACITY];
+};
+
+// Renderer side
+struct draw_ring* draw_ring_create(int* memfd);
+void draw_ring_reset(struct draw_ring* ring);
+int draw_ring_listen(void);
+bool draw_ring_send_fd(int socket_fd, int memfd);
+size_t draw_ring_consume(struct draw_ring* ring, struct draw_command* commands, size_t max_commands);
+
+// Publisher side
+struct draw_ring* draw_ring_connect(int* socket_fd);
+bool draw_ring_publish(struct draw_ring* ring, const struct draw_command* commands, size_t count);
+
+void draw_ring_unmap(struct draw_ring* ring);
+
+static inline uint16_t draw_ring_coord(float normalized) {
+    if (normalized <= 0.0f)
+        return 0;
+    if (normalized >= 1.0f)
+        return DRAW_COORD_MAX;
+    return (uint16_t)(normalized * (float)DRAW_COORD_MAX);
+}
@@ -1,6 +1,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -8,6 +9,7 @@
 #include <string.h>
 #include <sys/mman.h>
 #include <syslog.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <glib.h>
@@ -36,7 +38,8 @@
  *  9. Start the stream and poll for frames.
  * 10. Run optional preprocessing for each frame.
  * 11. Run inference.
- * 12. Parse the SSD model outputs and draw normalized bounding boxes with bbox.
+ * 12. Parse the SSD model outputs and draw normalized bounding boxes, through
+ *     the overlay2 draw-commands renderer when it runs, otherwise with bbox.
  * 13. Return each VDO buffer so it can be reused.
  * 14. Clean up resources on exit.
  */
@@ -70,6 +73,29 @@
 #define MAX_TRACKED_BUFFERS 5u
 #define MAX_OUTPUT_TENSORS 4u
 
+/*
+ * Views the detections are drawn on. The boxes are transformed from
+ * VDO_CHANNEL into each view, taking rotation and aspect ratio into account.
+ */
+static const unsigned int BBOX_VIEWS[] = {1u, VDO_CHANNEL};
+
+/*
+ * Tracked boxes are extrapolated and committed at this period by a display
+ * thread, so they keep moving smoothly while inference, which blocks the main
+ * loop, is slower than the display.
+ */
+#define DISPLAY_PERIOD_MS ((int)(1000.0 / VDO_FRAMERATE))
+// Only bounds how long a stop request can go unnoticed
+#define POLL_TIMEOUT_MS 1000
+
+/*
+ * A draw-commands renderer that went away is detected on its socket. One
+ * that stopped reading is given up after this many inference results could
+ * not be published. Without a renderer a new connection is tried this often.
+ */
+#define DRAW_STALL_FRAMES 30
+#define DRAW_RECONNECT_MS 5000
+
 static unsigned int MODEL_WIDTH = 0;
 static unsigned int MODEL_HEIGHT = 0;
 static volatile sig_atomic_t running = 1;
@@ -96,11 +122,92 @@ typedef struct {
     int vdo_fd;
 } tracked_input_t;
 
+/*
+ * Shared by the main loop and the display thread. The tracker, the bbox
+ * publisher and the draw ring pointer are only used with lock held.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    bbox_publisher_t* publisher;
+    tracker_t* tracker;
+    struct draw_ring** draw_ring;
+} display_t;
+
 static void on_signal(int sig) {
     (void)sig;
     running = 0;
 }
 
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+/*
+ * Hand drawing over to the draw-commands renderer. Whatever bbox showed is
+ * cleared, and the tracker starts over so it does not believe its boxes are
+ * still drawn.
+ */
+static bool use_draw_ring(struct draw_ring** ring,
+                          int* socket_fd,
+                          bbox_publisher_t* publisher,
+                          tracker_t* tracker) {
+    *ring = draw_ring_connect(socket_fd);
+    if (!*ring) {
+        return false;
+    }
+    bbox_publisher_commit(publisher, NULL, 0);
+    tracker_init(tracker);
+    syslog(LOG_INFO, "Publishing boxes to the draw-commands renderer");
+    return true;
+}
+
+/* Drop the renderer connection and draw with bbox again. */
+static void use_bbox(struct draw_ring** ring, int* socket_fd, tracker_t* tracker) {
+    draw_ring_unmap(*ring);
+    *ring = NULL;
+    if (*socket_fd >= 0) {
+        close(*socket_fd);
+        *socket_fd = -1;
+    }
+    tracker_init(tracker);
+}
+
+/*
+ * Commit the tracked boxes, predicted to now, once per display period. Only
+ * boxes drawn with bbox are interpolated, the draw-commands renderer gets the
+ * inference results as they are.
+ */
+static void* display_thread(void* arg) {
+    display_t* display = arg;
+    struct timespec next;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (running) {
+        next.tv_nsec += DISPLAY_PERIOD_MS * 1000000L;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        pthread_mutex_lock(&display->lock);
+        if (!*display->draw_ring) {
+            publish_tracked_boxes(display->publisher, display->tracker);
+        }
+        pthread_mutex_unlock(&display->lock);
+
+        /* After a long stall, start over instead of catching up */
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > next.tv_sec + 1) {
+            next = now;
+        }
+    }
+    return NULL;
+}
+
 static bool backend_supports_rgb(const char* device_name) {
     return strcmp(device_name, "a9-dlpu-tflite") == 0;
 }
@@ -510,7 +617,12 @@ int main(int argc, char** argv) {
     (void)argv;
 
     const int threshold = 50;
-    bbox_t* bbox = NULL;
+    bbox_publisher_t* bbox_publisher = NULL;
+    tracker_t tracker;
+    struct draw_ring* draw_ring = NULL;
+    int draw_socket = -1;
+    display_t display = {.lock = PTHREAD_MUTEX_INITIALIZER};
+    pthread_t display_tid;
     larodConnection* conn = NULL;
     larodModel* inf_model = NULL;
     larodModel* pp_model = NULL;
@@ -595,14 +707,35 @@ int main(int argc, char** argv) {
     /*
      * BBox setup
      *
-     * bbox draws rectangles in the camera view. The postprocess function uses
+     * bbox draws rectangles in the camera views. The postprocess function uses
      * normalized coordinates from the SSD model, so the boxes scale with the
-     * displayed frame.
+     * displayed frame. The publisher precomputes one transform per view and
+     * commits each detection array to all views in one pass.
+     */
+    bbox_publisher = bbox_publisher_new(VDO_CHANNEL,
+                                        BBOX_VIEWS,
+                                        sizeof(BBOX_VIEWS) / sizeof(BBOX_VIEWS[0]));
+    if (!bbox_publisher) {
+        PANIC("bbox_publisher_new failed");
+    }
+
+    /*
+     * The tracker sits between postprocess and bbox. It matches detections
+     * across frames, smooths them, and only lets a commit through when a box
+     * moved more than a small threshold.
      */
-    bbox = setup_bbox(VDO_CHANNEL);
-    if (!bbox) {
-        PANIC("setup_bbox failed");
+    tracker_init(&tracker);
+
+    /*
+     * When the overlay2 draw-commands renderer is installed and running, the
+     * boxes are written into its shared memory ring instead. Publishing a
+     * frame then costs no syscalls and the renderer owns all overlay work.
+     */
+    if (!use_draw_ring(&draw_ring, &draw_socket, bbox_publisher, &tracker)) {
+        syslog(LOG_INFO, "No draw-commands renderer, drawing boxes with bbox");
     }
+    uint64_t next_draw_connect_ms = monotonic_ms() + DRAW_RECONNECT_MS;
+    int stalled_frames = 0;
 
     /*
      * STEP 9 - Start the stream and poll for frames.
@@ -618,20 +751,69 @@ int main(int argc, char** argv) {
         PANIC("vdo_stream_get_fd: %s", vdo_error ? vdo_error->message : "unknown error");
     }
 
-    struct pollfd pfd = {.fd = poll_fd, .events = POLLIN};
+    /*
+     * The renderer socket is watched too, poll reports a hangup when the
+     * renderer exits or restarts. A negative fd is ignored by poll.
+     */
+    /*
+     * The display thread starts with SIGINT and SIGTERM blocked, so the
+     * signals always interrupt the main loop's poll.
+     */
+    display.publisher = bbox_publisher;
+    display.tracker = &tracker;
+    display.draw_ring = &draw_ring;
+    sigset_t stop_signals, old_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, &old_signals);
+    if (pthread_create(&display_tid, NULL, display_thread, &display) != 0) {
+        PANIC("pthread_create: %s", strerror(errno));
+    }
+    pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+
+    struct pollfd pfds[2] = {
+        {.fd = poll_fd, .events = POLLIN},
+        {.fd = draw_socket, .events = POLLIN},
+    };
     syslog(LOG_INFO, "Entering inference loop");
 
     while (running) {
         larodError* error = NULL;
         int ret;
 
-        /* STEP 9a - Wait until the VDO stream has a frame available. */
+        if (!draw_ring && monotonic_ms() >= next_draw_connect_ms) {
+            next_draw_connect_ms = monotonic_ms() + DRAW_RECONNECT_MS;
+            pthread_mutex_lock(&display.lock);
+            if (use_draw_ring(&draw_ring, &draw_socket, bbox_publisher, &tracker)) {
+                pfds[1].fd = draw_socket;
+                stalled_frames = 0;
+            }
+            pthread_mutex_unlock(&display.lock);
+        }
+
+        /*
+         * STEP 9a - Wait until the VDO stream has a frame available. The
+         * display thread moves the tracked boxes along meanwhile.
+         */
         do {
-            ret = poll(&pfd, 1, -1);
-        } while (ret == -1 && errno == EINTR);
-        if (ret < 0) {
+            ret = poll(pfds, 2, POLL_TIMEOUT_MS);
+            if (ret > 0 && pfds[1].revents) {
+                syslog(LOG_WARNING, "Draw-commands renderer went away, drawing boxes with bbox");
+                pthread_mutex_lock(&display.lock);
+                use_bbox(&draw_ring, &draw_socket, &tracker);
+                pthread_mutex_unlock(&display.lock);
+                pfds[1].fd = -1;
+                next_draw_connect_ms = monotonic_ms() + DRAW_RECONNECT_MS;
+            }
+        } while (running &&
+                 (ret == 0 || (ret == -1 && errno == EINTR) || (ret > 0 && !pfds[0].revents)));
+        if (ret < 0 && errno != EINTR) {
             PANIC("poll: %s", strerror(errno));
         }
+        if (ret <= 0 || !pfds[0].revents) {
+            break;
+        }
 
         /* STEP 9b - Fetch one VDO buffer from the stream. */
         VdoBuffer* vdo_buf = vdo_stream_get_buffer(vdo_stream, &vdo_error);
@@ -715,9 +897,26 @@ int main(int argc, char** argv) {
          */
         if (num_inf_outputs >= MAX_OUTPUT_TENSORS) {
             float confidence_threshold = (float)threshold / 100.0f;
-            if (!parse_and_postprocess_output_tensors(bbox, out_bufs, confidence_threshold)) {
+            pthread_mutex_lock(&display.lock);
+            bool published = parse_and_postprocess_output_tensors(bbox_publisher,
+                                                                  &tracker,
+                                                                  draw_ring,
+                                                                  VDO_CHANNEL,
+                                                                  out_bufs,
+                                                                  confidence_threshold);
+            if (draw_ring) {
+                /* A renderer that stopped reading leaves its ring full */
+                stalled_frames = published ? 0 : stalled_frames + 1;
+                if (stalled_frames >= DRAW_STALL_FRAMES) {
+                    syslog(LOG_WARNING, "Draw-commands renderer stopped reading, drawing boxes with bbox");
+                    use_bbox(&draw_ring, &draw_socket, &tracker);
+                    pfds[1].fd = -1;
+                    next_draw_connect_ms = monotonic_ms() + DRAW_RECONNECT_MS;
+                }
+            } else if (!published) {
                 syslog(LOG_ERR, "Failed to postprocess output tensors");
             }
+            pthread_mutex_unlock(&display.lock);
         }
 
         /*
@@ -738,10 +937,13 @@ int main(int argc, char** argv) {
      * STEP 14 - Cleanup.
      *
      * Stop VDO, unmap output buffers, destroy larod jobs/tensors/models, close
-     * fds, and remove the bbox handle.
+     * fds, and remove the bbox handle and draw ring.
      */
     syslog(LOG_INFO, "Shutting down");
 
+    running = 0;
+    pthread_join(display_tid, NULL);
+
     if (vdo_stream) {
         vdo_stream_stop(vdo_stream);
         g_object_unref(vdo_stream);
@@ -781,8 +983,10 @@ int main(int argc, char** argv) {
     if (model_fd >= 0) {
         close(model_fd);
     }
-    if (bbox) {
-        bbox_destroy(bbox);
+    bbox_publisher_destroy(bbox_publisher);
+    draw_ring_unmap(draw_ring);
+    if (draw_socket >= 0) {
+        close(draw_socket);
     }
     g_clear_error(&vdo_error);
     closelog();
@@ -1,9 +1,11 @@
 #include "postprocess.h"
 
 #include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <syslog.h>
+#include <time.h>
 
 typedef struct {
     float y_min;
@@ -14,25 +16,85 @@ typedef struct {
     int label;
 } box_t;
 
-bbox_t* setup_bbox(uint32_t channel) {
-    bbox_t* bbox = bbox_view_new(channel);
-    if (!bbox) {
-        syslog(LOG_ERR, "Failed to create box drawer");
-        return NULL;
+static uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+/*
+ * Publish one frame of detections to an overlay2 draw-commands renderer.
+ * Nothing is drawn until the final DRAW_CMD_COMMIT, so the renderer never
+ * shows half a frame.
+ */
+static bool publish_boxes(struct draw_ring* ring,
+                          uint32_t channel,
+                          const box_t* boxes,
+                          int number_of_detections,
+                          float confidence_threshold) {
+    struct draw_command commands[DRAW_RING_CAPACITY];
+    uint64_t timestamp_us = monotonic_us();
+    size_t count = 0;
+
+    commands[count++] = (struct draw_command){.timestamp_us = timestamp_us, .type = DRAW_CMD_CLEAR};
+    for (int i = 0; i < number_of_detections && count < DRAW_RING_CAPACITY - 1; i++) {
+        if (boxes[i].score < confidence_threshold) {
+            continue;
+        }
+        commands[count] = (struct draw_command){
+            .timestamp_us = timestamp_us,
+            .type = DRAW_CMD_RECT,
+            .color_argb = 0xffff0000u,
+            .x = draw_ring_coord(boxes[i].x_min),
+            .y = draw_ring_coord(boxes[i].y_min),
+            .width = draw_ring_coord(boxes[i].x_max - boxes[i].x_min),
+            .height = draw_ring_coord(boxes[i].y_max - boxes[i].y_min),
+            .channel = channel,
+        };
+        snprintf(commands[count].text,
+                 sizeof(commands[count].text),
+                 "class %d %.0f%%",
+                 boxes[i].label,
+                 boxes[i].score * 100.0f);
+        count++;
     }
+    commands[count++] = (struct draw_command){.timestamp_us = timestamp_us, .type = DRAW_CMD_COMMIT};
 
-    bbox_clear(bbox);
-    bbox_style_outline(bbox);
-    bbox_thickness_thin(bbox);
-    bbox_color(bbox, bbox_color_from_rgb(0xff, 0x00, 0x00));
+    /*
+     * A full ring means the renderer is behind, this frame is skipped and
+     * false tells the caller, which gives up on a renderer that stays full.
+     */
+    return draw_ring_publish(ring, commands, count);
+}
 
-    return bbox;
+/*
+ * Commit the tracked boxes, predicted to now, if any of them moved enough
+ * to be visible. Called after each inference frame and between frames.
+ */
+bool publish_tracked_boxes(bbox_publisher_t* publisher, tracker_t* tracker) {
+    bbox_detection_t boxes[TRACKER_MAX_TRACKS];
+    bool changed = false;
+    uint64_t now_us = monotonic_us();
+
+    size_t count = tracker_snapshot(tracker, now_us, boxes, TRACKER_MAX_TRACKS, &changed);
+    if (!changed) {
+        return true;
+    }
+    /* A failed commit leaves the boxes undrawn, so the next call retries */
+    if (!bbox_publisher_commit(publisher, boxes, count)) {
+        return false;
+    }
+    tracker_mark_drawn(tracker, now_us);
+    return true;
 }
 
-bool parse_and_postprocess_output_tensors(bbox_t* bbox,
+bool parse_and_postprocess_output_tensors(bbox_publisher_t* publisher,
+                                          tracker_t* tracker,
+                                          struct draw_ring* ring,
+                                          uint32_t channel,
                                           output_buf_t* tensor_outputs,
                                           float confidence_threshold) {
-    if (!bbox || !tensor_outputs) {
+    if ((!publisher && !ring) || !tensor_outputs) {
         return false;
     }
 
@@ -48,8 +110,14 @@ bool parse_and_postprocess_output_tensors(bbox_t* bbox,
 
     int number_of_detections = (int)nbr_detections[0];
     if (number_of_detections <= 0) {
-        bbox_clear(bbox);
-        return bbox_commit(bbox, 0u);
+        if (ring) {
+            return publish_boxes(ring, channel, NULL, 0, confidence_threshold);
+        }
+        if (tracker) {
+            tracker_update(tracker, NULL, 0, monotonic_us());
+            return publish_tracked_boxes(publisher, tracker);
+        }
+        return bbox_publisher_commit(publisher, NULL, 0);
     }
 
     box_t* boxes = calloc((size_t)number_of_detections, sizeof(*boxes));
@@ -67,8 +135,19 @@ bool parse_and_postprocess_output_tensors(bbox_t* bbox,
         boxes[i].label = (int)classes[i];
     }
 
-    bbox_clear(bbox);
-    bbox_coordinates_frame_normalized(bbox);
+    if (ring) {
+        bool published = publish_boxes(ring, channel, boxes, number_of_detections, confidence_threshold);
+        free(boxes);
+        return published;
+    }
+
+    bbox_detection_t* accepted = calloc((size_t)number_of_detections, sizeof(*accepted));
+    size_t num_accepted = 0;
+    if (!accepted) {
+        syslog(LOG_ERR, "calloc detections: %s", strerror(errno));
+        free(boxes);
+        return false;
+    }
 
     for (int i = 0; i < number_of_detections; i++) {
         if (boxes[i].score >= confidence_threshold) {
@@ -81,16 +160,30 @@ bool parse_and_postprocess_output_tensors(bbox_t* bbox,
                    boxes[i].y_min,
                    boxes[i].x_max,
                    boxes[i].y_max);
-            bbox_rectangle(bbox, boxes[i].x_min, boxes[i].y_min, boxes[i].x_max, boxes[i].y_max);
+            bbox_detection_t detection = {
+                .x_min = boxes[i].x_min,
+                .y_min = boxes[i].y_min,
+                .x_max = boxes[i].x_max,
+                .y_max = boxes[i].y_max,
+            };
+            accepted[num_accepted++] = detection;
         }
     }
 
-    free(boxes);
-
-    if (!bbox_commit(bbox, 0u)) {
-        syslog(LOG_ERR, "Failed to commit box drawer");
-        return false;
+    /*
+     * With a tracker the detections only correct the tracks, and bbox is
+     * committed when a tracked box moved. Otherwise one pass over the
+     * detections draws them on every view.
+     */
+    bool committed;
+    if (tracker) {
+        tracker_update(tracker, accepted, num_accepted, monotonic_us());
+        committed = publish_tracked_boxes(publisher, tracker);
+    } else {
+        committed = bbox_publisher_commit(publisher, accepted, num_accepted);
     }
+    free(accepted);
+    free(boxes);
 
-    return true;
+    return committed;
 }
@@ -1,20 +1,26 @@
 #ifndef POSTPROCESS_H
 #define POSTPROCESS_H
 
-#include <bbox.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#include "bbox_publisher.h"
+#include "draw_command_ring.h"
+#include "tracker.h"
+
 typedef struct {
     int fd;
     void* data;
     size_t size;
 } output_buf_t;
 
-bbox_t* setup_bbox(uint32_t channel);
-bool parse_and_postprocess_output_tensors(bbox_t* bbox,
+bool parse_and_postprocess_output_tensors(bbox_publisher_t* publisher,
+                                          tracker_t* tracker,
+                                          struct draw_ring* ring,
+                                          uint32_t channel,
                                           output_buf_t* tensor_outputs,
                                           float confidence_threshold);
+bool publish_tracked_boxes(bbox_publisher_t* publisher, tracker_t* tracker);
 
 #endif
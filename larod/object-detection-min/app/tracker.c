@@ -0,0 +1,256 @@
+#include "tracker.h"
+
+#include <math.h>
+#include <string.h>
+
+/*
+ * Tracker tuning
+ *
+ * Detections are matched to tracks by IoU, then smoothed with an alpha-beta
+ * filter, a constant-velocity filter with fixed gains. ALPHA is how far the
+ * position moves towards a new detection, BETA how much of the residual
+ * goes into the velocity.
+ */
+#define ASSOCIATION_IOU 0.3f
+#define ALPHA 0.5f
+#define BETA 0.1f
+/* A track is drawn after this many matched detections */
+#define MIN_HITS 2u
+/* and dropped after this many inference frames without a match */
+#define MAX_MISSES 5u
+/* Never extrapolate further than this from the last detection */
+#define MAX_PREDICT_US 500000u
+/* Commit only when a box moved or resized more than this, normalized */
+#define MOVE_THRESHOLD 0.01f
+/* Detections beyond this are ignored, SSD sorts them by score */
+#define MAX_DETECTIONS 64u
+
+static float seconds_since(const tracker_t* t, size_t i, uint64_t now_us) {
+    if (now_us <= t->updated_us[i]) {
+        return 0.0f;
+    }
+    uint64_t dt_us = now_us - t->updated_us[i];
+    if (dt_us > MAX_PREDICT_US) {
+        dt_us = MAX_PREDICT_US;
+    }
+    return (float)dt_us / 1e6f;
+}
+
+static float iou(float acx, float acy, float aw, float ah, const bbox_detection_t* b) {
+    float x1 = fmaxf(acx - aw / 2.0f, b->x_min);
+    float y1 = fmaxf(acy - ah / 2.0f, b->y_min);
+    float x2 = fminf(acx + aw / 2.0f, b->x_max);
+    float y2 = fminf(acy + ah / 2.0f, b->y_max);
+    if (x2 <= x1 || y2 <= y1) {
+        return 0.0f;
+    }
+
+    float intersection = (x2 - x1) * (y2 - y1);
+    float area_b = (b->x_max - b->x_min) * (b->y_max - b->y_min);
+    return intersection / (aw * ah + area_b - intersection);
+}
+
+static void move_track(tracker_t* t, size_t dst, size_t src) {
+    t->id[dst] = t->id[src];
+    t->cx[dst] = t->cx[src];
+    t->cy[dst] = t->cy[src];
+    t->w[dst] = t->w[src];
+    t->h[dst] = t->h[src];
+    t->vx[dst] = t->vx[src];
+    t->vy[dst] = t->vy[src];
+    t->updated_us[dst] = t->updated_us[src];
+    t->hits[dst] = t->hits[src];
+    t->misses[dst] = t->misses[src];
+    t->drawn_cx[dst] = t->drawn_cx[src];
+    t->drawn_cy[dst] = t->drawn_cy[src];
+    t->drawn_w[dst] = t->drawn_w[src];
+    t->drawn_h[dst] = t->drawn_h[src];
+    t->drawn[dst] = t->drawn[src];
+}
+
+void tracker_init(tracker_t* tracker) {
+    memset(tracker, 0, sizeof(*tracker));
+    tracker->next_id = 1;
+}
+
+/*
+ * Feed one inference frame of detections into the tracker.
+ *
+ * Tracks are predicted to now_us and greedily matched to the detection
+ * with the highest IoU. Matched tracks are corrected, unmatched tracks
+ * coast on their velocity until MAX_MISSES, and unmatched detections start
+ * new tracks.
+ */
+void tracker_update(tracker_t* tracker,
+                    const bbox_detection_t* detections,
+                    size_t num_detections,
+                    uint64_t now_us) {
+    float px[TRACKER_MAX_TRACKS];
+    float py[TRACKER_MAX_TRACKS];
+    bool track_matched[TRACKER_MAX_TRACKS] = {false};
+    bool detection_matched[MAX_DETECTIONS] = {false};
+
+    if (num_detections > MAX_DETECTIONS) {
+        num_detections = MAX_DETECTIONS;
+    }
+
+    for (size_t i = 0; i < tracker->count; i++) {
+        float dt = seconds_since(tracker, i, now_us);
+        px[i] = tracker->cx[i] + tracker->vx[i] * dt;
+        py[i] = tracker->cy[i] + tracker->vy[i] * dt;
+    }
+
+    for (;;) {
+        float best = ASSOCIATION_IOU;
+        size_t best_track = 0;
+        size_t best_detection = 0;
+        bool found = false;
+
+        for (size_t i = 0; i < tracker->count; i++) {
+            if (track_matched[i]) {
+                continue;
+            }
+            for (size_t d = 0; d < num_detections; d++) {
+                if (detection_matched[d]) {
+                    continue;
+                }
+                float score = iou(px[i], py[i], tracker->w[i], tracker->h[i], &detections[d]);
+                if (score >= best) {
+                    best = score;
+                    best_track = i;
+                    best_detection = d;
+                    found = true;
+                }
+            }
+        }
+        if (!found) {
+            break;
+        }
+
+        size_t i = best_track;
+        const bbox_detection_t* d = &detections[best_detection];
+        float dt = seconds_since(tracker, i, now_us);
+        float rx = (d->x_min + d->x_max) / 2.0f - px[i];
+        float ry = (d->y_min + d->y_max) / 2.0f - py[i];
+
+        tracker->cx[i] = px[i] + ALPHA * rx;
+        tracker->cy[i] = py[i] + ALPHA * ry;
+        if (dt > 0.0f) {
+            tracker->vx[i] += BETA * rx / dt;
+            tracker->vy[i] += BETA * ry / dt;
+        }
+        tracker->w[i] += ALPHA * ((d->x_max - d->x_min) - tracker->w[i]);
+        tracker->h[i] += ALPHA * ((d->y_max - d->y_min) - tracker->h[i]);
+        tracker->updated_us[i] = now_us;
+        if (tracker->hits[i] < UINT8_MAX) {
+            tracker->hits[i]++;
+        }
+        tracker->misses[i] = 0;
+
+        track_matched[i] = true;
+        detection_matched[best_detection] = true;
+    }
+
+    /* Walk backwards so swap-removal does not skip a track */
+    for (size_t i = tracker->count; i-- > 0;) {
+        if (track_matched[i]) {
+            continue;
+        }
+        if (++tracker->misses[i] <= MAX_MISSES) {
+            continue;
+        }
+        if (tracker->drawn[i]) {
+            tracker->removed_drawn = true;
+        }
+        tracker->count--;
+        if (i != tracker->count) {
+            move_track(tracker, i, tracker->count);
+            track_matched[i] = track_matched[tracker->count];
+        }
+    }
+
+    for (size_t d = 0; d < num_detections && tracker->count < TRACKER_MAX_TRACKS; d++) {
+        if (detection_matched[d]) {
+            continue;
+        }
+        size_t i = tracker->count++;
+        tracker->id[i] = tracker->next_id++;
+        tracker->cx[i] = (detections[d].x_min + detections[d].x_max) / 2.0f;
+        tracker->cy[i] = (detections[d].y_min + detections[d].y_max) / 2.0f;
+        tracker->w[i] = detections[d].x_max - detections[d].x_min;
+        tracker->h[i] = detections[d].y_max - detections[d].y_min;
+        tracker->vx[i] = 0.0f;
+        tracker->vy[i] = 0.0f;
+        tracker->updated_us[i] = now_us;
+        tracker->hits[i] = 1;
+        tracker->misses[i] = 0;
+        tracker->drawn[i] = false;
+    }
+}
+
+/*
+ * Get the confirmed tracks predicted to now_us.
+ *
+ * changed is set when a box appeared, disappeared, or moved more than
+ * MOVE_THRESHOLD since the boxes last marked as drawn. The caller only needs
+ * to commit to bbox then, and calls tracker_mark_drawn once the commit
+ * succeeded, so a failed commit is tried again on the next snapshot. Can be
+ * called at display rate between inference frames.
+ *
+ * return number of boxes written.
+ */
+size_t tracker_snapshot(const tracker_t* tracker,
+                        uint64_t now_us,
+                        bbox_detection_t* boxes,
+                        size_t max_boxes,
+                        bool* changed) {
+    bool moved = tracker->removed_drawn;
+    size_t count = 0;
+
+    for (size_t i = 0; i < tracker->count; i++) {
+        if (tracker->hits[i] < MIN_HITS) {
+            continue;
+        }
+
+        float dt = seconds_since(tracker, i, now_us);
+        float cx = tracker->cx[i] + tracker->vx[i] * dt;
+        float cy = tracker->cy[i] + tracker->vy[i] * dt;
+        if (!tracker->drawn[i] || fabsf(cx - tracker->drawn_cx[i]) > MOVE_THRESHOLD ||
+            fabsf(cy - tracker->drawn_cy[i]) > MOVE_THRESHOLD ||
+            fabsf(tracker->w[i] - tracker->drawn_w[i]) > MOVE_THRESHOLD ||
+            fabsf(tracker->h[i] - tracker->drawn_h[i]) > MOVE_THRESHOLD) {
+            moved = true;
+        }
+
+        if (count < max_boxes) {
+            boxes[count].x_min = cx - tracker->w[i] / 2.0f;
+            boxes[count].y_min = cy - tracker->h[i] / 2.0f;
+            boxes[count].x_max = cx + tracker->w[i] / 2.0f;
+            boxes[count].y_max = cy + tracker->h[i] / 2.0f;
+            count++;
+        }
+    }
+
+    *changed = moved;
+    return count;
+}
+
+/*
+ * Remember the boxes of tracker_snapshot at now_us as drawn. Call only after
+ * they were committed, with the same now_us.
+ */
+void tracker_mark_drawn(tracker_t* tracker, uint64_t now_us) {
+    for (size_t i = 0; i < tracker->count; i++) {
+        if (tracker->hits[i] < MIN_HITS) {
+            continue;
+        }
+
+        float dt = seconds_since(tracker, i, now_us);
+        tracker->drawn_cx[i] = tracker->cx[i] + tracker->vx[i] * dt;
+        tracker->drawn_cy[i] = tracker->cy[i] + tracker->vy[i] * dt;
+        tracker->drawn_w[i] = tracker->w[i];
+        tracker->drawn_h[i] = tracker->h[i];
+        tracker->drawn[i] = true;
+    }
+    tracker->removed_drawn = false;
+}
@@ -0,0 +1,54 @@
+#ifndef TRACKER_H
+#define TRACKER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bbox_publisher.h"
+
+#define TRACKER_MAX_TRACKS 32u
+
+/*
+ * Track state is kept as a struct of arrays so the association and
+ * prediction loops walk contiguous floats. Boxes are stored as center and
+ * size in frame normalized coordinates.
+ */
+typedef struct {
+    size_t count;
+    uint32_t next_id;
+
+    uint32_t id[TRACKER_MAX_TRACKS];
+    float cx[TRACKER_MAX_TRACKS];
+    float cy[TRACKER_MAX_TRACKS];
+    float w[TRACKER_MAX_TRACKS];
+    float h[TRACKER_MAX_TRACKS];
+    float vx[TRACKER_MAX_TRACKS];
+    float vy[TRACKER_MAX_TRACKS];
+    uint64_t updated_us[TRACKER_MAX_TRACKS];
+    uint8_t hits[TRACKER_MAX_TRACKS];
+    uint8_t misses[TRACKER_MAX_TRACKS];
+
+    /* Where each track was last committed to bbox */
+    float drawn_cx[TRACKER_MAX_TRACKS];
+    float drawn_cy[TRACKER_MAX_TRACKS];
+    float drawn_w[TRACKER_MAX_TRACKS];
+    float drawn_h[TRACKER_MAX_TRACKS];
+    bool drawn[TRACKER_MAX_TRACKS];
+    /* Set when a drawn track was dropped, its box must be removed */
+    bool removed_drawn;
+} tracker_t;
+
+void tracker_init(tracker_t* tracker);
+void tracker_update(tracker_t* tracker,
+                    const bbox_detection_t* detections,
+                    size_t num_detections,
+                    uint64_t now_us);
+size_t tracker_snapshot(const tracker_t* tracker,
+                        uint64_t now_us,
+                        bbox_detection_t* boxes,
+                        size_t max_boxes,
+                        bool* changed);
+void tracker_mark_drawn(tracker_t* tracker, uint64_t now_us);
+
+#endif
@@ -36,6 +36,7 @@
 #include <stdlib.h>
 #include <syslog.h>
 
+#include "overlay_backend.h"
 
 static gint overlay_id = -1;
 
@@ -119,7 +120,6 @@ static void adjustment_cb(gint id,
                           gint* overlay_height,
                           gpointer user_data) {
     /* Silence compiler warnings for unused parameters/arguments */
-    (void)id;
     (void)postype;
     (void)overlay_x;
     (void)overlay_y;
@@ -142,6 +142,7 @@ static void adjustment_cb(gint id,
            stream->width,
            stream->height);
     syslog(LOG_INFO, "Stream or rotation changed, rotation angle is now: %i", stream->rotation);
+    overlay_backend_log_footprint(id, *overlay_width, *overlay_height);
 }
 
 
@@ -253,12 +254,19 @@ int main(void) {
 
     syslog(LOG_INFO, "Max resolution (width x height): %i x %i", camera_width, camera_height);
 
-    // Create a large overlay using Palette color space
+    //  Setup the shared palette colors
+    if (!overlay_backend_init(&error)) {
+        syslog(LOG_ERR, "Failed to setup palette colors: %s", error->message);
+        g_error_free(error);
+        return 1;
+    }
+
+    // Create a large overlay, the logo needs the ARGB32 color space
     struct axoverlay_overlay_data data;
     setup_axoverlay_data(&data);
-    data.width      = camera_width;
-    data.height     = camera_height;
-    overlay_id      = axoverlay_create_overlay(&data, NULL, &error);
+    data.width  = camera_width;
+    data.height = camera_height;
+    overlay_id  = overlay_backend_create_overlay(&data, OVERLAY_CONTENT_IMAGE, NULL, &error);
     if (error != NULL) {
         syslog(LOG_ERR, "Failed to create first overlay: %s", error->message);
         g_error_free(error);
@@ -268,7 +276,8 @@ int main(void) {
     axoverlay_redraw(&error);
     if (error != NULL) {
         syslog(LOG_ERR, "Failed to draw overlays: %s", error->message);
-        axoverlay_destroy_overlay(overlay_id, &error);
+        overlay_backend_destroy_overlay(overlay_id, &error);
+        overlay_backend_cleanup();
         axoverlay_cleanup();
         g_error_free(error);
         g_error_free(error_text);
@@ -278,7 +287,7 @@ int main(void) {
     g_main_loop_run(loop);
 
     // Destroy the overlay
-    axoverlay_destroy_overlay(overlay_id, &error);
+    overlay_backend_destroy_overlay(overlay_id, &error);
     if (error != NULL) {
         syslog(LOG_ERR, "Failed to destroy first overlay: %s", error->message);
         g_error_free(error);
@@ -287,6 +296,7 @@ int main(void) {
     
 
     // Release library resources
+    overlay_backend_cleanup();
     axoverlay_cleanup();
 
     // Release main loop
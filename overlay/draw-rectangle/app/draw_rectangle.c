@@ -35,36 +35,18 @@
 #include <stdlib.h>
 #include <syslog.h>
 
-#define PALETTE_VALUE_RANGE 255.0
+#include "overlay_backend.h"
 
-
-static gint overlay_id      = -1;
-//static gint top_color       =  1;
-//static gint bottom_color    =  3;
-static gint center_color    =  4;
+static gint overlay_id = -1;
+static enum overlay_color center_color = OVERLAY_COLOR_YELLOW;
 
 /***** Drawing functions *****************************************************/
 
-/**
- * brief Converts palette color index to cairo color value.
- *
- * This function converts the palette index, which has been initialized by
- * function axoverlay_set_palette_color to a value that can be used by
- * function cairo_set_source_rgba.
- *
- * param color_index Index in the palette setup.
- *
- * return color value.
- */
-static gdouble index2cairo(const gint color_index) {
-    return ((color_index << 4) + color_index) / PALETTE_VALUE_RANGE;
-}
-
 /**
  * brief Draw a rectangle using palette.
  *
  * This function draws a rectangle with lines from coordinates
- * left, top, right and bottom with a palette color index and
+ * left, top, right and bottom with a shared color and
  * line width.
  *
  * param context Cairo rendering context.
@@ -72,7 +54,7 @@ static gdouble index2cairo(const gint color_index) {
  * param top Top coordinate (y1).
  * param right Right coordinate (x2).
  * param bottom Bottom coordinate (y2).
- * param color_index Palette color index.
+ * param color Shared overlay color.
  * param line_width Rectange line width.
  */
 static void draw_rectangle(cairo_t* context,
@@ -80,13 +62,9 @@ static void draw_rectangle(cairo_t* context,
                            gint top,
                            gint right,
                            gint bottom,
-                           gint color_index,
+                           enum overlay_color color,
                            gint line_width) {
-    gdouble val = 0;
-
-    val = index2cairo(color_index);
-    cairo_set_source_rgba(context, val, val, val, val);
-    cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
+    overlay_backend_set_color(context, overlay_id, color);
     cairo_set_line_width(context, line_width);
     cairo_rectangle(context, left, top, right - left, bottom - top);
     cairo_stroke(context);
@@ -108,38 +86,6 @@ static void setup_axoverlay_data(struct axoverlay_overlay_data* data) {
     data->scale_to_stream = FALSE;
 }
 
-/**
- * brief Setup palette color table.
- *
- * This function initialize and setup an palette index
- * representing ARGB values.
- *
- * param color_index Palette color index.
- * param r R (red) value.
- * param g G (green) value.
- * param b B (blue) value.
- * param a A (alpha) value.
- *
- * return result as boolean
- */
-static gboolean setup_palette_color(const int index, const gint r, const gint g, const gint b, const gint a) {
-    GError* error = NULL;
-    struct axoverlay_palette_color color;
-
-    color.red      = r;
-    color.green    = g;
-    color.blue     = b;
-    color.alpha    = a;
-    color.pixelate = FALSE;
-    axoverlay_set_palette_color(index, &color, &error);
-    if (error != NULL) {
-        g_error_free(error);
-        return FALSE;
-    }
-
-    return TRUE;
-}
-
 /***** Callback functions ****************************************************/
 
 /**
@@ -169,7 +115,6 @@ static void adjustment_cb(gint id,
                           gint* overlay_height,
                           gpointer user_data) {
     /* Silence compiler warnings for unused parameters/arguments */
-    (void)id;
     (void)postype;
     (void)overlay_x;
     (void)overlay_y;
@@ -192,6 +137,7 @@ static void adjustment_cb(gint id,
            stream->width,
            stream->height);
     syslog(LOG_INFO, "Stream or rotation changed, rotation angle is now: %i", stream->rotation);
+    overlay_backend_log_footprint(id, *overlay_width, *overlay_height);
 }
 
 
@@ -210,8 +156,6 @@ static void render_overlay_cb(gpointer rendering_context,
     (void)overlay_x;
     (void)overlay_y;
 
-    gdouble val = FALSE;
-
     // setup for yellow rectangle
     gint rect_width = overlay_width / 4;
     gint rect_height = overlay_height / 4;
@@ -232,20 +176,9 @@ static void render_overlay_cb(gpointer rendering_context,
     syslog(LOG_INFO, "Render callback for rotation: %i", stream->rotation);
 
     if (id == overlay_id) {
-        //  Clear background by drawing a "filled" rectangle
-        val = index2cairo(0);
-        cairo_set_source_rgba(rendering_context, val, val, val, val);
-        cairo_set_operator(rendering_context, CAIRO_OPERATOR_SOURCE);
-        
-        // cairo_rectangle(cr, x, y, width, height);
-        // The X coordinate of the top-left corner.
-        // The Y coordinate of the top-left corner.
-        // The width of the rectangle to draw. => defined by AXOVERLAY_CAIRO_IMAGE_BACKEND
-        // The height of the rectangle to draw. => AXOVERLAY_CAIRO_IMAGE_BACKEND
-        cairo_rectangle(rendering_context, 0, 0, overlay_width, overlay_height); 
-        cairo_fill(rendering_context);
-
-        
+        //  Clear background to the transparent palette entry
+        overlay_backend_begin(rendering_context, id, overlay_width, overlay_height);
+
         // Draw a yellow centered rectangle
         draw_rectangle(rendering_context, left, top, right, bottom, center_color, 3.0);
 
@@ -311,11 +244,10 @@ int main(void) {
         return 1;
     }
 
-    //  Setup colors
-    if (!setup_palette_color(0, 0, 0, 0, 0) || !setup_palette_color(1, 255, 0, 0, 255) ||
-        !setup_palette_color(2, 0, 255, 0, 255) || !setup_palette_color(3, 0, 0, 255, 255) || 
-        !setup_palette_color(4, 255, 255, 0, 255)) {
-        syslog(LOG_ERR, "Failed to setup palette colors");
+    //  Setup the shared palette colors
+    if (!overlay_backend_init(&error)) {
+        syslog(LOG_ERR, "Failed to setup palette colors: %s", error->message);
+        g_error_free(error);
         return 1;
     }
 
@@ -336,13 +268,12 @@ int main(void) {
 
     syslog(LOG_INFO, "Max resolution (width x height): %i x %i", camera_width, camera_height);
 
-    // Create a large overlay using Palette color space
+    // Create a large overlay, boxes only need the 4-bit palette color space
     struct axoverlay_overlay_data data;
     setup_axoverlay_data(&data);
-    data.width      = camera_width;
-    data.height     = camera_height;
-    data.colorspace = AXOVERLAY_COLORSPACE_4BIT_PALETTE;
-    overlay_id      = axoverlay_create_overlay(&data, NULL, &error);
+    data.width  = camera_width;
+    data.height = camera_height;
+    overlay_id  = overlay_backend_create_overlay(&data, OVERLAY_CONTENT_SHAPES, NULL, &error);
     if (error != NULL) {
         syslog(LOG_ERR, "Failed to create first overlay: %s", error->message);
         g_error_free(error);
@@ -353,7 +284,8 @@ int main(void) {
     axoverlay_redraw(&error);
     if (error != NULL) {
         syslog(LOG_ERR, "Failed to draw overlays: %s", error->message);
-        axoverlay_destroy_overlay(overlay_id, &error);
+        overlay_backend_destroy_overlay(overlay_id, &error);
+        overlay_backend_cleanup();
         axoverlay_cleanup();
         g_error_free(error);
         return 1;
@@ -363,7 +295,7 @@ int main(void) {
     g_main_loop_run(loop);
 
     // Destroy the overlay
-    axoverlay_destroy_overlay(overlay_id, &error);
+    overlay_backend_destroy_overlay(overlay_id, &error);
     if (error != NULL) {
         syslog(LOG_ERR, "Failed to destroy first overlay: %s", error->message);
         g_error_free(error);
@@ -371,6 +303,7 @@ int main(void) {
     }
 
     // Release library resources
+    overlay_backend_cleanup();
     axoverlay_cleanup();
 
     // Release main loop
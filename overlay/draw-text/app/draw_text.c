@@ -36,16 +36,16 @@
 #include <stdlib.h>
 #include <syslog.h>
 
+#include "overlay_backend.h"
+#include "redraw_coalescer.h"
 
-typedef struct {
-    double r;
-    double g;
-    double b;
-} RGBColor;
+// Redraw requests within one frame at 30 fps are merged into one redraw
+#define REDRAW_INTERVAL_MS (1000 / 30)
 
-static RGBColor color;
+static enum overlay_color color = OVERLAY_COLOR_GREEN;
 
 static gint animation_timer = -1;
+static gint overlay_id_box  = -1;
 static gint overlay_id_text = -1;
 static gint counter         = 10;
 
@@ -56,8 +56,8 @@ static void draw_text(cairo_t* context, const gint pos_x, const gint pos_y) {
     gchar* str        = NULL;
     gchar* str_length = NULL;
 
-    //  Show text in black
-    cairo_set_source_rgb(context, color.r, color.g, color.b);
+    //  Show text in the current countdown color
+    overlay_backend_set_color(context, overlay_id_text, color);
     cairo_select_font_face(context, "serif", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
     cairo_set_font_size(context, 32.0);
 
@@ -74,6 +74,17 @@ static void draw_text(cairo_t* context, const gint pos_x, const gint pos_y) {
     g_free(str);
 }
 
+static void draw_box(cairo_t* context, const gint overlay_width, const gint overlay_height) {
+    overlay_backend_set_color(context, overlay_id_box, OVERLAY_COLOR_WHITE);
+    cairo_set_line_width(context, 3.0);
+    cairo_rectangle(context,
+                    overlay_width / 2 - overlay_width / 8,
+                    overlay_height / 2 - overlay_height / 12,
+                    overlay_width / 4,
+                    overlay_height / 8);
+    cairo_stroke(context);
+}
+
 /**
  * brief Setup an overlay_data struct.
  *
@@ -122,7 +133,6 @@ static void adjustment_cb(gint id,
                           gint* overlay_height,
                           gpointer user_data) {
     /* Silence compiler warnings for unused parameters/arguments */
-    (void)id;
     (void)postype;
     (void)overlay_x;
     (void)overlay_y;
@@ -145,6 +155,7 @@ static void adjustment_cb(gint id,
            stream->width,
            stream->height);
     syslog(LOG_INFO, "Stream or rotation changed, rotation angle is now: %i", stream->rotation);
+    overlay_backend_log_footprint(id, *overlay_width, *overlay_height);
 }
 
 /**
@@ -179,14 +190,22 @@ static void render_overlay_cb(gpointer rendering_context,
     (void)overlay_x;
     (void)overlay_y;
 
+    // Clean overlays keep the pixels from their last render
+    if (!redraw_coalescer_begin_render(id))
+        return;
 
     syslog(LOG_INFO, "Render callback for camera: %i", stream->camera);
     syslog(LOG_INFO, "Render callback for overlay: %i x %i", overlay_width, overlay_height);
     syslog(LOG_INFO, "Render callback for stream: %i x %i", stream->width, stream->height);
     syslog(LOG_INFO, "Render callback for rotation: %i", stream->rotation);
 
-    if (id == overlay_id_text) {
-        //  Show text in black
+    if (id == overlay_id_box) {
+        //  Static frame around the countdown, only drawn when a stream needs it
+        overlay_backend_begin(rendering_context, id, overlay_width, overlay_height);
+        draw_box(rendering_context, overlay_width, overlay_height);
+    } else if (id == overlay_id_text) {
+        //  Clear the previous count and show the text
+        overlay_backend_begin(rendering_context, id, overlay_width, overlay_height);
         draw_text(rendering_context, overlay_width / 2, overlay_height / 2);
     } else {
         syslog(LOG_INFO, "Unknown overlay id!");
@@ -197,7 +216,8 @@ static void render_overlay_cb(gpointer rendering_context,
  * brief Callback function which is called when animation timer has elapsed.
  *
  * This function is called when the animation timer has elapsed, which will
- * update the counter, colors and also trigger a redraw of the overlay.
+ * update the counter, colors and mark the text overlay for redraw. The box
+ * overlay is left clean so its render is skipped.
  *
  * param user_data Optional callback user data.
  */
@@ -205,29 +225,18 @@ static gboolean update_overlay_cb(gpointer user_data) {
     /* Silence compiler warnings for unused parameters/arguments */
     (void)user_data;
 
-    GError* error = NULL;
-
     // Countdown
     counter = counter < 1 ? 10 : counter - 1;
 
     if (counter >= 0 && counter <= 3) 
-        color = (RGBColor){ 1.0, 0.0, 0.0}; // red
+        color = OVERLAY_COLOR_RED;
     else if (counter > 3 && counter <= 7)
-        color = (RGBColor){ 0.0, 0.0, 1.0}; // blue
+        color = OVERLAY_COLOR_BLUE;
     else
-        color = (RGBColor){0.0, 1.0, 0.0}; // Green
+        color = OVERLAY_COLOR_GREEN;
 
-    // Request a redraw of the overlay
-    axoverlay_redraw(&error);
-    if (error != NULL) {
-        /*
-         * If redraw fails then it is likely due to that overlayd has
-         * crashed. Don't exit instead wait for overlayd to restart and
-         * for axoverlay to restore the connection.
-         */
-        syslog(LOG_ERR, "Failed to redraw overlay (%d): %s", error->code, error->message);
-        g_error_free(error);
-    }
+    // Request a redraw of the text overlay only
+    redraw_coalescer_mark_dirty(overlay_id_text);
 
     return G_SOURCE_CONTINUE;
 }
@@ -305,15 +314,31 @@ int main(void) {
 
     syslog(LOG_INFO, "Max resolution (width x height): %i x %i", camera_width, camera_height);
 
+    //  Setup the shared palette colors
+    if (!overlay_backend_init(&error)) {
+        syslog(LOG_ERR, "Failed to setup palette colors: %s", error->message);
+        g_error_free(error);
+        return 1;
+    }
 
-    
-    // Create an text overlay using ARGB32 color space
+    // Create a box overlay, plain lines only need the 4-bit palette color space
+    struct axoverlay_overlay_data data_box;
+    setup_axoverlay_data(&data_box);
+    data_box.width  = camera_width;
+    data_box.height = camera_height;
+    overlay_id_box  = overlay_backend_create_overlay(&data_box, OVERLAY_CONTENT_SHAPES, NULL, &error);
+    if (error != NULL) {
+        syslog(LOG_ERR, "Failed to create first overlay: %s", error->message);
+        g_error_free(error);
+        return 1;
+    }
+
+    // Create a text overlay, anti-aliased text needs the ARGB32 color space
     struct axoverlay_overlay_data data_text;
     setup_axoverlay_data(&data_text);
-    data_text.width      = camera_width;
-    data_text.height     = camera_height;
-    data_text.colorspace = AXOVERLAY_COLORSPACE_ARGB32;
-    overlay_id_text      = axoverlay_create_overlay(&data_text, NULL, &error_text);
+    data_text.width  = camera_width;
+    data_text.height = camera_height;
+    overlay_id_text  = overlay_backend_create_overlay(&data_text, OVERLAY_CONTENT_TEXT, NULL, &error_text);
     if (error_text != NULL) {
         syslog(LOG_ERR, "Failed to create second overlay: %s", error_text->message);
         g_error_free(error_text);
@@ -324,7 +349,9 @@ int main(void) {
     axoverlay_redraw(&error);
     if (error != NULL) {
         syslog(LOG_ERR, "Failed to draw overlays: %s", error->message);
-        axoverlay_destroy_overlay(overlay_id_text, &error_text);
+        overlay_backend_destroy_overlay(overlay_id_box, &error);
+        overlay_backend_destroy_overlay(overlay_id_text, &error_text);
+        overlay_backend_cleanup();
         axoverlay_cleanup();
         g_error_free(error);
         g_error_free(error_text);
@@ -332,12 +359,22 @@ int main(void) {
     }
 
     // Start animation timer
+    redraw_coalescer_init(REDRAW_INTERVAL_MS);
     animation_timer = g_timeout_add_seconds(1, update_overlay_cb, NULL);
 
     // Enter main loop
     g_main_loop_run(loop);
 
-    axoverlay_destroy_overlay(overlay_id_text, &error_text);
+    redraw_coalescer_cleanup();
+
+    overlay_backend_destroy_overlay(overlay_id_box, &error);
+    if (error != NULL) {
+        syslog(LOG_ERR, "Failed to destroy first overlay: %s", error->message);
+        g_error_free(error);
+        return 1;
+    }
+
+    overlay_backend_destroy_overlay(overlay_id_text, &error_text);
     if (error_text != NULL) {
         syslog(LOG_ERR, "Failed to destroy second overlay: %s", error_text->message);
         g_error_free(error_text);
@@ -345,6 +382,7 @@ int main(void) {
     }
 
     // Release library resources
+    overlay_backend_cleanup();
     axoverlay_cleanup();
 
     // Release the animation timer
@@ -0,0 +1,275 @@
+/**
+ * Copyright (C) 2026, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * - overlay backend -
+ *
+ * Small drawing backend shared by the axoverlay examples. It chooses the
+ * colorspace per overlay from what the overlay shows and hides the
+ * difference between palette indices and ARGB colors from the drawing code.
+ *
+ * Colorspace, alignment and cost per pixel:
+ * 1-bit palette (AXOVERLAY_COLORSPACE_1BIT_PALETTE): 32-byte alignment, 1 bit
+ * 4-bit palette (AXOVERLAY_COLORSPACE_4BIT_PALETTE): 16-byte alignment, 4 bits
+ * ARGB32 (AXOVERLAY_COLORSPACE_ARGB32): 16-byte alignment, 32 bits
+ */
+
+#include "overlay_backend.h"
+
+#include <syslog.h>
+
+#define PALETTE_VALUE_RANGE 255.0
+
+struct overlay_entry {
+    enum overlay_content content;
+    enum axoverlay_colorspace colorspace;
+};
+
+struct rgba {
+    gint r;
+    gint g;
+    gint b;
+    gint a;
+};
+
+static const struct rgba color_table[OVERLAY_COLOR_COUNT] = {
+    [OVERLAY_COLOR_TRANSPARENT] = {0, 0, 0, 0},
+    [OVERLAY_COLOR_RED]         = {255, 0, 0, 255},
+    [OVERLAY_COLOR_GREEN]       = {0, 255, 0, 255},
+    [OVERLAY_COLOR_BLUE]        = {0, 0, 255, 255},
+    [OVERLAY_COLOR_YELLOW]      = {255, 255, 0, 255},
+    [OVERLAY_COLOR_WHITE]       = {255, 255, 255, 255},
+    [OVERLAY_COLOR_BLACK]       = {0, 0, 0, 255},
+};
+
+static GHashTable* overlays = NULL;
+
+/**
+ * brief Converts palette color index to cairo color value.
+ *
+ * param color_index Index in the palette setup.
+ *
+ * return color value.
+ */
+static gdouble index2cairo(const gint color_index) {
+    return ((color_index << 4) + color_index) / PALETTE_VALUE_RANGE;
+}
+
+static enum axoverlay_colorspace colorspace_for_content(enum overlay_content content) {
+    switch (content) {
+        case OVERLAY_CONTENT_SHAPES:
+            return AXOVERLAY_COLORSPACE_4BIT_PALETTE;
+        case OVERLAY_CONTENT_TEXT:
+        case OVERLAY_CONTENT_IMAGE:
+        default:
+            return AXOVERLAY_COLORSPACE_ARGB32;
+    }
+}
+
+static const char* colorspace_name(enum axoverlay_colorspace colorspace) {
+    switch (colorspace) {
+        case AXOVERLAY_COLORSPACE_1BIT_PALETTE:
+            return "1-bit palette";
+        case AXOVERLAY_COLORSPACE_4BIT_PALETTE:
+            return "4-bit palette";
+        case AXOVERLAY_COLORSPACE_ARGB32:
+            return "ARGB32";
+        default:
+            return "unknown";
+    }
+}
+
+static const struct overlay_entry* lookup_overlay(gint overlay_id) {
+    if (!overlays)
+        return NULL;
+    return g_hash_table_lookup(overlays, GINT_TO_POINTER(overlay_id));
+}
+
+static gboolean is_palette(gint overlay_id) {
+    const struct overlay_entry* entry = lookup_overlay(overlay_id);
+    return entry && entry->colorspace != AXOVERLAY_COLORSPACE_ARGB32;
+}
+
+/**
+ * brief Setup the shared palette and the overlay registry.
+ *
+ * Must be called after axoverlay_init(). Palette index N holds the
+ * color OVERLAY_COLOR N so both colorspaces agree on every color.
+ *
+ * param error Set if a palette entry could not be written.
+ *
+ * return result as boolean
+ */
+gboolean overlay_backend_init(GError** error) {
+    for (gint index = 0; index < OVERLAY_COLOR_COUNT; index++) {
+        struct axoverlay_palette_color color;
+
+        color.red      = color_table[index].r;
+        color.green    = color_table[index].g;
+        color.blue     = color_table[index].b;
+        color.alpha    = color_table[index].a;
+        color.pixelate = FALSE;
+        axoverlay_set_palette_color(index, &color, error);
+        if (error && *error)
+            return FALSE;
+    }
+
+    overlays = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    return TRUE;
+}
+
+void overlay_backend_cleanup(void) {
+    if (overlays)
+        g_hash_table_unref(overlays);
+    overlays = NULL;
+}
+
+/**
+ * brief Create an overlay in the colorspace that fits its content.
+ *
+ * The caller sets up position and size in data, the backend fills in the
+ * colorspace and logs the memory the overlay needs at that size.
+ *
+ * param data Overlay data prepared by the caller.
+ * param content What the overlay will show.
+ * param user_data Passed on to axoverlay_create_overlay.
+ * param error Set on failure.
+ *
+ * return overlay id, or -1 on failure.
+ */
+gint overlay_backend_create_overlay(struct axoverlay_overlay_data* data,
+                                    enum overlay_content content,
+                                    gpointer user_data,
+                                    GError** error) {
+    data->colorspace = colorspace_for_content(content);
+
+    gint overlay_id = axoverlay_create_overlay(data, user_data, error);
+    if (error && *error)
+        return -1;
+
+    struct overlay_entry* entry = g_new0(struct overlay_entry, 1);
+    entry->content              = content;
+    entry->colorspace           = data->colorspace;
+    g_hash_table_replace(overlays, GINT_TO_POINTER(overlay_id), entry);
+
+    overlay_backend_log_footprint(overlay_id, data->width, data->height);
+    return overlay_id;
+}
+
+void overlay_backend_destroy_overlay(gint overlay_id, GError** error) {
+    axoverlay_destroy_overlay(overlay_id, error);
+    if (overlays)
+        g_hash_table_remove(overlays, GINT_TO_POINTER(overlay_id));
+}
+
+/**
+ * brief Prepare a rendering context for drawing.
+ *
+ * Clears the overlay to transparent. Palette overlays draw without
+ * anti-aliasing, since blended edge pixels would map to unrelated palette
+ * entries.
+ *
+ * param context Cairo rendering context from the render callback.
+ * param overlay_id Overlay being rendered.
+ * param width Overlay width.
+ * param height Overlay height.
+ */
+void overlay_backend_begin(cairo_t* context, gint overlay_id, gint width, gint height) {
+    overlay_backend_set_color(context, overlay_id, OVERLAY_COLOR_TRANSPARENT);
+    cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
+    cairo_rectangle(context, 0, 0, width, height);
+    cairo_fill(context);
+
+    if (is_palette(overlay_id)) {
+        cairo_set_antialias(context, CAIRO_ANTIALIAS_NONE);
+    } else {
+        cairo_set_antialias(context, CAIRO_ANTIALIAS_DEFAULT);
+        cairo_set_operator(context, CAIRO_OPERATOR_OVER);
+    }
+}
+
+/**
+ * brief Set the cairo source to one of the shared colors.
+ *
+ * param context Cairo rendering context.
+ * param overlay_id Overlay being rendered.
+ * param color Color to draw with.
+ */
+void overlay_backend_set_color(cairo_t* context, gint overlay_id, enum overlay_color color) {
+    if (is_palette(overlay_id)) {
+        gdouble val = index2cairo(color);
+        cairo_set_source_rgba(context, val, val, val, val);
+        return;
+    }
+
+    cairo_set_source_rgba(context,
+                          color_table[color].r / PALETTE_VALUE_RANGE,
+                          color_table[color].g / PALETTE_VALUE_RANGE,
+                          color_table[color].b / PALETTE_VALUE_RANGE,
+                          color_table[color].a / PALETTE_VALUE_RANGE);
+}
+
+/**
+ * brief Bytes needed by one overlay buffer.
+ *
+ * param colorspace Overlay colorspace.
+ * param width Overlay width in pixels.
+ * param height Overlay height in pixels.
+ *
+ * return buffer size in bytes, including row alignment.
+ */
+gsize overlay_backend_get_footprint(enum axoverlay_colorspace colorspace, gint width, gint height) {
+    gsize bits      = 32;
+    gsize alignment = 16;
+
+    if (colorspace == AXOVERLAY_COLORSPACE_1BIT_PALETTE) {
+        bits      = 1;
+        alignment = 32;
+    } else if (colorspace == AXOVERLAY_COLORSPACE_4BIT_PALETTE) {
+        bits = 4;
+    }
+
+    gsize stride = ((gsize)width * bits + 7) / 8;
+    stride       = (stride + alignment - 1) / alignment * alignment;
+    return stride * (gsize)height;
+}
+
+/**
+ * brief Log the memory used by an overlay at a given size.
+ *
+ * Called on creation with the max resolution, and from the adjustment
+ * callback with the size used for each stream.
+ *
+ * param overlay_id Overlay to report.
+ * param width Overlay width in pixels.
+ * param height Overlay height in pixels.
+ */
+void overlay_backend_log_footprint(gint overlay_id, gint width, gint height) {
+    const struct overlay_entry* entry = lookup_overlay(overlay_id);
+    if (!entry)
+        return;
+
+    gsize bytes      = overlay_backend_get_footprint(entry->colorspace, width, height);
+    gsize argb_bytes = overlay_backend_get_footprint(AXOVERLAY_COLORSPACE_ARGB32, width, height);
+    syslog(LOG_INFO,
+           "Overlay %d: %s %i x %i uses %zu KiB (ARGB32 would use %zu KiB)",
+           overlay_id,
+           colorspace_name(entry->colorspace),
+           width,
+           height,
+           bytes / 1024,
+           argb_bytes / 1024);
+}
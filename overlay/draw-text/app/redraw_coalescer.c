@@ -0,0 +1,143 @@
+/**
+ * Copyright (C) 2026, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * - redraw coalescer -
+ *
+ * axoverlay_redraw() renders every overlay on every stream. The coalescer
+ * collects the overlays that actually changed, merges all requests made
+ * within one frame interval into a single axoverlay_redraw(), and tells the
+ * render callback which overlays it can skip during that redraw.
+ *
+ * Renders that axoverlay starts on its own, for example when a stream is
+ * started or its resolution changes, are never skipped.
+ */
+
+#include "redraw_coalescer.h"
+
+#include <axoverlay.h>
+#include <syslog.h>
+
+static GHashTable* dirty_overlays = NULL;
+static guint flush_interval_ms    = 0;
+static guint flush_source_id      = 0;
+static gboolean in_flush          = FALSE;
+
+static guint64 redraw_requests = 0;
+static guint64 redraws_issued  = 0;
+static guint64 renders_done    = 0;
+static guint64 renders_avoided = 0;
+
+/**
+ * brief Issue one axoverlay_redraw() for everything marked dirty.
+ *
+ * param user_data Unused.
+ */
+static gboolean flush_cb(gpointer user_data) {
+    /* Silence compiler warnings for unused parameters/arguments */
+    (void)user_data;
+
+    GError* error = NULL;
+
+    flush_source_id = 0;
+    redraws_issued++;
+
+    in_flush = TRUE;
+    axoverlay_redraw(&error);
+    in_flush = FALSE;
+
+    if (error != NULL) {
+        /*
+         * If redraw fails then it is likely due to that overlayd has
+         * crashed. Keep the overlays dirty and wait for axoverlay to
+         * restore the connection before the next flush.
+         */
+        syslog(LOG_ERR, "Failed to redraw overlay (%d): %s", error->code, error->message);
+        g_error_free(error);
+        return G_SOURCE_REMOVE;
+    }
+
+    g_hash_table_remove_all(dirty_overlays);
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * brief Setup the coalescer.
+ *
+ * param interval_ms Window in which redraw requests are merged, normally
+ *                   one frame interval.
+ */
+void redraw_coalescer_init(guint interval_ms) {
+    flush_interval_ms = interval_ms;
+    dirty_overlays    = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
+
+void redraw_coalescer_cleanup(void) {
+    if (flush_source_id)
+        g_source_remove(flush_source_id);
+    flush_source_id = 0;
+
+    if (dirty_overlays)
+        g_hash_table_unref(dirty_overlays);
+    dirty_overlays = NULL;
+
+    redraw_coalescer_log_stats();
+}
+
+/**
+ * brief Request a redraw of one overlay.
+ *
+ * The first request in a window schedules the redraw, later requests in
+ * the same window only add their overlay to the dirty set.
+ *
+ * param overlay_id Overlay whose content changed.
+ */
+void redraw_coalescer_mark_dirty(gint overlay_id) {
+    redraw_requests++;
+    g_hash_table_add(dirty_overlays, GINT_TO_POINTER(overlay_id));
+
+    if (!flush_source_id)
+        flush_source_id = g_timeout_add(flush_interval_ms, flush_cb, NULL);
+}
+
+/**
+ * brief Decide if the render callback needs to draw an overlay.
+ *
+ * Call first thing in render_overlay_cb and return right away on FALSE.
+ *
+ * param overlay_id Overlay being rendered.
+ *
+ * return TRUE if the overlay must be drawn.
+ */
+gboolean redraw_coalescer_begin_render(gint overlay_id) {
+    if (in_flush && !g_hash_table_contains(dirty_overlays, GINT_TO_POINTER(overlay_id))) {
+        renders_avoided++;
+        return FALSE;
+    }
+
+    renders_done++;
+    return TRUE;
+}
+
+void redraw_coalescer_log_stats(void) {
+    syslog(LOG_INFO,
+           "Redraw requests: %" G_GUINT64_FORMAT ", redraws: %" G_GUINT64_FORMAT
+           ", renders: %" G_GUINT64_FORMAT ", renders avoided: %" G_GUINT64_FORMAT,
+           redraw_requests,
+           redraws_issued,
+           renders_done,
+           renders_avoided);
+}
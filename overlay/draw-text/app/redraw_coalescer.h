@@ -0,0 +1,27 @@
+/**
+ * Copyright (C) 2026, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+void redraw_coalescer_init(guint interval_ms);
+void redraw_coalescer_cleanup(void);
+
+void redraw_coalescer_mark_dirty(gint overlay_id);
+gboolean redraw_coalescer_begin_render(gint overlay_id);
+
+void redraw_coalescer_log_stats(void);
@@ -35,20 +35,12 @@
 #include <stdlib.h>
 #include <syslog.h>
 
+#include "overlay_backend.h"
 
-
-#define PALETTE_VALUE_RANGE 255.0
-
-
-static gint overlay_id         = -1;
-static gint circle_color       =  1;
-static gint triangle_color     =  3;
-static gint rectangle_color    =  4;
-
-
-static gdouble index2cairo(const gint color_index) {
-    return ((color_index << 4) + color_index) / PALETTE_VALUE_RANGE;
-}
+static gint overlay_id                    = -1;
+static enum overlay_color circle_color    = OVERLAY_COLOR_RED;
+static enum overlay_color triangle_color  = OVERLAY_COLOR_BLUE;
+static enum overlay_color rectangle_color = OVERLAY_COLOR_YELLOW;
 
 
 static void draw_rectangle(cairo_t* context,
@@ -58,14 +50,10 @@ static void draw_rectangle(cairo_t* context,
                             gfloat height,
                             gint overlay_width,
                             gint overlay_height,
-                            gint color_index,
+                            enum overlay_color color,
                             gint line_width) {
 
-    gdouble val = 0;
-
-    val = index2cairo(color_index);
-    cairo_set_source_rgba(context, val, val, val, val);
-    cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
+    overlay_backend_set_color(context, overlay_id, color);
     cairo_set_line_width(context, line_width);
 
     gdouble pixel_width = width * overlay_width;
@@ -83,13 +71,9 @@ static void draw_circle(cairo_t* context,
                            gfloat radius,
                            gint overlay_width,
                            gint overlay_height,
-                           gint color_index,
+                           enum overlay_color color,
                            gint line_width) {
-    gdouble val = 0;
-
-    val = index2cairo(color_index);
-    cairo_set_source_rgba(context, val, val, val, val);
-    cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
+    overlay_backend_set_color(context, overlay_id, color);
     cairo_set_line_width(context, line_width);
 
     // Convert normalized coords (0.0–1.0) to actual pixels
@@ -108,13 +92,10 @@ static void draw_triangle(cairo_t* context,
                           gfloat x3, gfloat y3,
                           gint overlay_width,
                           gint overlay_height,
-                          gint color_index,
+                          enum overlay_color color,
                           gint line_width) {
 
-    gdouble val = 0;
-
-    val = index2cairo(color_index);                        
-    cairo_set_source_rgba(context, val, val, val, val);   // Set fill color
+    overlay_backend_set_color(context, overlay_id, color);   // Set fill color
     cairo_set_line_width(context, line_width);
 
     cairo_move_to(context, x1 * overlay_width, y1 * overlay_height);   // First point
@@ -135,25 +116,6 @@ static void setup_axoverlay_data(struct axoverlay_overlay_data* data) {
 }
 
 
-static gboolean setup_palette_color(const int index, const gint r, const gint g, const gint b, const gint a) {
-    GError* error = NULL;
-    struct axoverlay_palette_color color;
-
-    color.red      = r;
-    color.green    = g;
-    color.blue     = b;
-    color.alpha    = a;
-    color.pixelate = FALSE;
-    axoverlay_set_palette_color(index, &color, &error);
-    if (error != NULL) {
-        g_error_free(error);
-        return FALSE;
-    }
-
-    return TRUE;
-}
-
-
 static void adjustment_cb(gint id,
                           struct axoverlay_stream_data* stream,
                           enum axoverlay_position_type* postype,
@@ -163,7 +125,6 @@ static void adjustment_cb(gint id,
                           gint* overlay_height,
                           gpointer user_data) {
     /* Silence compiler warnings for unused parameters/arguments */
-    (void)id;
     (void)postype;
     (void)overlay_x;
     (void)overlay_y;
@@ -186,6 +147,7 @@ static void adjustment_cb(gint id,
            stream->width,
            stream->height);
     syslog(LOG_INFO, "Stream or rotation changed, rotation angle is now: %i", stream->rotation);
+    overlay_backend_log_footprint(id, *overlay_width, *overlay_height);
 }
 
 
@@ -204,10 +166,6 @@ static void render_overlay_cb(gpointer rendering_context,
     (void)overlay_x;
     (void)overlay_y;
 
-    gdouble val = FALSE;
-
-    
-    
     size_t channel = stream->camera - 1;
 
     syslog(LOG_INFO, "Rendering overlay on ID=%d, stream ID=%d, and camera=%d", id, stream->id, stream->camera);  
@@ -218,14 +176,10 @@ static void render_overlay_cb(gpointer rendering_context,
     syslog(LOG_INFO, "Render callback for rotation: %i", stream->rotation);
     
 
-    if (channel == 0) {
     // Clear background
-    val = index2cairo(0);
-    cairo_set_source_rgba(rendering_context, val, val, val, val);
-    cairo_set_operator(rendering_context, CAIRO_OPERATOR_SOURCE);
-    cairo_rectangle(rendering_context, 0, 0, overlay_width, overlay_height);
-    cairo_fill(rendering_context);
+    overlay_backend_begin(rendering_context, id, overlay_width, overlay_height);
 
+    if (channel == 0) {
     // Draw normalized rectangle centered at (0.5, 0.5), size 0.5 x 0.25
     draw_rectangle(rendering_context,
                                0.5, 0.5,           // center (normalized)
@@ -317,11 +271,10 @@ int main(void) {
         return 1;
     }
 
-    //  Setup colors
-    if (!setup_palette_color(0, 0, 0, 0, 0) || !setup_palette_color(1, 255, 0, 0, 255) ||
-        !setup_palette_color(2, 0, 255, 0, 255) || !setup_palette_color(3, 0, 0, 255, 255) || 
-        !setup_palette_color(4, 255, 255, 0, 255)) {
-        syslog(LOG_ERR, "Failed to setup palette colors");
+    //  Setup the shared palette colors
+    if (!overlay_backend_init(&error)) {
+        syslog(LOG_ERR, "Failed to setup palette colors: %s", error->message);
+        g_error_free(error);
         return 1;
     }
 
@@ -342,13 +295,12 @@ int main(void) {
 
     syslog(LOG_INFO, "Max resolution (width x height): %i x %i", camera_width, camera_height);
 
-    // Create a large overlay using Palette color space
+    // Create a large overlay, shapes only need the 4-bit palette color space
     struct axoverlay_overlay_data data;
     setup_axoverlay_data(&data);
-    data.width      = camera_width;
-    data.height     = camera_height;
-    data.colorspace = AXOVERLAY_COLORSPACE_4BIT_PALETTE;
-    overlay_id      = axoverlay_create_overlay(&data, NULL, &error);
+    data.width  = camera_width;
+    data.height = camera_height;
+    overlay_id  = overlay_backend_create_overlay(&data, OVERLAY_CONTENT_SHAPES, NULL, &error);
     if (error != NULL) {
         syslog(LOG_ERR, "Failed to create first overlay: %s", error->message);
         g_error_free(error);
@@ -359,7 +311,8 @@ int main(void) {
     axoverlay_redraw(&error);
     if (error != NULL) {
         syslog(LOG_ERR, "Failed to draw overlays: %s", error->message);
-        axoverlay_destroy_overlay(overlay_id, &error);
+        overlay_backend_destroy_overlay(overlay_id, &error);
+        overlay_backend_cleanup();
         axoverlay_cleanup();
         g_error_free(error);
         return 1;
@@ -369,7 +322,7 @@ int main(void) {
     g_main_loop_run(loop);
 
     // Destroy the overlay
-    axoverlay_destroy_overlay(overlay_id, &error);
+    overlay_backend_destroy_overlay(overlay_id, &error);
     if (error != NULL) {
         syslog(LOG_ERR, "Failed to destroy first overlay: %s", error->message);
         g_error_free(error);
@@ -377,6 +330,7 @@ int main(void) {
     }
 
     // Release library resources
+    overlay_backend_cleanup();
     axoverlay_cleanup();
 
     // Release main loop
@@ -0,0 +1,62 @@
+/**
+ * Copyright (C) 2026, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <axoverlay.h>
+#include <cairo/cairo.h>
+#include <glib.h>
+
+/**
+ * What an overlay is used for. The backend picks the cheapest colorspace
+ * for it: solid boxes and lines go into a 4-bit palette overlay, while
+ * anti-aliased text and images need ARGB32.
+ */
+enum overlay_content {
+    OVERLAY_CONTENT_SHAPES,
+    OVERLAY_CONTENT_TEXT,
+    OVERLAY_CONTENT_IMAGE,
+};
+
+/**
+ * Colors shared by all overlays. On palette overlays the value is the
+ * palette index, on ARGB32 overlays the same RGBA value is drawn directly.
+ */
+enum overlay_color {
+    OVERLAY_COLOR_TRANSPARENT = 0,
+    OVERLAY_COLOR_RED,
+    OVERLAY_COLOR_GREEN,
+    OVERLAY_COLOR_BLUE,
+    OVERLAY_COLOR_YELLOW,
+    OVERLAY_COLOR_WHITE,
+    OVERLAY_COLOR_BLACK,
+    OVERLAY_COLOR_COUNT,
+};
+
+gboolean overlay_backend_init(GError** error);
+void overlay_backend_cleanup(void);
+
+gint overlay_backend_create_overlay(struct axoverlay_overlay_data* data,
+                                    enum overlay_content content,
+                                    gpointer user_data,
+                                    GError** error);
+void overlay_backend_destroy_overlay(gint overlay_id, GError** error);
+
+void overlay_backend_begin(cairo_t* context, gint overlay_id, gint width, gint height);
+void overlay_backend_set_color(cairo_t* context, gint overlay_id, enum overlay_color color);
+
+gsize overlay_backend_get_footprint(enum axoverlay_colorspace colorspace, gint width, gint height);
+void overlay_backend_log_footprint(gint overlay_id, gint width, gint height);
@@ -14,6 +14,8 @@
 #include <vdo-error.h>
 #include <vdo-stream.h>
 
+#include "render_policy.h"
+
 struct overlay {
     int overlay_id;
     unsigned stream_id;
@@ -21,22 +23,43 @@ struct overlay {
     unsigned used_height;
     unsigned full_width;
     unsigned full_height;
+    unsigned frame_period_ms;
+    unsigned tick_period_ms;
+    unsigned backoff_ms;
+    unsigned tick_source_id;
     cairo_surface_t* surface;
 };
 
+enum frame_result {
+    FRAME_SUBMITTED,
+    FRAME_RETRY,
+    FRAME_FAILED,
+};
+
 static void overlay_record_deleter(void* overlay_void);
 static gboolean signal_callback(gpointer userdata);
-static gboolean animation_tick_callback(gpointer userdata);
+static gboolean overlay_tick_callback(gpointer userdata);
+static void schedule_overlay(struct overlay* overlay, unsigned delay_ms);
 static gboolean stream_event_callback(GIOChannel* channel, GIOCondition condition, gpointer userdata);
-static void create_overlay(unsigned stream_id, unsigned stream_width, unsigned stream_height);
+static void create_overlay(unsigned stream_id,
+                           unsigned stream_width,
+                           unsigned stream_height,
+                           double stream_framerate);
 static void remove_overlay(unsigned stream_id);
-static void process_next_frame(struct overlay* overlay);
+static enum frame_result process_next_frame(struct overlay* overlay);
 static void render_frame(struct overlay* overlay, char* target_buffer);
 
 static VdoStream* vdo_event_stream = NULL;
 static GHashTable* overlay_table = NULL;
 static GMainLoop* main_loop = NULL;
-static const unsigned tick_period_us = 1000000 / 15;
+// The logo never changes, so each overlay is submitted once. A non-zero
+// value makes every overlay redraw at this period, capped by its stream rate.
+static const unsigned content_period_ms = 0;
+static const enum render_content render_content = RENDER_CONTENT_IMAGE;
+// Logo width relative to the stream height, at least as large for landscape streams
+static const double render_detail_size = 0.12;
+static const unsigned default_frame_period_ms = 1000 / 30;
+static const unsigned max_backoff_ms = 1000;
 
 int main(void) {
     GError* error = NULL;
@@ -58,7 +81,6 @@ int main(void) {
 
     overlay_table = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, overlay_record_deleter);
     main_loop = g_main_loop_new(NULL, FALSE);
-    g_timeout_add(tick_period_us / 1000, animation_tick_callback, NULL);
 
     vdo_event_stream = vdo_stream_get(0, &error);
     if (!vdo_event_stream) {
@@ -125,6 +147,8 @@ static void overlay_record_deleter(void* overlay_void) {
     struct overlay* overlay = overlay_void;
     if (!overlay)
         return;
+    if (overlay->tick_source_id)
+        g_source_remove(overlay->tick_source_id);
     if (overlay->surface)
         cairo_surface_destroy(overlay->surface);
     g_free(overlay);
@@ -137,18 +161,35 @@ static gboolean signal_callback(gpointer userdata) {
     return G_SOURCE_REMOVE;
 }
 
-static gboolean animation_tick_callback(gpointer userdata) {
-    (void)userdata;
-
-    GHashTableIter iter;
-    gpointer key = NULL;
-    gpointer value = NULL;
+static gboolean overlay_tick_callback(gpointer userdata) {
+    struct overlay* overlay = userdata;
+    overlay->tick_source_id = 0;
+
+    switch (process_next_frame(overlay)) {
+        case FRAME_SUBMITTED:
+            overlay->backoff_ms = 0;
+            if (content_period_ms)
+                schedule_overlay(overlay, overlay->tick_period_ms);
+            break;
+        case FRAME_RETRY:
+        case FRAME_FAILED:
+            // No buffer is free yet, or getting or submitting one failed. Back
+            // off instead of asking again every tick, but keep trying: static
+            // content is never scheduled again otherwise.
+            overlay->backoff_ms = overlay->backoff_ms
+                                      ? MIN(overlay->backoff_ms * 2, max_backoff_ms)
+                                      : overlay->frame_period_ms;
+            schedule_overlay(overlay, overlay->backoff_ms);
+            break;
+    }
 
-    g_hash_table_iter_init(&iter, overlay_table);
-    while (g_hash_table_iter_next(&iter, &key, &value))
-        process_next_frame(value);
+    return G_SOURCE_REMOVE;
+}
 
-    return G_SOURCE_CONTINUE;
+static void schedule_overlay(struct overlay* overlay, unsigned delay_ms) {
+    if (overlay->tick_source_id)
+        g_source_remove(overlay->tick_source_id);
+    overlay->tick_source_id = g_timeout_add(delay_ms, overlay_tick_callback, overlay);
 }
 
 static gboolean stream_event_callback(GIOChannel* channel,
@@ -208,7 +249,8 @@ static gboolean stream_event_callback(GIOChannel* channel,
             goto out;
         }
 
-        create_overlay(stream_id, width, height);
+        double framerate = vdo_map_get_double(stream_info, "framerate", 0.0);
+        create_overlay(stream_id, width, height, framerate);
     } else if (event_type == VDO_STREAM_EVENT_CLOSED) {
         remove_overlay(stream_id);
     }
@@ -224,14 +266,18 @@ out:
     return ret;
 }
 
-static void create_overlay(unsigned stream_id, unsigned stream_width, unsigned stream_height) {
+static void create_overlay(unsigned stream_id,
+                           unsigned stream_width,
+                           unsigned stream_height,
+                           double stream_framerate) {
     axo_err* axo_error = NULL;
     axo_props* props = NULL;
     axo_match* match = NULL;
 
-    bool use_upscale = stream_width * stream_height > 4000000;
-    unsigned used_width = use_upscale ? stream_width / 2 : stream_width;
-    unsigned used_height = use_upscale ? stream_height / 2 : stream_height;
+    struct render_plan plan =
+        render_policy_choose(render_content, render_detail_size, stream_width, stream_height);
+    unsigned used_width = plan.used_width;
+    unsigned used_height = plan.used_height;
     unsigned full_width = 0;
     unsigned full_height = 0;
 
@@ -248,7 +294,7 @@ static void create_overlay(unsigned stream_id, unsigned stream_width, unsigned s
     props = axo_props_new();
     axo_props_set_format(props, AXO_FORMAT_ARGB32);
     axo_props_set_size(props, full_width, full_height);
-    axo_props_set_upscale_x2(props, use_upscale);
+    axo_props_set_upscale_x2(props, plan.upscale_x2);
 
     match = axo_match_new();
     axo_match_stream_id(match, stream_id);
@@ -266,6 +312,10 @@ static void create_overlay(unsigned stream_id, unsigned stream_width, unsigned s
                                                          (int)full_height);
     assert(full_width * sizeof(uint32_t) == (unsigned)cairo_image_surface_get_stride(surface));
 
+    unsigned frame_period_ms = default_frame_period_ms;
+    if (stream_framerate > 0.0)
+        frame_period_ms = MAX(1u, (unsigned)(1000.0 / stream_framerate));
+
     struct overlay* overlay = g_malloc(sizeof(*overlay));
     *overlay = (struct overlay){
         .overlay_id = overlay_id,
@@ -274,12 +324,14 @@ static void create_overlay(unsigned stream_id, unsigned stream_width, unsigned s
         .used_height = used_height,
         .full_width = full_width,
         .full_height = full_height,
+        .frame_period_ms = frame_period_ms,
+        .tick_period_ms = MAX(content_period_ms, frame_period_ms),
         .surface = surface,
     };
 
     g_hash_table_insert(overlay_table, GUINT_TO_POINTER(stream_id), overlay);
     syslog(LOG_INFO, "Created overlay %d on stream %u", overlay_id, stream_id);
-    process_next_frame(overlay);
+    schedule_overlay(overlay, 0);
 
 out:
     axo_err_clear(&axo_error);
@@ -306,12 +358,15 @@ out:
     axo_err_clear(&axo_error);
 }
 
-static void process_next_frame(struct overlay* overlay) {
+static enum frame_result process_next_frame(struct overlay* overlay) {
     axo_err* axo_error = NULL;
+    enum frame_result result = FRAME_FAILED;
     axo_buffer* buffer = axo_get_buffer(overlay->overlay_id, NULL, &axo_error);
     if (!buffer) {
         axo_err_code code = axo_err_get_code(axo_error);
-        if (code != AXO_ERR_NO_STREAM && code != AXO_ERR_WAIT)
+        if (code == AXO_ERR_NO_STREAM || code == AXO_ERR_WAIT)
+            result = FRAME_RETRY;
+        else
             syslog(LOG_ERR, "Failed to get buffer for overlay %d: %s",
                    overlay->overlay_id, axo_err_get_message(axo_error));
         goto out;
@@ -330,9 +385,11 @@ static void process_next_frame(struct overlay* overlay) {
                overlay->overlay_id, axo_err_get_message(axo_error));
         goto out;
     }
+    result = FRAME_SUBMITTED;
 
 out:
     axo_err_clear(&axo_error);
+    return result;
 }
 
 static void render_frame(struct overlay* overlay, char* target_buffer) {
@@ -0,0 +1,223 @@
+// Copyright (C) 2026 Axis Communications AB, Lund, Sweden
+// Licensed under the MIT License. See LICENSE file for details.
+
+#define _GNU_SOURCE
+
+#include "draw_command_ring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <syslog.h>
+#include <unistd.h>
+
+static socklen_t socket_address(struct sockaddr_un* addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    // Leading NUL selects the abstract namespace, nothing to clean up on disk
+    memcpy(addr->sun_path + 1, DRAW_RING_SOCKET_NAME, strlen(DRAW_RING_SOCKET_NAME));
+    return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + strlen(DRAW_RING_SOCKET_NAME));
+}
+
+static struct draw_ring* map_ring(int memfd) {
+    void* mem = mmap(NULL, sizeof(struct draw_ring), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (mem == MAP_FAILED) {
+        syslog(LOG_ERR, "Failed to map draw command ring: %s", strerror(errno));
+        return NULL;
+    }
+    return mem;
+}
+
+struct draw_ring* draw_ring_create(int* memfd) {
+    int fd = memfd_create("draw-commands", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        syslog(LOG_ERR, "memfd_create failed: %s", strerror(errno));
+        return NULL;
+    }
+
+    if (ftruncate(fd, sizeof(struct draw_ring)) < 0) {
+        syslog(LOG_ERR, "Failed to size draw command ring: %s", strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    // Publishers must not be able to shrink the ring under the renderer
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) < 0)
+        syslog(LOG_WARNING, "Failed to seal draw command ring: %s", strerror(errno));
+
+    struct draw_ring* ring = map_ring(fd);
+    if (!ring) {
+        close(fd);
+        return NULL;
+    }
+
+    ring->magic = DRAW_RING_MAGIC;
+    ring->version = DRAW_RING_VERSION;
+    ring->capacity = DRAW_RING_CAPACITY;
+    ring->command_size = sizeof(struct draw_command);
+    draw_ring_reset(ring);
+
+    *memfd = fd;
+    return ring;
+}
+
+void draw_ring_reset(struct draw_ring* ring) {
+    atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->dropped_frames, 0, memory_order_relaxed);
+}
+
+int draw_ring_listen(void) {
+    struct sockaddr_un addr;
+    socklen_t addr_len = socket_address(&addr);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        syslog(LOG_ERR, "Failed to create draw command socket: %s", strerror(errno));
+        return -1;
+    }
+
+    if (bind(fd, (struct sockaddr*)&addr, addr_len) < 0 || listen(fd, 1) < 0) {
+        syslog(LOG_ERR, "Failed to listen on @%s: %s", DRAW_RING_SOCKET_NAME, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool draw_ring_send_fd(int socket_fd, int memfd) {
+    char byte = 0;
+    struct iovec iov = {.iov_base = &byte, .iov_len = 1};
+    union {
+        struct cmsghdr header;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+
+    memset(&control, 0, sizeof(control));
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &memfd, sizeof(int));
+
+    if (sendmsg(socket_fd, &msg, MSG_NOSIGNAL) < 0) {
+        syslog(LOG_ERR, "Failed to send draw command ring: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static int receive_fd(int socket_fd) {
+    char byte = 0;
+    struct iovec iov = {.iov_base = &byte, .iov_len = 1};
+    union {
+        struct cmsghdr header;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+
+    // An empty message means the renderer already has a publisher
+    if (recvmsg(socket_fd, &msg, MSG_CMSG_CLOEXEC) <= 0)
+        return -1;
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        return -1;
+
+    int fd = -1;
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+}
+
+struct draw_ring* draw_ring_connect(int* socket_fd) {
+    struct sockaddr_un addr;
+    socklen_t addr_len = socket_address(&addr);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return NULL;
+
+    if (connect(fd, (struct sockaddr*)&addr, addr_len) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    int memfd = receive_fd(fd);
+    if (memfd < 0) {
+        syslog(LOG_WARNING, "Draw command renderer did not hand out its ring");
+        close(fd);
+        return NULL;
+    }
+
+    struct draw_ring* ring = map_ring(memfd);
+    // The mapping keeps the memory alive
+    close(memfd);
+    if (!ring) {
+        close(fd);
+        return NULL;
+    }
+
+    if (ring->magic != DRAW_RING_MAGIC || ring->version != DRAW_RING_VERSION ||
+        ring->capacity != DRAW_RING_CAPACITY || ring->command_size != sizeof(struct draw_command)) {
+        syslog(LOG_ERR, "Draw command ring layout does not match this publisher");
+        draw_ring_unmap(ring);
+        close(fd);
+        return NULL;
+    }
+
+    // The renderer resets the ring when this socket closes
+    *socket_fd = fd;
+    return ring;
+}
+
+void draw_ring_unmap(struct draw_ring* ring) {
+    if (ring)
+        munmap(ring, sizeof(*ring));
+}
+
+bool draw_ring_publish(struct draw_ring* ring, const struct draw_command* commands, size_t count) {
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    // A frame is published whole or not at all, so the renderer never
+    // shows half a frame
+    if (count > DRAW_RING_CAPACITY - (head - tail)) {
+        atomic_fetch_add_explicit(&ring->dropped_frames, 1, memory_order_relaxed);
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++)
+        ring->commands[(head + i) & (DRAW_RING_CAPACITY - 1)] = commands[i];
+
+    atomic_store_explicit(&ring->head, head + (unsigned)count, memory_order_release);
+    return true;
+}
+
+size_t draw_ring_consume(struct draw_ring* ring, struct draw_command* commands, size_t max_commands) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t count = head - tail;
+
+    if (count > max_commands)
+        count = max_commands;
+
+    for (size_t i = 0; i < count; i++)
+        commands[i] = ring->commands[(tail + i) & (DRAW_RING_CAPACITY - 1)];
+
+    atomic_store_explicit(&ring->tail, tail + (unsigned)count, memory_order_release);
+    return count;
+}
@@ -0,0 +1,594 @@
+// Copyright (C) 2026 Axis Communications AB, Lund, Sweden
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include <assert.h>
+#include <axoverlay2.h>
+#include <cairo/cairo.h>
+#include <gio/gio.h>
+#include <glib-unix.h>
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <vdo-error.h>
+#include <vdo-stream.h>
+
+#include "draw_command_ring.h"
+#include "render_policy.h"
+
+struct overlay {
+    int overlay_id;
+    unsigned stream_id;
+    unsigned view_id;
+    unsigned used_width;
+    unsigned used_height;
+    unsigned full_width;
+    unsigned full_height;
+    unsigned frame_period_ms;
+    unsigned tick_period_ms;
+    unsigned backoff_ms;
+    unsigned tick_source_id;
+    cairo_surface_t* surface;
+};
+
+enum frame_result {
+    FRAME_SUBMITTED,
+    FRAME_RETRY,
+    FRAME_FAILED,
+};
+
+static void overlay_record_deleter(void* overlay_void);
+static gboolean signal_callback(gpointer userdata);
+static gboolean overlay_tick_callback(gpointer userdata);
+static void schedule_overlay(struct overlay* overlay, unsigned delay_ms);
+static gboolean stream_event_callback(GIOChannel* channel, GIOCondition condition, gpointer userdata);
+static void create_overlay(unsigned stream_id,
+                           unsigned stream_width,
+                           unsigned stream_height,
+                           double stream_framerate,
+                           unsigned view_id);
+static void remove_overlay(unsigned stream_id);
+static enum frame_result process_next_frame(struct overlay* overlay);
+static void render_frame(struct overlay* overlay, char* target_buffer);
+static gboolean publisher_accept_callback(gint fd, GIOCondition condition, gpointer userdata);
+static gboolean publisher_hangup_callback(gint fd, GIOCondition condition, gpointer userdata);
+static gboolean ring_poll_callback(gpointer userdata);
+static void disconnect_publisher(void);
+static void redraw_all_overlays(void);
+
+static VdoStream* vdo_event_stream = NULL;
+static GHashTable* overlay_table = NULL;
+static GMainLoop* main_loop = NULL;
+// Overlays are only redrawn when a publisher commits a new frame. A non-zero
+// value makes every overlay redraw at this period, capped by its stream rate.
+static const unsigned content_period_ms = 0;
+static const enum render_content render_content = RENDER_CONTENT_BOXES;
+// Line width relative to the stream height
+static const double render_detail_size = 0.004;
+static const unsigned default_frame_period_ms = 1000 / 30;
+static const unsigned max_backoff_ms = 1000;
+
+static struct draw_ring* ring = NULL;
+static int ring_memfd = -1;
+static int listen_fd = -1;
+static int publisher_fd = -1;
+static unsigned listen_watch_id = 0;
+static unsigned publisher_watch_id = 0;
+static unsigned ring_poll_id = 0;
+// Commands since the last DRAW_CMD_CLEAR, and the last committed frame
+static struct draw_command pending_frame[DRAW_RING_CAPACITY];
+static size_t pending_count = 0;
+static struct draw_command shown_frame[DRAW_RING_CAPACITY];
+static size_t shown_count = 0;
+
+int main(void) {
+    GError* error = NULL;
+    axo_err* axo_error = NULL;
+    VdoMap* stream_filter = NULL;
+    GIOChannel* vdo_channel = NULL;
+    unsigned vdo_watch_id = 0;
+    bool axo_running = false;
+    int ret = 0;
+
+    openlog("overlay2_draw_commands", LOG_PID, LOG_USER);
+    setenv("XDG_CACHE_HOME", "/usr/local/packages/overlay2_draw_commands/localdata", 1);
+
+    if (!axo_start(NULL, &axo_error)) {
+        syslog(LOG_ERR, "Failed to start axoverlay2: %s", axo_err_get_message(axo_error));
+        ret = 1;
+        goto out;
+    }
+    axo_running = true;
+
+    overlay_table = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, overlay_record_deleter);
+    main_loop = g_main_loop_new(NULL, FALSE);
+
+    vdo_event_stream = vdo_stream_get(0, &error);
+    if (!vdo_event_stream) {
+        syslog(LOG_ERR, "Failed to open VDO stream 0: %s", error->message);
+        ret = 1;
+        goto out;
+    }
+
+    stream_filter = vdo_map_new();
+    vdo_map_set_string(stream_filter, "filter", "overlay");
+
+    if (!vdo_stream_attach(vdo_event_stream, stream_filter, &error)) {
+        syslog(LOG_ERR, "Failed to attach VDO overlay filter: %s", error->message);
+        ret = 1;
+        goto out;
+    }
+
+    int stream_event_fd = vdo_stream_get_event_fd(vdo_event_stream, &error);
+    if (stream_event_fd < 0) {
+        syslog(LOG_ERR, "Failed to get VDO event fd: %s", error->message);
+        ret = 1;
+        goto out;
+    }
+
+    vdo_channel = g_io_channel_unix_new(stream_event_fd);
+    vdo_watch_id = g_io_add_watch(vdo_channel,
+                                  G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP,
+                                  stream_event_callback,
+                                  NULL);
+    if (!vdo_watch_id) {
+        syslog(LOG_ERR, "Failed to add VDO event fd to GLib loop");
+        ret = 1;
+        goto out;
+    }
+
+    ring = draw_ring_create(&ring_memfd);
+    if (!ring) {
+        ret = 1;
+        goto out;
+    }
+
+    listen_fd = draw_ring_listen();
+    if (listen_fd < 0) {
+        ret = 1;
+        goto out;
+    }
+    listen_watch_id = g_unix_fd_add(listen_fd, G_IO_IN, publisher_accept_callback, NULL);
+    syslog(LOG_INFO, "Waiting for draw command publishers on @%s", DRAW_RING_SOCKET_NAME);
+
+    g_unix_signal_add(SIGINT, signal_callback, NULL);
+    g_unix_signal_add(SIGTERM, signal_callback, NULL);
+
+    g_main_loop_run(main_loop);
+
+out:
+    disconnect_publisher();
+    if (listen_watch_id)
+        g_source_remove(listen_watch_id);
+    if (listen_fd >= 0)
+        close(listen_fd);
+    draw_ring_unmap(ring);
+    if (ring_memfd >= 0)
+        close(ring_memfd);
+    if (vdo_watch_id)
+        g_source_remove(vdo_watch_id);
+    if (vdo_channel)
+        g_io_channel_unref(vdo_channel);
+    if (axo_running)
+        axo_stop(NULL);
+    if (vdo_event_stream)
+        g_object_unref(vdo_event_stream);
+    if (stream_filter)
+        g_object_unref(stream_filter);
+    g_clear_error(&error);
+    axo_err_clear(&axo_error);
+    if (main_loop)
+        g_main_loop_unref(main_loop);
+    if (overlay_table)
+        g_hash_table_unref(overlay_table);
+
+    closelog();
+    return ret;
+}
+
+static void overlay_record_deleter(void* overlay_void) {
+    struct overlay* overlay = overlay_void;
+    if (!overlay)
+        return;
+    if (overlay->tick_source_id)
+        g_source_remove(overlay->tick_source_id);
+    if (overlay->surface)
+        cairo_surface_destroy(overlay->surface);
+    g_free(overlay);
+}
+
+static gboolean signal_callback(gpointer userdata) {
+    (void)userdata;
+    if (main_loop)
+        g_main_loop_quit(main_loop);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean overlay_tick_callback(gpointer userdata) {
+    struct overlay* overlay = userdata;
+    overlay->tick_source_id = 0;
+
+    switch (process_next_frame(overlay)) {
+        case FRAME_SUBMITTED:
+            overlay->backoff_ms = 0;
+            if (content_period_ms)
+                schedule_overlay(overlay, overlay->tick_period_ms);
+            break;
+        case FRAME_RETRY:
+        case FRAME_FAILED:
+            // No buffer is free yet, or getting or submitting one failed. Back
+            // off instead of asking again every tick, but keep trying: static
+            // content is never scheduled again otherwise.
+            overlay->backoff_ms = overlay->backoff_ms
+                                      ? MIN(overlay->backoff_ms * 2, max_backoff_ms)
+                                      : overlay->frame_period_ms;
+            schedule_overlay(overlay, overlay->backoff_ms);
+            break;
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void schedule_overlay(struct overlay* overlay, unsigned delay_ms) {
+    if (overlay->tick_source_id)
+        g_source_remove(overlay->tick_source_id);
+    overlay->tick_source_id = g_timeout_add(delay_ms, overlay_tick_callback, overlay);
+}
+
+static gboolean stream_event_callback(GIOChannel* channel,
+                                      GIOCondition condition,
+                                      gpointer userdata) {
+    (void)channel;
+    (void)userdata;
+
+    GError* error = NULL;
+    VdoMap* vdo_event = NULL;
+    VdoStream* vdo_stream = NULL;
+    VdoMap* stream_info = NULL;
+    gboolean ret = G_SOURCE_CONTINUE;
+
+    if (condition & (G_IO_ERR | G_IO_HUP)) {
+        syslog(LOG_ERR, "Connection to VDO was broken, condition=0x%04x", condition);
+        g_main_loop_quit(main_loop);
+        return G_SOURCE_REMOVE;
+    }
+
+    vdo_event = vdo_stream_get_event(vdo_event_stream, &error);
+    if (!vdo_event) {
+        if (g_error_matches(error, VDO_ERROR, VDO_ERROR_NO_EVENT))
+            goto out;
+        syslog(LOG_ERR, "Failed to get VDO stream event: %s", error->message);
+        g_main_loop_quit(main_loop);
+        ret = G_SOURCE_REMOVE;
+        goto out;
+    }
+
+    unsigned event_type = vdo_map_get_uint32(vdo_event, "event", 0);
+    unsigned stream_id = vdo_map_get_uint32(vdo_event, "id", 0);
+
+    if (event_type == VDO_STREAM_EVENT_EXISTING || event_type == VDO_STREAM_EVENT_CREATED) {
+        vdo_stream = vdo_stream_get(stream_id, &error);
+        if (!vdo_stream) {
+            syslog(LOG_ERR, "Failed to get VDO stream %u: %s", stream_id, error->message);
+            g_main_loop_quit(main_loop);
+            ret = G_SOURCE_REMOVE;
+            goto out;
+        }
+
+        stream_info = vdo_stream_get_info(vdo_stream, NULL);
+        if (!stream_info) {
+            syslog(LOG_ERR, "VDO stream %u is missing stream info", stream_id);
+            g_main_loop_quit(main_loop);
+            ret = G_SOURCE_REMOVE;
+            goto out;
+        }
+
+        unsigned width = vdo_map_get_uint32(stream_info, "width", 0);
+        unsigned height = vdo_map_get_uint32(stream_info, "height", 0);
+        if (!width || !height) {
+            syslog(LOG_ERR, "VDO stream %u has invalid size %ux%u", stream_id, width, height);
+            g_main_loop_quit(main_loop);
+            ret = G_SOURCE_REMOVE;
+            goto out;
+        }
+
+        double framerate = vdo_map_get_double(stream_info, "framerate", 0.0);
+        unsigned view_id = vdo_map_get_uint32(stream_info, "camera", stream_id);
+        create_overlay(stream_id, width, height, framerate, view_id);
+    } else if (event_type == VDO_STREAM_EVENT_CLOSED) {
+        remove_overlay(stream_id);
+    }
+
+out:
+    g_clear_error(&error);
+    if (vdo_event)
+        g_object_unref(vdo_event);
+    if (vdo_stream)
+        g_object_unref(vdo_stream);
+    if (stream_info)
+        g_object_unref(stream_info);
+    return ret;
+}
+
+static void create_overlay(unsigned stream_id,
+                           unsigned stream_width,
+                           unsigned stream_height,
+                           double stream_framerate,
+                           unsigned view_id) {
+    axo_err* axo_error = NULL;
+    axo_props* props = NULL;
+    axo_match* match = NULL;
+
+    struct render_plan plan =
+        render_policy_choose(render_content, render_detail_size, stream_width, stream_height);
+    unsigned used_width = plan.used_width;
+    unsigned used_height = plan.used_height;
+    unsigned full_width = 0;
+    unsigned full_height = 0;
+
+    if (!axo_get_aligned_size(AXO_FORMAT_ARGB32,
+                              used_width,
+                              used_height,
+                              &full_width,
+                              &full_height,
+                              &axo_error)) {
+        syslog(LOG_ERR, "Failed to align overlay size: %s", axo_err_get_message(axo_error));
+        goto out;
+    }
+
+    props = axo_props_new();
+    axo_props_set_format(props, AXO_FORMAT_ARGB32);
+    axo_props_set_size(props, full_width, full_height);
+    axo_props_set_upscale_x2(props, plan.upscale_x2);
+
+    match = axo_match_new();
+    axo_match_stream_id(match, stream_id);
+
+    int overlay_id = axo_create_overlay(props, match, &axo_error);
+    if (overlay_id < 0) {
+        if (axo_err_get_code(axo_error) != AXO_ERR_NO_STREAM)
+            syslog(LOG_ERR, "Failed to create overlay on stream %u: %s",
+                   stream_id, axo_err_get_message(axo_error));
+        goto out;
+    }
+
+    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                                         (int)full_width,
+                                                         (int)full_height);
+    assert(full_width * sizeof(uint32_t) == (unsigned)cairo_image_surface_get_stride(surface));
+
+    unsigned frame_period_ms = default_frame_period_ms;
+    if (stream_framerate > 0.0)
+        frame_period_ms = MAX(1u, (unsigned)(1000.0 / stream_framerate));
+
+    struct overlay* overlay = g_malloc(sizeof(*overlay));
+    *overlay = (struct overlay){
+        .overlay_id = overlay_id,
+        .stream_id = stream_id,
+        .view_id = view_id,
+        .used_width = used_width,
+        .used_height = used_height,
+        .full_width = full_width,
+        .full_height = full_height,
+        .frame_period_ms = frame_period_ms,
+        .tick_period_ms = MAX(content_period_ms, frame_period_ms),
+        .surface = surface,
+    };
+
+    g_hash_table_insert(overlay_table, GUINT_TO_POINTER(stream_id), overlay);
+    syslog(LOG_INFO, "Created overlay %d on stream %u", overlay_id, stream_id);
+    schedule_overlay(overlay, 0);
+
+out:
+    axo_err_clear(&axo_error);
+    if (props)
+        axo_props_free(props);
+    if (match)
+        axo_match_free(match);
+}
+
+static void remove_overlay(unsigned stream_id) {
+    axo_err* axo_error = NULL;
+    const struct overlay* overlay = g_hash_table_lookup(overlay_table, GUINT_TO_POINTER(stream_id));
+
+    if (!overlay)
+        goto out;
+
+    if (!axo_remove_overlay(overlay->overlay_id, &axo_error)) {
+        syslog(LOG_ERR, "Failed to remove overlay %d on stream %u: %s",
+               overlay->overlay_id, stream_id, axo_err_get_message(axo_error));
+    }
+
+out:
+    g_hash_table_remove(overlay_table, GUINT_TO_POINTER(stream_id));
+    axo_err_clear(&axo_error);
+}
+
+static enum frame_result process_next_frame(struct overlay* overlay) {
+    axo_err* axo_error = NULL;
+    enum frame_result result = FRAME_FAILED;
+    axo_buffer* buffer = axo_get_buffer(overlay->overlay_id, NULL, &axo_error);
+    if (!buffer) {
+        axo_err_code code = axo_err_get_code(axo_error);
+        if (code == AXO_ERR_NO_STREAM || code == AXO_ERR_WAIT)
+            result = FRAME_RETRY;
+        else
+            syslog(LOG_ERR, "Failed to get buffer for overlay %d: %s",
+                   overlay->overlay_id, axo_err_get_message(axo_error));
+        goto out;
+    }
+
+    char* target_buffer = axo_buffer_get_data(buffer, &axo_error);
+    if (!target_buffer) {
+        syslog(LOG_ERR, "Failed to get overlay buffer data: %s", axo_err_get_message(axo_error));
+        goto out;
+    }
+
+    render_frame(overlay, target_buffer);
+
+    if (!axo_submit_buffer(buffer, NULL, &axo_error)) {
+        syslog(LOG_ERR, "Failed to submit overlay buffer %d: %s",
+               overlay->overlay_id, axo_err_get_message(axo_error));
+        goto out;
+    }
+    result = FRAME_SUBMITTED;
+
+out:
+    axo_err_clear(&axo_error);
+    return result;
+}
+
+static void render_frame(struct overlay* overlay, char* target_buffer) {
+    cairo_t* cr = cairo_create(overlay->surface);
+
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_rgba(cr, 0.0, 0.0, 0.0, 0.0);
+    cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+
+    double scale_x = (double)overlay->used_width / DRAW_COORD_MAX;
+    double scale_y = (double)overlay->used_height / DRAW_COORD_MAX;
+    cairo_set_line_width(cr, MAX(1.0, render_detail_size * overlay->used_height));
+    cairo_select_font_face(cr, "sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+    cairo_set_font_size(cr, (double)overlay->used_height * 0.03);
+
+    for (size_t i = 0; i < shown_count; i++) {
+        const struct draw_command* command = &shown_frame[i];
+
+        // Channel 0 draws on every view
+        if (command->channel && command->channel != overlay->view_id)
+            continue;
+
+        cairo_set_source_rgba(cr,
+                              ((command->color_argb >> 16) & 0xff) / 255.0,
+                              ((command->color_argb >> 8) & 0xff) / 255.0,
+                              (command->color_argb & 0xff) / 255.0,
+                              ((command->color_argb >> 24) & 0xff) / 255.0);
+
+        double x = command->x * scale_x;
+        double y = command->y * scale_y;
+        if (command->type == DRAW_CMD_RECT) {
+            cairo_rectangle(cr, x, y, command->width * scale_x, command->height * scale_y);
+            cairo_stroke(cr);
+        }
+        // The publisher owns the memory, never trust it to terminate the label
+        char text[DRAW_TEXT_MAX];
+        memcpy(text, command->text, sizeof(text));
+        text[sizeof(text) - 1] = '\0';
+        if (text[0]) {
+            cairo_move_to(cr, x, y);
+            cairo_show_text(cr, text);
+        }
+    }
+
+    cairo_destroy(cr);
+    cairo_surface_flush(overlay->surface);
+
+    unsigned byte_size = overlay->full_width * overlay->full_height * sizeof(uint32_t);
+    memcpy(target_buffer, cairo_image_surface_get_data(overlay->surface), byte_size);
+}
+
+static gboolean publisher_accept_callback(gint fd, GIOCondition condition, gpointer userdata) {
+    (void)condition;
+    (void)userdata;
+
+    int client_fd = accept(fd, NULL, NULL);
+    if (client_fd < 0)
+        return G_SOURCE_CONTINUE;
+
+    // The ring has a single producer. Later publishers get the socket closed
+    // without a memfd and fall back to their own drawing.
+    if (publisher_fd >= 0 || !draw_ring_send_fd(client_fd, ring_memfd)) {
+        syslog(LOG_WARNING, "Rejected draw command publisher, one is already connected");
+        close(client_fd);
+        return G_SOURCE_CONTINUE;
+    }
+
+    publisher_fd = client_fd;
+    publisher_watch_id =
+        g_unix_fd_add(publisher_fd, G_IO_IN | G_IO_HUP | G_IO_ERR, publisher_hangup_callback, NULL);
+    ring_poll_id = g_timeout_add(default_frame_period_ms, ring_poll_callback, NULL);
+    syslog(LOG_INFO, "Draw command publisher connected");
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean publisher_hangup_callback(gint fd, GIOCondition condition, gpointer userdata) {
+    (void)fd;
+    (void)condition;
+    (void)userdata;
+
+    syslog(LOG_INFO, "Draw command publisher disconnected, %u frames were dropped",
+           atomic_load(&ring->dropped_frames));
+    publisher_watch_id = 0;
+    disconnect_publisher();
+    draw_ring_reset(ring);
+    pending_count = 0;
+    shown_count = 0;
+    redraw_all_overlays();
+    return G_SOURCE_REMOVE;
+}
+
+static void disconnect_publisher(void) {
+    if (ring_poll_id)
+        g_source_remove(ring_poll_id);
+    ring_poll_id = 0;
+    if (publisher_watch_id)
+        g_source_remove(publisher_watch_id);
+    publisher_watch_id = 0;
+    if (publisher_fd >= 0)
+        close(publisher_fd);
+    publisher_fd = -1;
+}
+
+static gboolean ring_poll_callback(gpointer userdata) {
+    (void)userdata;
+
+    struct draw_command commands[DRAW_RING_CAPACITY];
+    bool committed = false;
+    size_t count = draw_ring_consume(ring, commands, DRAW_RING_CAPACITY);
+
+    for (size_t i = 0; i < count; i++) {
+        switch (commands[i].type) {
+            case DRAW_CMD_CLEAR:
+                pending_count = 0;
+                break;
+            case DRAW_CMD_RECT:
+            case DRAW_CMD_TEXT:
+                if (pending_count < DRAW_RING_CAPACITY)
+                    pending_frame[pending_count++] = commands[i];
+                break;
+            case DRAW_CMD_COMMIT:
+                memcpy(shown_frame, pending_frame, pending_count * sizeof(pending_frame[0]));
+                shown_count = pending_count;
+                committed = true;
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Only the newest committed frame is drawn, older ones drained in the
+    // same poll are never rendered
+    if (committed)
+        redraw_all_overlays();
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void redraw_all_overlays(void) {
+    GHashTableIter iter;
+    gpointer key = NULL;
+    gpointer value = NULL;
+
+    g_hash_table_iter_init(&iter, overlay_table);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        struct overlay* overlay = value;
+        // An overlay waiting for a buffer picks up the new frame on its retry
+        if (!overlay->tick_source_id)
+            schedule_overlay(overlay, 0);
+    }
+}
@@ -0,0 +1,53 @@
+// Copyright (C) 2026 Axis Communications AB, Lund, Sweden
+// Licensed under the MIT License. See LICENSE file for details.
+
+#include "render_policy.h"
+
+#include <syslog.h>
+
+// axoverlay2 can upscale an overlay by two in each direction, so rendering
+// at half width and height costs a quarter of the Cairo and memcpy work.
+struct content_policy {
+    const char* name;
+    // Smallest stream, in pixels, where reduced resolution is considered
+    unsigned min_stream_pixels;
+    // Smallest detail size, in overlay pixels, that still looks right
+    double min_detail_px;
+};
+
+static const struct content_policy policies[] = {
+    [RENDER_CONTENT_BOXES] = {"boxes", 2000000, 2.0},
+    [RENDER_CONTENT_LARGE_TEXT] = {"large text", 2000000, 16.0},
+    [RENDER_CONTENT_SMALL_TEXT] = {"small text", 8000000, 12.0},
+    [RENDER_CONTENT_IMAGE] = {"image", 8000000, 64.0},
+};
+
+struct render_plan render_policy_choose(enum render_content content,
+                                        double detail_size,
+                                        unsigned stream_width,
+                                        unsigned stream_height) {
+    const struct content_policy* policy = &policies[content];
+    unsigned stream_pixels = stream_width * stream_height;
+    double half_detail_px = detail_size * (double)stream_height / 2.0;
+
+    bool upscale = stream_pixels >= policy->min_stream_pixels &&
+                   half_detail_px >= policy->min_detail_px;
+
+    struct render_plan plan = {
+        .used_width = upscale ? stream_width / 2 : stream_width,
+        .used_height = upscale ? stream_height / 2 : stream_height,
+        .upscale_x2 = upscale,
+        .detail_px = upscale ? half_detail_px : detail_size * (double)stream_height,
+    };
+
+    syslog(LOG_INFO,
+           "Render %s on %ux%u stream at %ux%u%s, smallest detail %.1f px",
+           policy->name,
+           stream_width,
+           stream_height,
+           plan.used_width,
+           plan.used_height,
+           upscale ? " (upscale x2)" : "",
+           plan.detail_px);
+    return plan;
+}
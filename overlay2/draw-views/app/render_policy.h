@@ -0,0 +1,30 @@
+// Copyright (C) 2026 Axis Communications AB, Lund, Sweden
+// Licensed under the MIT License. See LICENSE file for details.
+
+#pragma once
+
+#include <stdbool.h>
+
+// What an overlay draws. Each class has its own stream size threshold and
+// smallest detail that must survive rendering at reduced resolution.
+enum render_content {
+    RENDER_CONTENT_BOXES,
+    RENDER_CONTENT_LARGE_TEXT,
+    RENDER_CONTENT_SMALL_TEXT,
+    RENDER_CONTENT_IMAGE,
+};
+
+struct render_plan {
+    unsigned used_width;
+    unsigned used_height;
+    bool upscale_x2;
+    // Size in overlay pixels of the smallest detail after scaling
+    double detail_px;
+};
+
+// Choose the overlay render size for one stream. detail_size is the size of
+// the smallest detail the content draws, as a fraction of the stream height.
+struct render_plan render_policy_choose(enum render_content content,
+                                        double detail_size,
+                                        unsigned stream_width,
+                                        unsigned stream_height);
@@ -0,0 +1,151 @@
+/*
+ * Batched parameter updates
+ *
+ * Validates values against the metadata the parameters were declared with
+ * and applies a whole set of them in one pass under the handle mutex. Only
+ * the last ax_parameter_set syncs, so the parameter service commits the
+ * batch once instead of once per value. If a set fails, the values already
+ * written are put back, so a batch is applied completely or not at all.
+ */
+#include "param_batch.h"
+
+#include <errno.h>
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+const struct param_decl* param_decl_find(const struct param_decl* decls, size_t n, const char* name) {
+    for (size_t i = 0; i < n; i++) {
+        if (strcmp(decls[i].name, name) == 0) return &decls[i];
+    }
+    return NULL;
+}
+
+/* Value of key=N in an option list like "min=1;max=16" */
+static gboolean meta_option(const char* opts, const char* key, long* out) {
+    size_t key_len = strlen(key);
+    for (const char* p = opts; p && *p; p = strchr(p, ';') ? strchr(p, ';') + 1 : NULL) {
+        if (strncmp(p, key, key_len) == 0 && p[key_len] == '=') {
+            *out = strtol(p + key_len + 1, NULL, 10);
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static gboolean parse_long(const char* value, long* out) {
+    char* end = NULL;
+    errno = 0;
+    *out = strtol(value, &end, 10);
+    return errno == 0 && end != value && *end == '\0';
+}
+
+/**
+ * Check a value against the declared metadata. Understands the types used
+ * in paramConfig: "string[:maxlen=N]", "int[:min=N;max=N]" and
+ * "bool:<false>,<true>". Unknown types are accepted and left to
+ * ax_parameter_set.
+ */
+gboolean param_decl_validate(const struct param_decl* decl, const char* value, const char** reason) {
+    const char* meta = decl->meta;
+    const char* opts = strchr(meta, ':');
+    size_t type_len = opts ? (size_t)(opts - meta) : strlen(meta);
+    long limit = 0;
+
+    if (opts) opts++;
+
+    if (strncmp(meta, "int", type_len) == 0 && type_len == 3) {
+        long n = 0;
+        if (!parse_long(value, &n)) {
+            *reason = "not an integer";
+            return FALSE;
+        }
+        if (meta_option(opts, "min", &limit) && n < limit) {
+            *reason = "below minimum";
+            return FALSE;
+        }
+        if (meta_option(opts, "max", &limit) && n > limit) {
+            *reason = "above maximum";
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    if (strncmp(meta, "bool", type_len) == 0 && type_len == 4) {
+        // bool:no,yes
+        const char* comma = opts ? strchr(opts, ',') : NULL;
+        if (!comma || (strncmp(value, opts, (size_t)(comma - opts)) == 0 && value[comma - opts] == '\0') ||
+            strcmp(value, comma + 1) == 0)
+            return TRUE;
+        *reason = "not one of the declared values";
+        return FALSE;
+    }
+
+    if (strncmp(meta, "string", type_len) == 0 && type_len == 6) {
+        if (meta_option(opts, "maxlen", &limit) && strlen(value) > (size_t)limit) {
+            *reason = "too long";
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Write values[i] to names[i] for all i, in one locked pass. Validate the
+ * values first, this only reports failures from the parameter service.
+ *
+ * On failure the index of the parameter that failed is stored in failed
+ * and the values written before it are restored.
+ */
+gboolean param_batch_apply(AXParameter* handle,
+                           pthread_mutex_t* handle_mtx,
+                           const char* const* names,
+                           const char* const* values,
+                           size_t n,
+                           size_t* failed) {
+    char** previous = g_new0(char*, n);
+    gboolean ok = TRUE;
+    size_t i = 0;
+
+    pthread_mutex_lock(handle_mtx);
+
+    for (i = 0; i < n; i++) {
+        GError* err = NULL;
+        if (!ax_parameter_get(handle, names[i], &previous[i], &err)) {
+            syslog(LOG_ERR, "batch: get(%s) failed: %s", names[i], err ? err->message : "unknown");
+            g_clear_error(&err);
+            ok = FALSE;
+            break;
+        }
+    }
+
+    for (size_t j = 0; ok && j < n; j++) {
+        GError* err = NULL;
+        // Sync only with the last value, the service commits the batch once
+        if (!ax_parameter_set(handle, names[j], values[j], j == n - 1, &err)) {
+            syslog(LOG_ERR, "batch: set(%s=%s) failed: %s", names[j], values[j], err ? err->message : "unknown");
+            g_clear_error(&err);
+            ok = FALSE;
+            i = j;
+
+            // Roll back what was written, newest first
+            while (j-- > 0) {
+                if (!ax_parameter_set(handle, names[j], previous[j], j == 0, &err)) {
+                    syslog(LOG_ERR, "batch: rollback of %s failed: %s", names[j], err ? err->message : "unknown");
+                    g_clear_error(&err);
+                }
+            }
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(handle_mtx);
+
+    if (!ok && failed) *failed = i;
+    for (size_t j = 0; j < n; j++) g_free(previous[j]);
+    g_free(previous);
+    return ok;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <axsdk/axparameter.h>
+#include <pthread.h>
+#include <stddef.h>
+
+/*
+ * A parameter the app declares, with the same metadata string that is passed
+ * to ax_parameter_add and listed in manifest.json paramConfig.
+ */
+struct param_decl {
+    const char* name;
+    const char* def;
+    const char* meta;
+};
+
+const struct param_decl* param_decl_find(const struct param_decl* decls, size_t n, const char* name);
+gboolean param_decl_validate(const struct param_decl* decl, const char* value, const char** reason);
+
+gboolean param_batch_apply(AXParameter* handle,
+                           pthread_mutex_t* handle_mtx,
+                           const char* const* names,
+                           const char* const* values,
+                           size_t n,
+                           size_t* failed);
@@ -0,0 +1,255 @@
+/*
+ * In-process parameter cache
+ *
+ * GET handlers read parameters from an immutable snapshot instead of asking
+ * the parameter service on every request. Changes, from the POST handler or
+ * from ax_parameter_register_callback, build a new snapshot and publish it
+ * with one atomic pointer swap, RCU style.
+ *
+ * With a renderer the response body and its ETag are produced together with
+ * the snapshot, so a GET only copies bytes and allocates nothing.
+ *
+ * Readers take no lock. They announce themselves in one of two reader
+ * counters, chosen by the current epoch. A writer swaps the pointer, flips
+ * the epoch and then waits for the counter of the old epoch to drain before
+ * freeing the old snapshot. Readers arriving after the flip use the other
+ * counter, so the writer cannot be starved by a steady stream of GETs.
+ */
+#include "param_cache.h"
+
+#include <glib.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+static AXParameter* cache_handle = NULL;
+static pthread_mutex_t* cache_handle_mtx = NULL;
+static param_render_func cache_render = NULL;
+
+static _Atomic(struct param_snapshot*) current = NULL;
+static atomic_uint epoch = 0;
+static atomic_uint readers[2];
+// Serializes writers, readers never take it
+static pthread_mutex_t writer_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static void snapshot_free(struct param_snapshot* snap) {
+    if (!snap) return;
+    for (size_t i = 0; i < snap->count; i++) {
+        g_free(snap->names[i]);
+        g_free(snap->values[i]);
+    }
+    g_free(snap->names);
+    g_free(snap->values);
+    free(snap->body);
+    g_free(snap);
+}
+
+static struct param_snapshot* snapshot_new(size_t count) {
+    struct param_snapshot* snap = g_new0(struct param_snapshot, 1);
+    snap->count = count;
+    snap->names = g_new0(char*, count);
+    snap->values = g_new0(char*, count);
+    return snap;
+}
+
+/* 64-bit FNV-1a, enough to tell two bodies apart */
+static uint64_t body_hash(const char* data, size_t len) {
+    uint64_t h = 0xcbf29ce484222325u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 0x100000001b3u;
+    }
+    return h;
+}
+
+static void render(struct param_snapshot* snap) {
+    if (!snap || !cache_render) return;
+    snap->body = cache_render(snap);
+    if (!snap->body) return;
+    snap->body_len = strlen(snap->body);
+    // Derived from the bytes, so it stays valid across restarts
+    snprintf(snap->etag, sizeof(snap->etag), "\"%016" PRIx64 "\"", body_hash(snap->body, snap->body_len));
+}
+
+/* Publish snap and free the snapshot it replaces once no reader uses it */
+static void publish(struct param_snapshot* snap) {
+    render(snap);
+    struct param_snapshot* old = atomic_exchange(&current, snap);
+    unsigned old_epoch = atomic_fetch_add(&epoch, 1) & 1;
+
+    while (atomic_load(&readers[old_epoch]) != 0)
+        g_usleep(50);
+
+    snapshot_free(old);
+}
+
+/* Callback names are fully qualified, e.g. root.App_name.Port */
+static const char* short_name(const char* name) {
+    const char* dot = strrchr(name, '.');
+    return dot ? dot + 1 : name;
+}
+
+static void on_parameter_changed(const gchar* name, const gchar* value, gpointer data) {
+    (void)data;
+    param_cache_update(short_name(name), value);
+}
+
+/**
+ * Load the initial snapshot and subscribe to changes of every parameter.
+ *
+ * The change callbacks are delivered from the GLib main loop, so the
+ * application must run one for the cache to follow changes made outside
+ * the app, e.g. from the parameter list in the web interface.
+ *
+ * render may be NULL if the snapshot values are enough.
+ */
+gboolean param_cache_init(AXParameter* handle,
+                          pthread_mutex_t* handle_mtx,
+                          const char* const* names,
+                          size_t count,
+                          param_render_func render_func) {
+    struct param_snapshot* snap = snapshot_new(count);
+
+    cache_handle = handle;
+    cache_handle_mtx = handle_mtx;
+    cache_render = render_func;
+
+    pthread_mutex_lock(handle_mtx);
+    for (size_t i = 0; i < count; i++) {
+        GError* err = NULL;
+        snap->names[i] = g_strdup(names[i]);
+        if (!ax_parameter_get(handle, names[i], &snap->values[i], &err)) {
+            syslog(LOG_WARNING, "param cache: get(%s) failed: %s", names[i], err ? err->message : "unknown");
+            g_clear_error(&err);
+        }
+        if (!ax_parameter_register_callback(handle, names[i], on_parameter_changed, NULL, &err)) {
+            syslog(LOG_ERR, "param cache: callback for %s failed: %s", names[i], err ? err->message : "unknown");
+            g_clear_error(&err);
+            pthread_mutex_unlock(handle_mtx);
+            snapshot_free(snap);
+            return FALSE;
+        }
+    }
+    pthread_mutex_unlock(handle_mtx);
+
+    pthread_mutex_lock(&writer_mtx);
+    publish(snap);
+    pthread_mutex_unlock(&writer_mtx);
+    return TRUE;
+}
+
+void param_cache_cleanup(void) {
+    if (cache_handle) {
+        pthread_mutex_lock(cache_handle_mtx);
+        const struct param_snapshot* snap = atomic_load(&current);
+        for (size_t i = 0; snap && i < snap->count; i++)
+            ax_parameter_unregister_callback(cache_handle, snap->names[i]);
+        pthread_mutex_unlock(cache_handle_mtx);
+    }
+
+    pthread_mutex_lock(&writer_mtx);
+    publish(NULL);
+    pthread_mutex_unlock(&writer_mtx);
+    cache_handle = NULL;
+}
+
+/**
+ * Get the current snapshot without locking.
+ *
+ * The snapshot stays valid until param_cache_read_unlock() is called with
+ * the returned token. Keep the read section short, a writer waits for it.
+ */
+const struct param_snapshot* param_cache_read_lock(unsigned* token) {
+    for (;;) {
+        unsigned e = atomic_load(&epoch) & 1;
+        atomic_fetch_add(&readers[e], 1);
+        // A writer flipped the epoch in between and may not wait for us
+        if ((atomic_load(&epoch) & 1) == e) {
+            *token = e;
+            return atomic_load(&current);
+        }
+        atomic_fetch_sub(&readers[e], 1);
+    }
+}
+
+void param_cache_read_unlock(unsigned token) {
+    atomic_fetch_sub(&readers[token], 1);
+}
+
+const char* param_snapshot_get(const struct param_snapshot* snap, const char* name) {
+    for (size_t i = 0; snap && i < snap->count; i++) {
+        if (strcmp(snap->names[i], name) == 0) return snap->values[i];
+    }
+    return NULL;
+}
+
+/**
+ * Check an If-None-Match header against the rendered body. Handles "*" and
+ * lists of tags. If-None-Match uses the weak comparison, so W/ is ignored.
+ */
+gboolean param_snapshot_etag_matches(const struct param_snapshot* snap, const char* if_none_match) {
+    if (!snap || !snap->body || !if_none_match) return FALSE;
+    if (strcmp(if_none_match, "*") == 0) return TRUE;
+    return strstr(if_none_match, snap->etag) != NULL;
+}
+
+/* Caller holds writer_mtx */
+static void update_locked(const char* const* names, const char* const* values, size_t n) {
+    const struct param_snapshot* old = atomic_load(&current);
+    if (!old) return;
+
+    struct param_snapshot* snap = snapshot_new(old->count);
+    gboolean changed = FALSE;
+    snap->version = old->version + 1;
+    for (size_t i = 0; i < old->count; i++) {
+        const char* value = old->values[i];
+        for (size_t j = 0; j < n; j++) {
+            if (strcmp(old->names[i], names[j]) == 0) value = values[j];
+        }
+        changed |= g_strcmp0(value, old->values[i]) != 0;
+        snap->names[i] = g_strdup(old->names[i]);
+        snap->values[i] = g_strdup(value);
+    }
+
+    if (changed)
+        publish(snap);
+    else
+        snapshot_free(snap);
+}
+
+/**
+ * Replace one value. Call only after ax_parameter_set succeeded, so the
+ * cache never shows a value the parameter service rejected.
+ */
+void param_cache_update(const char* name, const char* value) {
+    param_cache_update_many(&name, &value, 1);
+}
+
+/**
+ * Replace several values with a single new snapshot, so readers see either
+ * none or all of them and the body is rendered once. Names the cache does
+ * not hold are ignored. No snapshot is published if nothing changed.
+ */
+void param_cache_update_many(const char* const* names, const char* const* values, size_t n) {
+    pthread_mutex_lock(&writer_mtx);
+    update_locked(names, values, n);
+    pthread_mutex_unlock(&writer_mtx);
+}
+
+/**
+ * Bracket a batch write to the parameter service. The change callbacks the
+ * batch triggers wait for param_cache_end_batch, which publishes the whole
+ * batch at once, and then find nothing new, so a batch is one change.
+ */
+void param_cache_begin_batch(void) {
+    pthread_mutex_lock(&writer_mtx);
+}
+
+/* Pass names as NULL when the batch was rolled back */
+void param_cache_end_batch(const char* const* names, const char* const* values, size_t n) {
+    if (names) update_locked(names, values, n);
+    pthread_mutex_unlock(&writer_mtx);
+}
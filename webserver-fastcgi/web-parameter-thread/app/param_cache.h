@@ -0,0 +1,44 @@
+#pragma once
+
+#include <axsdk/axparameter.h>
+#include <pthread.h>
+#include <stddef.h>
+
+/*
+ * Immutable copy of a fixed set of parameters. A new snapshot replaces the
+ * old one on every change, readers never see a snapshot being modified.
+ */
+struct param_snapshot {
+    unsigned long version;
+    size_t count;
+    char** names;
+    char** values;  // NULL if the parameter could not be read
+
+    // Response rendered once per snapshot, NULL without a renderer
+    char* body;
+    size_t body_len;
+    char etag[24];  // strong ETag of body, quotes included
+};
+
+/*
+ * Builds the response body for a snapshot. Runs on the writer side, once
+ * per change, and returns a malloc'd NUL terminated string or NULL.
+ */
+typedef char* (*param_render_func)(const struct param_snapshot* snap);
+
+gboolean param_cache_init(AXParameter* handle,
+                          pthread_mutex_t* handle_mtx,
+                          const char* const* names,
+                          size_t count,
+                          param_render_func render);
+void param_cache_cleanup(void);
+
+const struct param_snapshot* param_cache_read_lock(unsigned* token);
+void param_cache_read_unlock(unsigned token);
+const char* param_snapshot_get(const struct param_snapshot* snap, const char* name);
+gboolean param_snapshot_etag_matches(const struct param_snapshot* snap, const char* if_none_match);
+
+void param_cache_update(const char* name, const char* value);
+void param_cache_update_many(const char* const* names, const char* const* values, size_t n);
+void param_cache_begin_batch(void);
+void param_cache_end_batch(const char* const* names, const char* const* values, size_t n);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Admission control for the HTTP handlers. Every client gets a token bucket
+ * per route, and the number of requests being handled at once is capped.
+ * Both checks are answered right away, nothing waits.
+ */
+enum rate_limit_verdict {
+    RATE_LIMIT_ADMIT,
+    RATE_LIMIT_THROTTLED,  // client is over its rate, answer 429
+    RATE_LIMIT_BUSY,       // too many requests in progress, answer 503
+};
+
+/*
+ * rate is in requests per second per client and route, burst is the bucket
+ * size. 0 disables the rate limit or the in-flight cap. Safe to call while
+ * requests are being admitted.
+ */
+void rate_limit_configure(unsigned rate, unsigned burst, unsigned max_in_flight);
+
+/*
+ * Admit one request. On RATE_LIMIT_ADMIT the caller must call
+ * rate_limit_release when the request is done. retry_after is set to the
+ * seconds the client should wait when the request is rejected.
+ */
+enum rate_limit_verdict rate_limit_admit(const char* client, const char* route, unsigned* retry_after);
+void rate_limit_release(void);
+
+void rate_limit_counters(unsigned long* throttled, unsigned long* busy);
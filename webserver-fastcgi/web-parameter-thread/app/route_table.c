@@ -0,0 +1,174 @@
+/*
+ * Request routing with per-route metrics
+ *
+ * The routes are a static table. At startup a seed is searched for that maps
+ * every path to its own slot of a small power-of-two table, a perfect hash
+ * for this set of paths. A lookup is then one hash and one strcmp, however
+ * many routes there are. The table is read-only once the workers run.
+ *
+ * Every route has its own counters: requests, errors (status 400 and up),
+ * response body bytes and a latency histogram. They are plain atomics
+ * written by whichever worker handled the request.
+ */
+#include "route_table.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <syslog.h>
+
+#define MAX_SLOTS 256
+#define MAX_SEED 4096
+
+// Upper bounds of the latency buckets, in microseconds and as le labels
+static const gint64 bucket_usec[] = {500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000};
+static const char* const bucket_le[] = {"0.0005", "0.001", "0.0025", "0.005", "0.01", "0.025",
+                                        "0.05", "0.1", "0.25", "0.5", "1"};
+#define NUM_BUCKETS G_N_ELEMENTS(bucket_usec)
+
+struct route_stats {
+    atomic_ulong requests;
+    atomic_ulong errors;
+    atomic_ulong bytes;
+    atomic_ulong usec_sum;
+    atomic_ulong buckets[NUM_BUCKETS + 1];  // last one is +Inf
+};
+
+static const struct route* table = NULL;
+static size_t table_count = 0;
+static struct route_stats* stats = NULL;
+static atomic_ulong unmatched;
+
+// Route index + 1 per slot, 0 for an empty slot
+static uint8_t slots[MAX_SLOTS];
+static uint32_t slot_mask = 0;
+static uint32_t hash_seed = 0;
+
+static uint32_t route_hash(const char* s, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h ^ (h >> 16);
+}
+
+static gboolean try_seed(uint32_t seed, uint32_t mask) {
+    memset(slots, 0, sizeof(slots));
+    for (size_t i = 0; i < table_count; i++) {
+        uint32_t slot = route_hash(table[i].path, seed) & mask;
+        if (slots[slot]) return FALSE;
+        slots[slot] = (uint8_t)(i + 1);
+    }
+    return TRUE;
+}
+
+gboolean route_table_init(const struct route* routes, size_t count) {
+    table = routes;
+    table_count = count;
+
+    if (count == 0 || count >= MAX_SLOTS) {
+        syslog(LOG_ERR, "route table: unsupported route count %zu", count);
+        return FALSE;
+    }
+
+    // Smallest table first, a larger one if no seed separates the paths
+    for (uint32_t size = 1; size <= MAX_SLOTS; size <<= 1) {
+        if (size < count) continue;
+        for (uint32_t seed = 0; seed < MAX_SEED; seed++) {
+            if (try_seed(seed, size - 1)) {
+                slot_mask = size - 1;
+                hash_seed = seed;
+                stats = g_new0(struct route_stats, count);
+                syslog(LOG_INFO, "route table: %zu routes in %u slots, seed %u", count, size, seed);
+                return TRUE;
+            }
+        }
+    }
+
+    // Only happens for duplicate paths
+    syslog(LOG_ERR, "route table: no perfect hash found, check for duplicate paths");
+    return FALSE;
+}
+
+const struct route* route_table_lookup(const char* path) {
+    if (!table || !path) return NULL;
+
+    uint8_t index = slots[route_hash(path, hash_seed) & slot_mask];
+    if (!index) return NULL;
+
+    const struct route* route = &table[index - 1];
+    return strcmp(route->path, path) == 0 ? route : NULL;
+}
+
+unsigned route_method_from_string(const char* method) {
+    if (!method) return 0;
+    // HEAD is answered like GET, FastCGI leaves dropping the body to the server
+    if (strcmp(method, "GET") == 0 || strcmp(method, "HEAD") == 0) return ROUTE_GET;
+    if (strcmp(method, "POST") == 0) return ROUTE_POST;
+    return 0;
+}
+
+void route_table_record(const struct route* route, int status, size_t bytes, gint64 usec) {
+    if (!route) {
+        atomic_fetch_add(&unmatched, 1);
+        return;
+    }
+
+    struct route_stats* s = &stats[route - table];
+    size_t bucket = 0;
+    while (bucket < NUM_BUCKETS && usec > bucket_usec[bucket]) bucket++;
+
+    atomic_fetch_add(&s->requests, 1);
+    if (status >= 400) atomic_fetch_add(&s->errors, 1);
+    atomic_fetch_add(&s->bytes, bytes);
+    atomic_fetch_add(&s->usec_sum, (unsigned long)(usec > 0 ? usec : 0));
+    atomic_fetch_add(&s->buckets[bucket], 1);
+}
+
+static void render_counter(GString* out, const char* metric, const char* help, size_t offset) {
+    g_string_append_printf(out, "# HELP %s %s\n# TYPE %s counter\n", metric, help, metric);
+    for (size_t i = 0; i < table_count; i++) {
+        const atomic_ulong* value = (const atomic_ulong*)((const char*)&stats[i] + offset);
+        g_string_append_printf(out, "%s{route=\"%s\"} %lu\n", metric, table[i].name, atomic_load(value));
+    }
+}
+
+/*
+ * Counters are read one by one while workers keep writing, so a scrape can
+ * be off by the requests in flight. Prometheus tolerates that.
+ */
+void route_table_render_metrics(GString* out) {
+    if (!stats) return;
+
+    render_counter(out, "acap_http_requests_total", "Requests handled per route.",
+                   offsetof(struct route_stats, requests));
+    render_counter(out, "acap_http_errors_total", "Responses with status 400 or higher per route.",
+                   offsetof(struct route_stats, errors));
+    render_counter(out, "acap_http_response_bytes_total", "Response body bytes sent per route.",
+                   offsetof(struct route_stats, bytes));
+
+    g_string_append(out,
+                    "# HELP acap_http_request_duration_seconds Time spent in the route handler.\n"
+                    "# TYPE acap_http_request_duration_seconds histogram\n");
+    for (size_t i = 0; i < table_count; i++) {
+        const struct route_stats* s = &stats[i];
+        unsigned long cumulative = 0;
+        for (size_t b = 0; b <= NUM_BUCKETS; b++) {
+            cumulative += atomic_load(&s->buckets[b]);
+            g_string_append_printf(out, "acap_http_request_duration_seconds_bucket{route=\"%s\",le=\"%s\"} %lu\n",
+                                   table[i].name, b < NUM_BUCKETS ? bucket_le[b] : "+Inf", cumulative);
+        }
+        unsigned long usec_sum = atomic_load(&s->usec_sum);
+        g_string_append_printf(out, "acap_http_request_duration_seconds_sum{route=\"%s\"} %lu.%06lu\n",
+                               table[i].name, usec_sum / 1000000, usec_sum % 1000000);
+        g_string_append_printf(out, "acap_http_request_duration_seconds_count{route=\"%s\"} %lu\n",
+                               table[i].name, cumulative);
+    }
+
+    g_string_append_printf(out,
+                           "# HELP acap_http_unmatched_requests_total Requests for unknown endpoints.\n"
+                           "# TYPE acap_http_unmatched_requests_total counter\n"
+                           "acap_http_unmatched_requests_total %lu\n",
+                           atomic_load(&unmatched));
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <fcgiapp.h>
+#include <glib.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+enum route_method {
+    ROUTE_GET = 1 << 0,
+    ROUTE_POST = 1 << 1,
+};
+
+typedef void (*route_handler)(FCGX_Request* req);
+
+/*
+ * One endpoint. name is the route label in the metrics, methods is a mask
+ * of route_method values.
+ */
+struct route {
+    const char* path;
+    const char* name;
+    unsigned methods;
+    route_handler handler;
+};
+
+gboolean route_table_init(const struct route* routes, size_t count);
+
+const struct route* route_table_lookup(const char* path);
+unsigned route_method_from_string(const char* method);
+
+// Account one request. route is NULL for requests that matched no route.
+void route_table_record(const struct route* route, int status, size_t bytes, gint64 usec);
+
+// Append all route counters in Prometheus text format
+void route_table_render_metrics(GString* out);
@@ -4,21 +4,83 @@
 #include <jansson.h>
 #include <axsdk/axparameter.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <syslog.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <signal.h>
 #include <glib-unix.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "json_body.h"
+#include "param_batch.h"
+#include "param_cache.h"
+#include "rate_limit.h"
+#include "route_table.h"
 
 #define FCGI_SOCKET_NAME "FCGI_SOCKET_NAME"
 #define APP_NAME "web_parameter_thread"   // ACAP app scope for AXParameter
 #define ENDPOINT_SET "/local/web_parameter_thread/parameter-acap.cgi"
 #define ENDPOINT_GET "/local/web_parameter_thread/information-acap.cgi"
+#define ENDPOINT_BATCH "/local/web_parameter_thread/batch-acap.cgi"
+#define ENDPOINT_METRICS "/local/web_parameter_thread/metrics"
+
+/* Worker pool size comes from the WorkerThreads parameter */
+#define DEFAULT_WORKERS "4"
+#define MAX_WORKERS 16
+#define SOCKET_BACKLOG 64
 
 static AXParameter* handle = NULL;
 static pthread_mutex_t handle_mtx = PTHREAD_MUTEX_INITIALIZER;
 
+/* Every parameter of the app, kept in sync with manifest.json paramConfig */
+static const struct param_decl params[] = {
+    {"IpAddress", "192.168.0.90", "string"},
+    {"Port", "8080", "string"},
+    {"WorkerThreads", DEFAULT_WORKERS, "int:min=1;max=16"},
+    {"RateLimit", "10", "int:min=0;max=1000"},
+    {"RateBurst", "20", "int:min=1;max=1000"},
+    {"MaxInFlight", "3", "int:min=0;max=16"},
+};
+
+/* Parameters served by handle_info, read from param_cache */
+static const char* const cached_params[] = {"IpAddress", "Port"};
+
+/* Admission control settings, applied as soon as they change */
+static const char* const limit_params[] = {"RateLimit", "RateBurst", "MaxInFlight"};
+static unsigned limits[G_N_ELEMENTS(limit_params)];
+// Guards limits, so a batch and the change callbacks it triggers configure once
+static pthread_mutex_t limits_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* ---------- worker pool ---------- */
+/*
+ * Each worker owns an FCGX_Request on the shared listen socket, so a slow
+ * request only holds up its own worker. Counters are written by the owning
+ * worker and read by handle_info from any worker.
+ */
+struct worker {
+    pthread_t thread;
+    int index;
+    FCGX_Request req;
+    atomic_ulong requests;
+    atomic_ulong errors;
+};
+
+static struct worker workers[MAX_WORKERS];
+static int num_workers = 0;
+/* Serializes FCGX_Accept_r, as in the libfcgi threaded example */
+static pthread_mutex_t accept_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* Status and body size of the response the worker is writing, for metrics */
+static __thread struct {
+    int status;
+    size_t bytes;
+} response;
+
 /* ---------- logging panic ---------- */
 __attribute__((noreturn)) __attribute__((format(printf,1,2)))
 static void panic(const char* fmt, ...) {
@@ -84,74 +146,194 @@ static void send_json(FCGX_Request* req, int status_code, json_t* obj) {
                  "\r\n"
                  "%s",
                  status_code, body ? body : "{}");
+    response.status = status_code;
+    response.bytes = body ? strlen(body) : 2;
     free(body);
 }
 
-static json_t* read_json_body(FCGX_Request* req) {
-    const char* cl_str = FCGX_GetParam("CONTENT_LENGTH", req->envp);
-    long len = cl_str ? strtol(cl_str, NULL, 10) : 0;
-    if (len <= 0) return NULL;
-
-    char* buf = (char*)malloc((size_t)len + 1);
-    if (!buf) return NULL;
-
-    int read_total = 0;
-    while (read_total < len) {
-        int n = FCGX_GetStr(buf + read_total, len - read_total, req->in);
-        if (n <= 0) break;
-        read_total += n;
+/*
+ * Answer from the pre-rendered snapshot body. Nothing is built or allocated
+ * per request, and a matching If-None-Match gets 304 without a body.
+ * no-cache rather than no-store, so browsers keep the body and revalidate.
+ */
+static void send_cached(FCGX_Request* req, const struct param_snapshot* snap) {
+    const char* inm = FCGX_GetParam("HTTP_IF_NONE_MATCH", req->envp);
+
+    if (param_snapshot_etag_matches(snap, inm)) {
+        FCGX_FPrintF(req->out,
+                     "Status: 304\r\n"
+                     "ETag: %s\r\n"
+                     "Cache-Control: no-cache\r\n"
+                     "Access-Control-Allow-Origin: *\r\n"
+                     "\r\n",
+                     snap->etag);
+        response.status = 304;
+        response.bytes = 0;
+        return;
     }
-    buf[read_total] = '\0';
 
-    json_error_t err;
-    json_t* parsed = json_loads(buf, 0, &err);
-    if (!parsed) {
-        syslog(LOG_ERR, "JSON parse error: %s at line %d", err.text, err.line);
+    FCGX_FPrintF(req->out,
+                 "Status: 200\r\n"
+                 "Content-Type: application/json\r\n"
+                 "Content-Length: %zu\r\n"
+                 "ETag: %s\r\n"
+                 "Cache-Control: no-cache\r\n"
+                 "Access-Control-Allow-Origin: *\r\n"
+                 "Access-Control-Allow-Headers: content-type\r\n"
+                 "\r\n",
+                 snap->body_len, snap->etag);
+    FCGX_PutStr(snap->body, (int)snap->body_len, req->out);
+    response.status = 200;
+    response.bytes = snap->body_len;
+}
+
+/* 429 or 503 from admission control, written before any of the body is read */
+static void send_rejected(FCGX_Request* req, enum rate_limit_verdict verdict, unsigned retry_after) {
+    int status = verdict == RATE_LIMIT_BUSY ? 503 : 429;
+    const char* body = verdict == RATE_LIMIT_BUSY ? "{\"error\":\"Server busy\"}" : "{\"error\":\"Too many requests\"}";
+
+    FCGX_FPrintF(req->out,
+                 "Status: %d\r\n"
+                 "Content-Type: application/json\r\n"
+                 "Content-Length: %zu\r\n"
+                 "Retry-After: %u\r\n"
+                 "Cache-Control: no-store\r\n"
+                 "Access-Control-Allow-Origin: *\r\n"
+                 "\r\n"
+                 "%s",
+                 status, strlen(body), retry_after, body);
+    response.status = status;
+    response.bytes = strlen(body);
+}
+
+static int fcgx_read(void* conn, char* buf, size_t len) {
+    return FCGX_GetStr(buf, (int)len, ((FCGX_Request*)conn)->in);
+}
+
+/* Parse the body as a JSON object, or answer the request and return NULL */
+static json_t* read_json_body(FCGX_Request* req) {
+    int status = 400;
+    const char* message = NULL;
+    json_t* body = json_body_load(fcgx_read, req,
+                                  FCGX_GetParam("CONTENT_LENGTH", req->envp),
+                                  FCGX_GetParam("HTTP_TRANSFER_ENCODING", req->envp),
+                                  &status, &message);
+    if (body && !json_is_object(body)) {
+        json_decref(body);
+        body = NULL;
+        status = 400;
+        message = "Expected a JSON object";
     }
-    free(buf);
-    return parsed;
+    if (!body) {
+        json_t* err = json_pack("{s:s}", "error", message);
+        send_json(req, status, err);
+        json_decref(err);
+    }
+    return body;
 }
 
 /* ---------- Routing handlers ---------- */
-static void handle_info(FCGX_Request* req) {
+/* param_cache renderer, runs once per parameter change */
+static char* render_info(const struct param_snapshot* snap) {
     json_t* out = json_object();
+    for (size_t i = 0; i < snap->count; i++) {
+        json_object_set_new(out, snap->names[i], snap->values[i] ? json_string(snap->values[i]) : json_null());
+    }
+    json_object_set_new(out, "version", json_integer((json_int_t)snap->version));
+    json_object_set_new(out, "ok", json_true());
+    char* body = json_dumps(out, JSON_COMPACT);
+    json_decref(out);
+    return body;
+}
 
-    pthread_mutex_lock(&handle_mtx);
-    char* addr = get_param_dup("IpAddress");
-    char* port = get_param_dup("Port");
-    pthread_mutex_unlock(&handle_mtx);
+/* Worker counters change on every request, so they are never cached */
+static void handle_stats(FCGX_Request* req) {
+    json_t* pool = json_array();
+    for (int i = 0; i < num_workers; i++) {
+        json_array_append_new(pool,
+                              json_pack("{s:i,s:I,s:I}",
+                                        "worker", i,
+                                        "requests", (json_int_t)atomic_load(&workers[i].requests),
+                                        "errors", (json_int_t)atomic_load(&workers[i].errors)));
+    }
+    json_t* out = json_pack("{s:o,s:b}", "workers", pool, "ok", 1);
+    send_json(req, 200, out);
+    json_decref(out);
+}
 
-    if (addr) {
-        json_object_set_new(out, "IpAddress", json_string(addr));
-        free(addr);
-    } else {
-        json_object_set_new(out, "IpAddress", json_null());
+// True if one of the '&' separated fields of query is exactly param, e.g. "stats=1"
+static bool query_has(const char* query, const char* param) {
+    size_t len = strlen(param);
+    while (query) {
+        if (strncmp(query, param, len) == 0 && (query[len] == '\0' || query[len] == '&')) return true;
+        query = strchr(query, '&');
+        if (query) query++;
+    }
+    return false;
+}
+
+static void handle_info(FCGX_Request* req) {
+    const char* query = FCGX_GetParam("QUERY_STRING", req->envp);
+    if (query_has(query, "stats=1")) {
+        handle_stats(req);
+        return;
     }
 
-    if (port) {
-        json_object_set_new(out, "Port", json_string(port));
-        free(port);
+    // Lock-free snapshot, no round trip to the parameter service
+    unsigned token;
+    const struct param_snapshot* snap = param_cache_read_lock(&token);
+    if (snap && snap->body) {
+        send_cached(req, snap);
     } else {
-        json_object_set_new(out, "Port", json_null());
+        json_t* err = json_pack("{s:s}", "error", "Parameters not available");
+        send_json(req, 503, err);
+        json_decref(err);
     }
+    param_cache_read_unlock(token);
+}
 
-    json_object_set_new(out, "ok", json_true());
-    send_json(req, 200, out);
-    json_decref(out);
+/* Route counters and worker counters in Prometheus text format */
+static void handle_metrics(FCGX_Request* req) {
+    GString* out = g_string_sized_new(4096);
+    route_table_render_metrics(out);
+
+    g_string_append(out,
+                    "# HELP acap_fcgi_worker_requests_total Requests handled per worker.\n"
+                    "# TYPE acap_fcgi_worker_requests_total counter\n");
+    for (int i = 0; i < num_workers; i++) {
+        g_string_append_printf(out, "acap_fcgi_worker_requests_total{worker=\"%d\"} %lu\n",
+                               i, atomic_load(&workers[i].requests));
+    }
+
+    unsigned long throttled, busy;
+    rate_limit_counters(&throttled, &busy);
+    g_string_append_printf(out,
+                           "# HELP acap_http_rejected_total Requests refused by admission control.\n"
+                           "# TYPE acap_http_rejected_total counter\n"
+                           "acap_http_rejected_total{reason=\"throttled\"} %lu\n"
+                           "acap_http_rejected_total{reason=\"busy\"} %lu\n",
+                           throttled, busy);
+
+    FCGX_FPrintF(req->out,
+                 "Status: 200\r\n"
+                 "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                 "Content-Length: %zu\r\n"
+                 "Cache-Control: no-store\r\n"
+                 "\r\n",
+                 out->len);
+    FCGX_PutStr(out->str, (int)out->len, req->out);
+    response.status = 200;
+    response.bytes = out->len;
+    g_string_free(out, TRUE);
 }
 
 static void handle_param(FCGX_Request* req) {
     json_t* body = read_json_body(req);
-    if (!body || !json_is_object(body)) {
-        json_t* err = json_pack("{s:s}", "error", "Invalid JSON body");
-        send_json(req, 400, err);
-        json_decref(err);
-        if (body) json_decref(body);
-        return;
-    }
+    if (!body) return;
 
     const char* addr = NULL;
     const char* port = NULL;
+    char port_buf[32];
 
     json_t* jaddr = json_object_get(body, "IpAddress");
     if (jaddr && json_is_string(jaddr)) addr = json_string_value(jaddr);
@@ -159,9 +341,9 @@ static void handle_param(FCGX_Request* req) {
     json_t* jport = json_object_get(body, "Port");
     if (jport && json_is_string(jport)) port = json_string_value(jport);
     if (jport && json_is_integer(jport)) {
-        static char tmp[32];
-        snprintf(tmp, sizeof(tmp), "%" JSON_INTEGER_FORMAT, json_integer_value(jport));
-        port = tmp;
+        // Per request buffer, workers run this concurrently
+        snprintf(port_buf, sizeof(port_buf), "%" JSON_INTEGER_FORMAT, json_integer_value(jport));
+        port = port_buf;
     }
 
     if (!addr && !port) {
@@ -178,6 +360,10 @@ static void handle_param(FCGX_Request* req) {
     if (port) ok = ok && set_param("Port", port, FALSE);
     pthread_mutex_unlock(&handle_mtx);
 
+    // set_param skips the callbacks, so update the cache for what was stored
+    if (addr && ok) param_cache_update("IpAddress", addr);
+    if (port && ok) param_cache_update("Port", port);
+
     json_t* out = json_object();
     json_object_set_new(out, "ok", json_boolean(ok));
     if (!ok) json_object_set_new(out, "error", json_string("Failed to set one or more parameters"));
@@ -186,34 +372,232 @@ static void handle_param(FCGX_Request* req) {
     json_decref(body);
 }
 
-/* ---------- Simple router ---------- */
-static void handle_request(FCGX_Request* req) {
-    const char* script = FCGX_GetParam("SCRIPT_NAME", req->envp);
-    if (!script) script = "";
+/* Take the admission limits from names/values, reconfigure only if one changed. Caller holds limits_mtx */
+static void update_limits(const char* const* names, const char* const* values, size_t n) {
+    gboolean changed = FALSE;
 
-    if (strcmp(script, ENDPOINT_GET) == 0) {
-        handle_info(req);
+    for (size_t i = 0; i < G_N_ELEMENTS(limit_params); i++) {
+        for (size_t j = 0; j < n; j++) {
+            if (strcmp(names[j], limit_params[i]) != 0) continue;
+            unsigned limit = (unsigned)atoi(values[j]);
+            changed |= limit != limits[i];
+            limits[i] = limit;
+        }
+    }
+    if (!changed) return;
+    rate_limit_configure(limits[0], limits[1], limits[2]);
+    syslog(LOG_INFO, "Rate limit %u/s, burst %u, max in flight %u", limits[0], limits[1], limits[2]);
+}
+
+/*
+ * Update any number of declared parameters from one JSON object. All values
+ * are validated before anything is written, then applied in one locked pass
+ * and published to the cache as one change.
+ */
+static void handle_batch(FCGX_Request* req) {
+    json_t* body = read_json_body(req);
+    if (!body) return;
+    if (json_object_size(body) == 0) {
+        json_t* err = json_pack("{s:s}", "error", "Expected a non-empty JSON object");
+        send_json(req, 400, err);
+        json_decref(err);
+        json_decref(body);
         return;
     }
-    if (strcmp(script, ENDPOINT_SET) == 0) {
-        handle_param(req);
+
+    const char* names[G_N_ELEMENTS(params)];
+    const char* values[G_N_ELEMENTS(params)];
+    char int_bufs[G_N_ELEMENTS(params)][32];
+    size_t n = 0;
+    json_t* errors = json_object();
+
+    const char* key;
+    json_t* jval;
+    json_object_foreach(body, key, jval) {
+        const struct param_decl* decl = param_decl_find(params, G_N_ELEMENTS(params), key);
+        const char* value = NULL;
+        const char* reason = NULL;
+
+        if (!decl) {
+            json_object_set_new(errors, key, json_string("unknown parameter"));
+            continue;
+        }
+        if (json_is_string(jval)) {
+            value = json_string_value(jval);
+        } else if (json_is_integer(jval)) {
+            snprintf(int_bufs[n], sizeof(int_bufs[n]), "%" JSON_INTEGER_FORMAT, json_integer_value(jval));
+            value = int_bufs[n];
+        } else {
+            json_object_set_new(errors, key, json_string("must be a string or an integer"));
+            continue;
+        }
+        if (!param_decl_validate(decl, value, &reason)) {
+            json_object_set_new(errors, key, json_string(reason));
+            continue;
+        }
+        names[n] = decl->name;
+        values[n] = value;
+        n++;
+    }
+
+    if (json_object_size(errors) > 0) {
+        json_t* out = json_pack("{s:b,s:o}", "ok", 0, "errors", errors);
+        send_json(req, 400, out);
+        json_decref(out);
+        json_decref(body);
+        return;
+    }
+    json_decref(errors);
+
+    /*
+     * The parameter service reports every value of the batch to the change
+     * callbacks. They wait until the batch is published and then find
+     * nothing new, so readers and the rate limiter see one change.
+     */
+    size_t failed = 0;
+    pthread_mutex_lock(&limits_mtx);
+    param_cache_begin_batch();
+    gboolean applied = param_batch_apply(handle, &handle_mtx, names, values, n, &failed);
+    param_cache_end_batch(applied ? names : NULL, values, n);
+    if (applied) update_limits(names, values, n);
+    pthread_mutex_unlock(&limits_mtx);
+
+    if (!applied) {
+        json_t* out = json_pack("{s:b,s:s,s:s}",
+                                "ok", 0,
+                                "error", "Failed to set parameter, batch rolled back",
+                                "param", names[failed]);
+        send_json(req, 500, out);
+        json_decref(out);
+        json_decref(body);
         return;
     }
 
-    // Unknown endpoint
-    json_t* err = json_pack("{s:s,s:s}", "error", "Unknown endpoint", "script", script);
-    send_json(req, 404, err);
-    json_decref(err);
+    json_t* out = json_pack("{s:b,s:I}", "ok", 1, "applied", (json_int_t)n);
+    send_json(req, 200, out);
+    json_decref(out);
+    json_decref(body);
+}
+
+/* ---------- Router ---------- */
+static const struct route routes[] = {
+    {ENDPOINT_GET, "info", ROUTE_GET, handle_info},
+    {ENDPOINT_SET, "param", ROUTE_POST, handle_param},
+    {ENDPOINT_BATCH, "batch", ROUTE_POST, handle_batch},
+    {ENDPOINT_METRICS, "metrics", ROUTE_GET, handle_metrics},
+};
+
+static bool handle_request(FCGX_Request* req) {
+    const char* script = FCGX_GetParam("SCRIPT_NAME", req->envp);
+    if (!script) script = "";
+
+    const struct route* route = route_table_lookup(script);
+    if (!route) {
+        json_t* err = json_pack("{s:s,s:s}", "error", "Unknown endpoint", "script", script);
+        send_json(req, 404, err);
+        json_decref(err);
+        route_table_record(NULL, 404, 0, 0);
+        return false;
+    }
+
+    gint64 start = g_get_monotonic_time();
+    response.status = 0;
+    response.bytes = 0;
+
+    // Rejected requests are answered before the method or the body is looked at
+    unsigned retry_after = 0;
+    enum rate_limit_verdict verdict =
+        rate_limit_admit(FCGX_GetParam("REMOTE_ADDR", req->envp), route->name, &retry_after);
+
+    unsigned method = route_method_from_string(FCGX_GetParam("REQUEST_METHOD", req->envp));
+    if (verdict != RATE_LIMIT_ADMIT) {
+        send_rejected(req, verdict, retry_after);
+    } else if (!(route->methods & method)) {
+        json_t* err = json_pack("{s:s}", "error", "Method not allowed");
+        send_json(req, 405, err);
+        json_decref(err);
+        rate_limit_release();
+    } else {
+        route->handler(req);
+        rate_limit_release();
+    }
+
+    route_table_record(route, response.status, response.bytes, g_get_monotonic_time() - start);
+    return response.status < 400;
+}
+
+static void* worker_main(void* arg) {
+    struct worker* w = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&accept_mtx);
+        int rc = FCGX_Accept_r(&w->req);
+        pthread_mutex_unlock(&accept_mtx);
+        if (rc < 0) break;
+
+        if (!handle_request(&w->req)) atomic_fetch_add(&w->errors, 1);
+        atomic_fetch_add(&w->requests, 1);
+        FCGX_Finish_r(&w->req);
+    }
+
+    syslog(LOG_INFO, "Worker %d stopped after %lu requests", w->index, atomic_load(&w->requests));
+    return NULL;
+}
+
+static int read_worker_count(void) {
+    pthread_mutex_lock(&handle_mtx);
+    char* value = get_param_dup("WorkerThreads");
+    pthread_mutex_unlock(&handle_mtx);
+
+    int count = value ? atoi(value) : atoi(DEFAULT_WORKERS);
+    free(value);
+    if (count < 1) count = 1;
+    if (count > MAX_WORKERS) count = MAX_WORKERS;
+    return count;
+}
+
+static void on_limit_changed(const gchar* name, const gchar* value, gpointer data) {
+    (void)data;
+    const char* dot = strrchr(name, '.');
+    const char* short_name = dot ? dot + 1 : name;
+
+    pthread_mutex_lock(&limits_mtx);
+    update_limits(&short_name, &value, 1);
+    pthread_mutex_unlock(&limits_mtx);
+}
+
+/* Read the admission control parameters and follow later changes */
+static void init_limits(void) {
+    pthread_mutex_lock(&handle_mtx);
+    for (size_t i = 0; i < G_N_ELEMENTS(limit_params); i++) {
+        GError* err = NULL;
+        char* value = get_param_dup(limit_params[i]);
+        if (!value) value = g_strdup(param_decl_find(params, G_N_ELEMENTS(params), limit_params[i])->def);
+        limits[i] = (unsigned)atoi(value);
+        g_free(value);
+
+        if (!ax_parameter_register_callback(handle, limit_params[i], on_limit_changed, NULL, &err)) {
+            syslog(LOG_WARNING, "Callback for %s failed: %s", limit_params[i], err ? err->message : "unknown");
+            g_clear_error(&err);
+        }
+    }
+    pthread_mutex_unlock(&handle_mtx);
+    rate_limit_configure(limits[0], limits[1], limits[2]);
+}
+
+static gboolean signal_handler(gpointer loop) {
+    g_main_loop_quit((GMainLoop*)loop);
+    return G_SOURCE_REMOVE;
 }
 
 /* ---------- main ---------- */
 int main(void) {
 
-    FCGX_Request req;
     char* socket_path = NULL;
     int status;
     int sock;
     GError* error = NULL;
+    GMainLoop* loop = NULL;
 
     openlog(APP_NAME, LOG_PID | LOG_CONS, LOG_USER);
     syslog(LOG_INFO, "Starting %s FastCGI app", APP_NAME);
@@ -225,12 +609,20 @@ int main(void) {
 
     // Ensure parameters exist (string metadata)
     pthread_mutex_lock(&handle_mtx);
-    if (!add_if_missing("IpAddress", "192.168.0.90", "string"))
-        panic("Failed to add IpAddress");
-    if (!add_if_missing("Port", "8080", "string"))
-        panic("Failed to add Port");
+    for (size_t i = 0; i < G_N_ELEMENTS(params); i++) {
+        if (!add_if_missing(params[i].name, params[i].def, params[i].meta))
+            panic("Failed to add %s", params[i].name);
+    }
     pthread_mutex_unlock(&handle_mtx);
 
+    if (!param_cache_init(handle, &handle_mtx, cached_params, G_N_ELEMENTS(cached_params), render_info))
+        panic("Failed to set up parameter cache");
+
+    if (!route_table_init(routes, G_N_ELEMENTS(routes)))
+        panic("Failed to build route table");
+
+    init_limits();
+
     
     socket_path = getenv(FCGI_SOCKET_NAME);
     syslog(LOG_INFO, "Socket: %s\n", socket_path);
@@ -246,22 +638,42 @@ int main(void) {
         return status;
     }
 
-    sock = FCGX_OpenSocket(socket_path, 5);
+    sock = FCGX_OpenSocket(socket_path, SOCKET_BACKLOG);
     chmod(socket_path, S_IRWXU | S_IRWXG | S_IRWXO);
-    
-    status = FCGX_InitRequest(&req, sock, 0);
 
-    if(status != 0) {
-        panic("FCGX_InitRequest failed");
+    // Start the worker pool, every worker accepts on the same socket
+    num_workers = read_worker_count();
+    for (int i = 0; i < num_workers; i++) {
+        workers[i].index = i;
+        status = FCGX_InitRequest(&workers[i].req, sock, 0);
+        if (status != 0) {
+            panic("FCGX_InitRequest failed");
+        }
     }
-    syslog(LOG_INFO, "FCGX_InitRequest succeeded");
-
-    // Accept/handle loop
-    while (FCGX_Accept_r(&req) == 0) {
-        handle_request(&req);
-        FCGX_Finish_r(&req);
+    for (int i = 0; i < num_workers; i++) {
+        if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0)
+            panic("Failed to start worker %d", i);
     }
-
+    syslog(LOG_INFO, "Serving FastCGI requests with %d workers", num_workers);
+
+    // The main thread only runs the loop that delivers parameter callbacks
+    loop = g_main_loop_new(NULL, FALSE);
+    g_unix_signal_add(SIGTERM, signal_handler, loop);
+    g_unix_signal_add(SIGINT, signal_handler, loop);
+    g_main_loop_run(loop);
+
+    /*
+     * Stop the workers before freeing what they use. Shutting the listen
+     * socket down makes a blocked FCGX_Accept_r fail, and a worker in the
+     * middle of a request finishes it before it sees the shutdown.
+     */
+    FCGX_ShutdownPending();
+    shutdown(sock, SHUT_RDWR);
+    for (int i = 0; i < num_workers; i++) pthread_join(workers[i].thread, NULL);
+    syslog(LOG_INFO, "All workers stopped");
+
+    g_main_loop_unref(loop);
+    param_cache_cleanup();
     ax_parameter_free(handle);
     closelog();
     return 0;
@@ -8,6 +8,18 @@ export interface InfoResponse {
   [key: string]: unknown;
 }
 
+// Values of the SendData event, see event/send-events-types/send-data
+export interface LiveData {
+  Temperature: number;
+  Load: number;
+  UsedMemory: number;
+  FreeMemory: number;
+}
+
+export type PushMessage =
+  | { topic: 'param'; data: InfoResponse }
+  | { topic: 'data'; data: LiveData };
+
 @Injectable({ providedIn: 'root' })
 export class ApiService {
   private readonly BASE = '/local/web_proxy/api';
@@ -21,6 +33,21 @@ export class ApiService {
     });
   }
 
+  // One Server-Sent Events stream instead of polling getInfo()
+  events(): Observable<PushMessage> {
+    return new Observable<PushMessage>((subscriber) => {
+      const source = new EventSource(`${this.BASE}/events`, { withCredentials: true });
+
+      source.addEventListener('param', (e: MessageEvent<string>) =>
+        subscriber.next({ topic: 'param', data: JSON.parse(e.data) as InfoResponse }));
+      source.addEventListener('data', (e: MessageEvent<string>) =>
+        subscriber.next({ topic: 'data', data: JSON.parse(e.data) as LiveData }));
+
+      // EventSource reconnects by itself, closing it ends the stream
+      return () => source.close();
+    });
+  }
+
   setParam(body: { MulticastAddress: string; MulticastPort: string }) {
     return this.http.post(`${this.BASE}/param`, body, {
       headers: { 'Content-Type': 'application/json' },
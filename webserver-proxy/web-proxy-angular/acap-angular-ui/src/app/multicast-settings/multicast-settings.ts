@@ -1,9 +1,11 @@
-import { Component, OnInit } from '@angular/core';
+import { Component, OnDestroy, OnInit } from '@angular/core';
 import { CommonModule } from '@angular/common';
 import { FormsModule } from '@angular/forms';
 import { HttpErrorResponse } from '@angular/common/http';
 
-import { ApiService, InfoResponse, SaveResponse } from '../api';
+import { Subscription } from 'rxjs';
+
+import { ApiService, InfoResponse, LiveData, PushMessage, SaveResponse } from '../api';
 
 @Component({
   selector: 'app-multicast-settings',
@@ -12,18 +14,45 @@ import { ApiService, InfoResponse, SaveResponse } from '../api';
   templateUrl: './multicast-settings.html',
   styleUrls: ['./multicast-settings.css'],
 })
-export class MulticastSettingsComponent implements OnInit {
+export class MulticastSettingsComponent implements OnInit, OnDestroy {
   addr: string = '';
   port: string = '';
   out: unknown = {};
   loading: boolean = false;
   saving: boolean = false;
   error: string | null = null;
+  live: LiveData | null = null;
+
+  // Last values from the server, to avoid overwriting unsaved edits
+  private serverAddr: string = '';
+  private serverPort: string = '';
+  private events?: Subscription;
 
   constructor(private readonly api: ApiService) {}
 
   ngOnInit(): void {
     this.loadInfo();
+    this.events = this.api.events().subscribe({
+      next: (msg: PushMessage): void => this.onPush(msg),
+    });
+  }
+
+  ngOnDestroy(): void {
+    this.events?.unsubscribe();
+  }
+
+  private onPush(msg: PushMessage): void {
+    if (msg.topic === 'data') {
+      this.live = msg.data;
+      return;
+    }
+
+    const addr = typeof msg.data.MulticastAddress === 'string' ? msg.data.MulticastAddress : '';
+    const port = msg.data.MulticastPort != null ? String(msg.data.MulticastPort) : '';
+    if (this.addr === this.serverAddr) this.addr = addr;
+    if (this.port === this.serverPort) this.port = port;
+    this.serverAddr = addr;
+    this.serverPort = port;
   }
 
   loadInfo(): void {
@@ -36,10 +65,12 @@ export class MulticastSettingsComponent implements OnInit {
 
         if (typeof json.MulticastAddress === 'string' && json.MulticastAddress.trim().length > 0) {
           this.addr = json.MulticastAddress;
+          this.serverAddr = this.addr;
         }
 
         if (json.MulticastPort !== undefined && json.MulticastPort !== null) {
           this.port = String(json.MulticastPort);
+          this.serverPort = this.port;
         }
         
         this.loading = false;
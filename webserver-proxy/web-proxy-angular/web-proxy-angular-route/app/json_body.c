@@ -0,0 +1,100 @@
+/*
+ * Streaming JSON request bodies
+ *
+ * The body is not copied into a buffer sized from Content-Length. Instead
+ * json_load_callback pulls it from the connection in small pieces into the
+ * parser's own fixed buffer, so the only memory that grows with the request
+ * is the parsed tree, and the body size is capped before reading starts.
+ *
+ * A declared Content-Length is required. Chunked bodies have no length up
+ * front and are rejected with 411, as are requests without the header.
+ */
+#include "json_body.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <syslog.h>
+
+struct body_reader {
+    json_body_read_fn read;
+    void* conn;
+    size_t remaining;
+    bool failed;
+};
+
+static size_t read_callback(void* buffer, size_t buflen, void* data) {
+    struct body_reader* r = data;
+
+    if (r->remaining == 0) return 0;
+
+    int n = r->read(r->conn, buffer, buflen < r->remaining ? buflen : r->remaining);
+    if (n <= 0) {
+        // Connection closed or failed before Content-Length bytes arrived
+        r->failed = true;
+        return (size_t)-1;
+    }
+    r->remaining -= (size_t)n;
+    return (size_t)n;
+}
+
+/* Strict decimal, no sign, no trailing garbage */
+static bool parse_length(const char* s, size_t* out) {
+    char* end = NULL;
+    if (!s || *s < '0' || *s > '9') return false;
+    unsigned long long v = strtoull(s, &end, 10);
+    if (*end != '\0') return false;
+    *out = v > JSON_BODY_MAX ? JSON_BODY_MAX + 1 : (size_t)v;
+    return true;
+}
+
+/**
+ * Parse a JSON object or array from the request body.
+ *
+ * On failure NULL is returned with an HTTP status in status and a short
+ * reason in message: 411 without a usable Content-Length, 413 above
+ * JSON_BODY_MAX, 400 for empty, truncated or invalid bodies.
+ */
+json_t* json_body_load(json_body_read_fn read,
+                       void* conn,
+                       const char* content_length,
+                       const char* transfer_encoding,
+                       int* status,
+                       const char** message) {
+    struct body_reader r = {read, conn, 0, false};
+    json_error_t err;
+
+    if (transfer_encoding && strcasecmp(transfer_encoding, "identity") != 0) {
+        *status = 411;
+        *message = "Chunked request bodies are not supported, send Content-Length";
+        return NULL;
+    }
+    if (!parse_length(content_length, &r.remaining)) {
+        *status = 411;
+        *message = "Content-Length required";
+        return NULL;
+    }
+    if (r.remaining > JSON_BODY_MAX) {
+        *status = 413;
+        *message = "Request body too large";
+        return NULL;
+    }
+    if (r.remaining == 0) {
+        *status = 400;
+        *message = "Missing or empty body";
+        return NULL;
+    }
+
+    json_t* root = json_load_callback(read_callback, &r, JSON_REJECT_DUPLICATES, &err);
+    if (!root) {
+        *status = 400;
+        *message = r.failed ? "Truncated request body" : "Invalid JSON";
+        if (!r.failed) syslog(LOG_INFO, "JSON parse error: %s at line %d", err.text, err.line);
+        return NULL;
+    }
+
+    *status = 200;
+    *message = NULL;
+    return root;
+}
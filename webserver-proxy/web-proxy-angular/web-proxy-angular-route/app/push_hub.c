@@ -0,0 +1,260 @@
+/**
+ * Server-Sent Events push for the Angular examples
+ *
+ * Instead of every open UI polling /info, the UI keeps one EventSource open
+ * and the server pushes a frame when something changes. A publish formats
+ * the SSE frame once. Clients hold references to the same bytes.
+ *
+ * Every client has a bounded queue. A new frame replaces a pending frame of
+ * the same topic, so only the newest value of each topic waits. If the
+ * queue is still full the oldest frame is dropped. A client that reads
+ * slowly therefore sees fewer updates and never sees old ones.
+ *
+ * The newest frame of each topic is also kept for clients that connect
+ * later, so the first frames a client receives are the current state.
+ */
+#include "push_hub.h"
+
+#include <glib.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+
+#define QUEUE_LEN      16
+#define MAX_TOPICS     8
+#define TOPIC_LEN      16
+// Every client occupies one CivetWeb worker thread while connected
+#define MAX_CLIENTS    16
+#define HEARTBEAT_SEC  15
+
+struct frame {
+    atomic_int refs;
+    char topic[TOPIC_LEN];
+    size_t len;
+    char data[];  // "event: <topic>\ndata: <json>\n\n"
+};
+
+struct client {
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    struct frame* queue[QUEUE_LEN];
+    unsigned head;
+    unsigned count;
+    unsigned long dropped;
+    bool closed;
+};
+
+static pthread_mutex_t hub_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct client* clients[MAX_CLIENTS];
+static struct frame* latest[MAX_TOPICS];
+static bool shutting_down = false;
+
+static void frame_unref(struct frame* f) {
+    if (f && atomic_fetch_sub(&f->refs, 1) == 1) free(f);
+}
+
+static struct frame* frame_ref(struct frame* f) {
+    atomic_fetch_add(&f->refs, 1);
+    return f;
+}
+
+static struct frame* frame_new(const char* topic, const char* json) {
+    size_t len = (size_t)snprintf(NULL, 0, "event: %s\ndata: %s\n\n", topic, json);
+    struct frame* f = malloc(sizeof(*f) + len + 1);
+    if (!f) return NULL;
+
+    atomic_init(&f->refs, 1);
+    g_strlcpy(f->topic, topic, sizeof(f->topic));
+    f->len = len;
+    snprintf(f->data, len + 1, "event: %s\ndata: %s\n\n", topic, json);
+    return f;
+}
+
+/* Queue a reference to f, replacing a pending frame of the same topic */
+static void client_push(struct client* c, struct frame* f) {
+    pthread_mutex_lock(&c->mtx);
+
+    for (unsigned i = 0; i < c->count; i++) {
+        unsigned slot = (c->head + i) % QUEUE_LEN;
+        if (strcmp(c->queue[slot]->topic, f->topic) == 0) {
+            frame_unref(c->queue[slot]);
+            c->queue[slot] = frame_ref(f);
+            c->dropped++;
+            pthread_mutex_unlock(&c->mtx);
+            return;
+        }
+    }
+
+    if (c->count == QUEUE_LEN) {
+        frame_unref(c->queue[c->head]);
+        c->head = (c->head + 1) % QUEUE_LEN;
+        c->count--;
+        c->dropped++;
+    }
+    c->queue[(c->head + c->count) % QUEUE_LEN] = frame_ref(f);
+    c->count++;
+
+    pthread_cond_signal(&c->cond);
+    pthread_mutex_unlock(&c->mtx);
+}
+
+bool push_hub_init(void) {
+    pthread_mutex_lock(&hub_mtx);
+    shutting_down = false;
+    pthread_mutex_unlock(&hub_mtx);
+    return true;
+}
+
+/* Wake every client so its handler returns and CivetWeb can stop */
+void push_hub_shutdown(void) {
+    pthread_mutex_lock(&hub_mtx);
+    shutting_down = true;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        struct client* c = clients[i];
+        if (!c) continue;
+        pthread_mutex_lock(&c->mtx);
+        c->closed = true;
+        pthread_cond_signal(&c->cond);
+        pthread_mutex_unlock(&c->mtx);
+    }
+    for (int i = 0; i < MAX_TOPICS; i++) {
+        frame_unref(latest[i]);
+        latest[i] = NULL;
+    }
+    pthread_mutex_unlock(&hub_mtx);
+}
+
+void push_hub_publish(const char* topic, json_t* payload) {
+    char* json = json_dumps(payload, JSON_COMPACT);
+    struct frame* f = json ? frame_new(topic, json) : NULL;
+    free(json);
+    if (!f) return;
+
+    pthread_mutex_lock(&hub_mtx);
+
+    // Remember it for new clients, skip it if nothing changed
+    int slot = -1;
+    for (int i = 0; i < MAX_TOPICS; i++) {
+        if (latest[i] && strcmp(latest[i]->topic, f->topic) == 0) { slot = i; break; }
+        if (!latest[i] && slot < 0) slot = i;
+    }
+    if (slot >= 0 && latest[slot] && latest[slot]->len == f->len &&
+        memcmp(latest[slot]->data, f->data, f->len) == 0) {
+        pthread_mutex_unlock(&hub_mtx);
+        frame_unref(f);
+        return;
+    }
+    if (slot >= 0) {
+        frame_unref(latest[slot]);
+        latest[slot] = frame_ref(f);
+    }
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i]) client_push(clients[i], f);
+    }
+
+    pthread_mutex_unlock(&hub_mtx);
+    frame_unref(f);
+}
+
+static struct client* client_add(void) {
+    pthread_mutex_lock(&hub_mtx);
+
+    int slot = -1;
+    for (int i = 0; i < MAX_CLIENTS && !shutting_down; i++) {
+        if (!clients[i]) { slot = i; break; }
+    }
+    if (slot < 0) {
+        pthread_mutex_unlock(&hub_mtx);
+        return NULL;
+    }
+
+    struct client* c = g_new0(struct client, 1);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&c->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&c->mtx, NULL);
+
+    // Start with the current state of every topic
+    for (int i = 0; i < MAX_TOPICS; i++) {
+        if (latest[i]) client_push(c, latest[i]);
+    }
+    clients[slot] = c;
+
+    pthread_mutex_unlock(&hub_mtx);
+    return c;
+}
+
+static void client_remove(struct client* c) {
+    pthread_mutex_lock(&hub_mtx);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i] == c) clients[i] = NULL;
+    }
+    pthread_mutex_unlock(&hub_mtx);
+
+    for (unsigned i = 0; i < c->count; i++) frame_unref(c->queue[(c->head + i) % QUEUE_LEN]);
+    if (c->dropped) syslog(LOG_INFO, "SSE client left, %lu stale frames skipped", c->dropped);
+    pthread_cond_destroy(&c->cond);
+    pthread_mutex_destroy(&c->mtx);
+    g_free(c);
+}
+
+// GET /events
+int push_hub_sse_handler(struct mg_connection* conn, void* ud __attribute__((unused))) {
+    if (strcmp(mg_get_request_info(conn)->request_method, "GET") != 0) return 0;
+
+    struct client* c = client_add();
+    if (!c) {
+        mg_printf(conn, "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 10\r\nConnection: close\r\n\r\n");
+        return 1;
+    }
+
+    mg_printf(conn,
+              "HTTP/1.1 200 OK\r\n"
+              "Content-Type: text/event-stream\r\n"
+              "Cache-Control: no-cache\r\n"
+              "X-Accel-Buffering: no\r\n"
+              "Connection: close\r\n\r\n"
+              "retry: 3000\n\n");
+
+    struct frame* batch[QUEUE_LEN];
+    bool ok = true;
+
+    while (ok) {
+        unsigned n = 0;
+        bool closed;
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += HEARTBEAT_SEC;
+
+        pthread_mutex_lock(&c->mtx);
+        while (c->count == 0 && !c->closed) {
+            if (pthread_cond_timedwait(&c->cond, &c->mtx, &deadline) != 0) break;
+        }
+        // Take everything pending and write it without holding the lock
+        while (c->count > 0) {
+            batch[n++] = c->queue[c->head];
+            c->head = (c->head + 1) % QUEUE_LEN;
+            c->count--;
+        }
+        closed = c->closed;
+        pthread_mutex_unlock(&c->mtx);
+
+        for (unsigned i = 0; i < n; i++) {
+            if (ok && mg_write(conn, batch[i]->data, batch[i]->len) <= 0) ok = false;
+            frame_unref(batch[i]);
+        }
+        if (closed) break;
+        // Comment line, keeps proxies from closing an idle stream
+        if (ok && n == 0 && mg_write(conn, ":\n\n", 3) <= 0) ok = false;
+    }
+
+    client_remove(c);
+    return 1;
+}
@@ -2,6 +2,9 @@
  * CivetWeb reverse-proxy backend with AXParameter + Jansson
  */
 #include "civetweb.h"
+#include "json_body.h"
+#include "push_hub.h"
+#include <axsdk/axevent.h>
 #include <axsdk/axparameter.h>
 #include <jansson.h>
 #include <glib-unix.h>
@@ -16,7 +19,6 @@
 #define APP_NAME "web_proxy_angular_route"
 #define PORT     "2001"
 
-static volatile sig_atomic_t running = 1;
 static AXParameter* handle = NULL;
 
 /* ── helpers ─────────────────────────────────────────────────────────────── */
@@ -28,10 +30,10 @@ static void panic(const char* fmt, ...) {
     exit(EXIT_FAILURE);
 }
 
-static void on_signal(int signo) { 
+static gboolean on_signal(gpointer loop) {
 
-    (void)signo; 
-    running = 0; 
+    g_main_loop_quit((GMainLoop*)loop);
+    return G_SOURCE_REMOVE;
 }
 
 static void send_json(struct mg_connection* conn, int status, json_t* obj) {
@@ -51,26 +53,36 @@ static void send_json(struct mg_connection* conn, int status, json_t* obj) {
     free(body);
 }
 
-static char* read_body(struct mg_connection* conn) { 
+static int conn_read(void* conn, char* buf, size_t len) {
 
-    const char* len_str = mg_get_header(conn, "Content-Length");
-    long len = len_str ? strtol(len_str, NULL, 10) : 0;
+    return mg_read((struct mg_connection*)conn, buf, len);
+}
 
-    if (len <= 0 || len > (1<<20)) 
-        return NULL;
+// Parse the body as a JSON object, or answer the request and return NULL
+static json_t* read_json_body(struct mg_connection* conn) {
 
-    char* buf = (char*)malloc((size_t)len + 1);
+    int status = 400;
+    const char* message = NULL;
 
-    if (!buf) 
-        return NULL;
+    json_t* root = json_body_load(conn_read, conn,
+                                  mg_get_header(conn, "Content-Length"),
+                                  mg_get_header(conn, "Transfer-Encoding"),
+                                  &status, &message);
 
-    long got = mg_read(conn, buf, (size_t)len);
+    if (root && !json_is_object(root)) {
+        json_decref(root);
+        root = NULL;
+        status = 400;
+        message = "Expected a JSON object";
+    }
 
-    if (got < 0) 
-        got = 0;
+    if (!root) {
+        json_t* error = json_pack("{s:s}", "error", message);
+        send_json(conn, status, error);
+        json_decref(error);
+    }
 
-    buf[got] = '\0';
-    return buf;
+    return root;
 }
 
 
@@ -104,6 +116,80 @@ static gboolean set_param(const char* name, const char* value) {
     return ok;
 }
 
+/* --- Push sources --- */
+
+// Current multicast settings as one "param" frame
+static void publish_params(void) {
+
+    char* addr = get_param("MulticastAddress");
+    char* port = get_param("MulticastPort");
+
+    json_t* out = json_object();
+    json_object_set_new(out, "MulticastAddress", addr ? json_string(addr) : json_null());
+    json_object_set_new(out, "MulticastPort",   port ? json_string(port) : json_null());
+    push_hub_publish("param", out);
+    json_decref(out);
+
+    g_free(addr);
+    g_free(port);
+}
+
+static void on_param_changed(const gchar* name, const gchar* value, gpointer data) {
+
+    (void)name;
+    (void)value;
+    (void)data;
+    publish_params();
+}
+
+// tnsaxis:CameraApplicationPlatform/SendData/SendDataEvent from the send_data example
+static void on_send_data_event(guint subscription, AXEvent* event, gpointer data) {
+
+    const AXEventKeyValueSet* kvs = ax_event_get_key_value_set(event);
+    gdouble temperature = 0.0;
+    gdouble load = 0.0;
+    gint used_memory = 0;
+    gint free_memory = 0;
+
+    (void)subscription;
+    (void)data;
+
+    ax_event_key_value_set_get_double(kvs, "Temperature", NULL, &temperature, NULL);
+    ax_event_key_value_set_get_double(kvs, "Load", NULL, &load, NULL);
+    ax_event_key_value_set_get_integer(kvs, "UsedMemory", NULL, &used_memory, NULL);
+    ax_event_key_value_set_get_integer(kvs, "FreeMemory", NULL, &free_memory, NULL);
+
+    json_t* out = json_pack("{s:f,s:f,s:i,s:i}",
+                            "Temperature", temperature,
+                            "Load", load,
+                            "UsedMemory", used_memory,
+                            "FreeMemory", free_memory);
+    push_hub_publish("data", out);
+    json_decref(out);
+
+    ax_event_free(event);
+}
+
+static guint subscribe_send_data(AXEventHandler* event_handler) {
+
+    AXEventKeyValueSet* kvs = ax_event_key_value_set_new();
+    guint subscription = 0;
+    GError* error = NULL;
+
+    ax_event_key_value_set_add_key_value(kvs, "topic0", "tnsaxis", "CameraApplicationPlatform", AX_VALUE_TYPE_STRING, NULL);
+    ax_event_key_value_set_add_key_value(kvs, "topic1", "tnsaxis", "SendData", AX_VALUE_TYPE_STRING, NULL);
+    ax_event_key_value_set_add_key_value(kvs, "topic2", "tnsaxis", "SendDataEvent", AX_VALUE_TYPE_STRING, NULL);
+
+    if (!ax_event_handler_subscribe(event_handler, kvs, &subscription,
+                                    (AXSubscriptionCallback)on_send_data_event, NULL, &error)) {
+        syslog(LOG_WARNING, "SendData subscription failed: %s", error ? error->message : "unknown");
+        g_clear_error(&error);
+    }
+
+    ax_event_key_value_set_free(kvs);
+    return subscription;
+}
+
 /* --- Handlers --- */
 
 // GET /info
@@ -135,31 +221,8 @@ static int ParamHandler(struct mg_connection* conn, void* ud __attribute__((unus
     if (strcmp(mg_get_request_info(conn)->request_method, "POST") != 0) 
         return 0;
 
-    char* body = read_body(conn);
-    if (!body) {
-
-        json_t* error = json_pack("{s:s}", "error", "Missing or empty body");
-
-        send_json(conn, 400, error);
-        json_decref(error);
-        return 1;
-    }
-
-    json_error_t jerror;
-    json_t* root = json_loads(body, 0, &jerror);
-    free(body);
-
-    if (!root || !json_is_object(root)) {
-        if (root) 
-            json_decref(root);
-
-        json_t* error = json_pack("{s:s}", "error", "Invalid JSON");
-        send_json(conn, 400, error);
-
-        json_decref(error);
-
-        return 1;
-    }
+    json_t* root = read_json_body(conn);
+    if (!root) return 1;
 
     const json_t* jAddr = json_object_get(root, "MulticastAddress");
     const json_t* jPort = json_object_get(root, "MulticastPort");
@@ -168,6 +231,10 @@ static int ParamHandler(struct mg_connection* conn, void* ud __attribute__((unus
     if (jAddr && json_is_string(jAddr)) changed |= set_param("MulticastAddress", json_string_value(jAddr));
     if (jPort && json_is_string(jPort)) changed |= set_param("MulticastPort",   json_string_value(jPort));
 
+    // Push to every open UI, the hub skips it if nothing changed
+    if (changed)
+        publish_params();
+
     json_t* res = json_object();
     json_object_set_new(res, "ok", json_true());
     json_object_set_new(res, "changed", changed ? json_true() : json_false());
@@ -216,9 +283,6 @@ int main(void) {
     openlog(APP_NAME, LOG_PID, LOG_USER);
     syslog(LOG_INFO, "Starting %s (CivetWeb single-threaded)", APP_NAME);
 
-    signal(SIGTERM, on_signal);
-    signal(SIGINT,  on_signal);
-
     // Init AXParameter
     GError* error = NULL;
     handle = ax_parameter_new(APP_NAME, &error);
@@ -226,6 +290,14 @@ int main(void) {
     if (!handle) 
         panic("ax_parameter_new failed: %s", error ? error->message : "unknown");
 
+    // Push sources: parameter callbacks and the send_data event
+    push_hub_init();
+    publish_params();
+    ax_parameter_register_callback(handle, "MulticastAddress", on_param_changed, NULL, NULL);
+    ax_parameter_register_callback(handle, "MulticastPort",    on_param_changed, NULL, NULL);
+
+    AXEventHandler* event_handler = ax_event_handler_new();
+    guint subscription = subscribe_send_data(event_handler);
 
     // Start CivetWeb in single-threaded mode
     const char* opts[] = {"listening_ports", PORT, "request_timeout_ms", "10000", "error_log_file", "error.log", 0};
@@ -247,11 +319,20 @@ int main(void) {
     mg_set_request_handler(ctx, "/", RootHandler,  NULL);
     mg_set_request_handler(ctx, "/local/web_proxy/api/info",  InfoHandler,  NULL);
     mg_set_request_handler(ctx, "/local/web_proxy/api/param",  ParamHandler,  NULL);
+    mg_set_request_handler(ctx, "/local/web_proxy/api/events", push_hub_sse_handler, NULL);
 
-    while (running) 
-        sleep(1);
+    // Parameter callbacks and events are delivered by the main loop
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    g_unix_signal_add(SIGTERM, on_signal, loop);
+    g_unix_signal_add(SIGINT,  on_signal, loop);
+    g_main_loop_run(loop);
 
+    // Release the SSE handlers first, mg_stop waits for them
+    push_hub_shutdown();
     mg_stop(ctx);
+    g_main_loop_unref(loop);
+    ax_event_handler_unsubscribe(event_handler, subscription, NULL);
+    ax_event_handler_free(event_handler);
     ax_parameter_free(handle);
     closelog();
     return EXIT_SUCCESS;
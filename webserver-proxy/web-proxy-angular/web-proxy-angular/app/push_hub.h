@@ -0,0 +1,20 @@
+#pragma once
+
+#include "civetweb.h"
+#include <jansson.h>
+#include <stdbool.h>
+
+/*
+ * Server-Sent Events fan-out. Every publish is serialized once and shared by
+ * all connected clients. Each client has a small queue that keeps only the
+ * newest pending frame per topic, so a slow client skips stale values
+ * instead of falling behind.
+ */
+bool push_hub_init(void);
+void push_hub_shutdown(void);
+
+// Publish payload under topic, e.g. "param". The payload is not stolen.
+void push_hub_publish(const char* topic, json_t* payload);
+
+// mg_request_handler for the events endpoint
+int push_hub_sse_handler(struct mg_connection* conn, void* user_data);
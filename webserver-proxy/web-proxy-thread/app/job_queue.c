@@ -0,0 +1,178 @@
+/**
+ * Job queue for slow request work
+ *
+ * Jobs get increasing ids and live in a fixed ring, slot id % MAX_JOBS. The
+ * job thread runs them strictly in id order. A slot is only reused once its
+ * job is done, so a result stays available until MAX_JOBS newer jobs have
+ * been submitted. If the slot for the next id still holds an unfinished job
+ * the queue is full and the submit fails, which bounds the backlog.
+ *
+ * One thread runs all jobs, so parameter writes are serialized and never
+ * occupy more than one thread, however many requests arrive.
+ */
+#include "job_queue.h"
+
+#include <pthread.h>
+#include <syslog.h>
+#include <time.h>
+
+#define MAX_JOBS 32
+
+struct job {
+    unsigned long id;  // 0 for a slot never used
+    enum job_state state;
+    job_func fn;
+    void* arg;
+    GDestroyNotify free_arg;
+    int status;
+    json_t* result;
+};
+
+static struct job jobs[MAX_JOBS];
+static unsigned long next_id = 1;   // id of the next submitted job
+static unsigned long next_run = 1;  // id of the next job to run
+static bool running = false;
+static bool stopping = false;
+
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queued_cond;
+static pthread_cond_t done_cond;  // CLOCK_MONOTONIC, for job_queue_wait
+static pthread_t thread;
+
+static struct job* slot_of(unsigned long id) {
+    struct job* job = &jobs[id % MAX_JOBS];
+    return job->id == id ? job : NULL;
+}
+
+static void* job_thread(void* unused) {
+    (void)unused;
+    pthread_mutex_lock(&mtx);
+
+    for (;;) {
+        while (next_run == next_id && !stopping) pthread_cond_wait(&queued_cond, &mtx);
+        if (next_run == next_id) break;  // stopping and nothing left
+
+        struct job* job = slot_of(next_run);
+        job->state = JOB_RUNNING;
+        job_func fn = job->fn;
+        void* arg = job->arg;
+        GDestroyNotify free_arg = job->free_arg;
+        pthread_mutex_unlock(&mtx);
+
+        int status = 500;
+        json_t* result = fn(arg, &status);
+        if (free_arg) free_arg(arg);
+
+        pthread_mutex_lock(&mtx);
+        job->arg = NULL;
+        job->result = result;
+        job->status = status;
+        job->state = JOB_DONE;
+        next_run++;
+        pthread_cond_broadcast(&done_cond);
+    }
+
+    pthread_mutex_unlock(&mtx);
+    return NULL;
+}
+
+bool job_queue_start(void) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&done_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&queued_cond, NULL);
+
+    stopping = false;
+    if (pthread_create(&thread, NULL, job_thread, NULL) != 0) {
+        syslog(LOG_ERR, "job queue: failed to start job thread");
+        return false;
+    }
+    running = true;
+    return true;
+}
+
+void job_queue_stop(void) {
+    if (!running) return;
+
+    pthread_mutex_lock(&mtx);
+    stopping = true;
+    pthread_cond_signal(&queued_cond);
+    pthread_mutex_unlock(&mtx);
+    pthread_join(thread, NULL);
+    running = false;
+
+    for (size_t i = 0; i < MAX_JOBS; i++) {
+        if (jobs[i].result) json_decref(jobs[i].result);
+        jobs[i].result = NULL;
+    }
+    pthread_cond_destroy(&queued_cond);
+    pthread_cond_destroy(&done_cond);
+}
+
+unsigned long job_queue_submit(job_func fn, void* arg, GDestroyNotify free_arg) {
+    pthread_mutex_lock(&mtx);
+
+    struct job* job = &jobs[next_id % MAX_JOBS];
+    if (!running || stopping || (job->id != 0 && job->state != JOB_DONE)) {
+        pthread_mutex_unlock(&mtx);
+        return 0;
+    }
+
+    if (job->result) json_decref(job->result);
+    *job = (struct job){
+        .id = next_id++,
+        .state = JOB_QUEUED,
+        .fn = fn,
+        .arg = arg,
+        .free_arg = free_arg,
+    };
+    unsigned long id = job->id;
+
+    pthread_cond_signal(&queued_cond);
+    pthread_mutex_unlock(&mtx);
+    return id;
+}
+
+enum job_state job_queue_wait(unsigned long id, unsigned timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&mtx);
+    struct job* job = slot_of(id);
+    while (job && job->state != JOB_DONE) {
+        if (pthread_cond_timedwait(&done_cond, &mtx, &deadline) != 0) break;
+        job = slot_of(id);
+    }
+    enum job_state state = job ? job->state : JOB_UNKNOWN;
+    pthread_mutex_unlock(&mtx);
+    return state;
+}
+
+enum job_state job_queue_result(unsigned long id, int* status, json_t** result) {
+    pthread_mutex_lock(&mtx);
+    struct job* job = slot_of(id);
+    enum job_state state = job ? job->state : JOB_UNKNOWN;
+    if (state == JOB_DONE) {
+        *status = job->status;
+        *result = job->result ? json_incref(job->result) : json_object();
+    }
+    pthread_mutex_unlock(&mtx);
+    return state;
+}
+
+const char* job_state_name(enum job_state state) {
+    switch (state) {
+    case JOB_QUEUED:  return "queued";
+    case JOB_RUNNING: return "running";
+    case JOB_DONE:    return "done";
+    default:          return "unknown";
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glib.h>
+#include <jansson.h>
+#include <stdbool.h>
+
+/*
+ * Slow work, like parameter writes over D-Bus, runs on one dedicated job
+ * thread instead of the CivetWeb worker that received the request. The
+ * worker gets a job id back and can wait a bounded time for the result or
+ * answer 202 and let the client poll.
+ */
+enum job_state { JOB_UNKNOWN, JOB_QUEUED, JOB_RUNNING, JOB_DONE };
+
+/*
+ * Runs on the job thread. Returns the response body (a new reference) and
+ * sets status to the HTTP status that goes with it.
+ */
+typedef json_t* (*job_func)(void* arg, int* status);
+
+bool job_queue_start(void);
+// Finishes the jobs already queued, then stops the job thread
+void job_queue_stop(void);
+
+// Returns the job id, or 0 if the queue is full. arg is freed with free_arg.
+unsigned long job_queue_submit(job_func fn, void* arg, GDestroyNotify free_arg);
+
+// Wait up to timeout_ms for the job to finish. Returns the job state.
+enum job_state job_queue_wait(unsigned long id, unsigned timeout_ms);
+
+/*
+ * State of a job. When it is JOB_DONE, status and result (a new reference)
+ * are set. Finished jobs are forgotten once their slot is reused.
+ */
+enum job_state job_queue_result(unsigned long id, int* status, json_t** result);
+
+const char* job_state_name(enum job_state state);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <jansson.h>
+#include <stddef.h>
+
+// Largest request body accepted, the JSON APIs only take a few parameters
+#define JSON_BODY_MAX (16 * 1024)
+
+/*
+ * Reads up to len bytes of the request body. Returns the number of bytes
+ * read, 0 at the end of the body or a negative value on error.
+ */
+typedef int (*json_body_read_fn)(void* conn, char* buf, size_t len);
+
+json_t* json_body_load(json_body_read_fn read,
+                       void* conn,
+                       const char* content_length,
+                       const char* transfer_encoding,
+                       int* status,
+                       const char** message);
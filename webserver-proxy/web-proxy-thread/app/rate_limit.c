@@ -0,0 +1,133 @@
+/*
+ * Token bucket rate limiting and an in-flight cap
+ *
+ * Buckets live in a fixed table keyed by a 64-bit hash of client and route.
+ * The table is split into stripes with one mutex each, so workers handling
+ * different clients rarely wait for each other. A key is looked up in a few
+ * slots of its stripe. When they are all taken, the bucket that was used
+ * least recently is reused. A bucket idle for burst / rate seconds is full
+ * anyway, so reusing it only forgets a client that had nothing to forget.
+ *
+ * Memory does not grow with the number of clients, so a scan over many
+ * source addresses cannot exhaust it.
+ */
+#include "rate_limit.h"
+
+#include <glib.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define NUM_STRIPES 16
+#define SLOTS_PER_STRIPE 64
+#define PROBE_LEN 8
+
+struct bucket {
+    uint64_t key;  // 0 for an unused slot
+    double tokens;
+    gint64 last_usec;
+};
+
+struct stripe {
+    pthread_mutex_t mtx;
+    struct bucket slots[SLOTS_PER_STRIPE];
+};
+
+static struct stripe stripes[NUM_STRIPES] = {
+    [0 ... NUM_STRIPES - 1] = {.mtx = PTHREAD_MUTEX_INITIALIZER},
+};
+
+static atomic_uint cfg_rate = 0;
+static atomic_uint cfg_burst = 1;
+static atomic_uint cfg_max_in_flight = 0;
+
+static atomic_uint in_flight = 0;
+static atomic_ulong throttled_total = 0;
+static atomic_ulong busy_total = 0;
+
+void rate_limit_configure(unsigned rate, unsigned burst, unsigned max_in_flight) {
+    atomic_store(&cfg_rate, rate);
+    atomic_store(&cfg_burst, burst > 0 ? burst : 1);
+    atomic_store(&cfg_max_in_flight, max_in_flight);
+}
+
+static uint64_t bucket_key(const char* client, const char* route) {
+    uint64_t h = 14695981039346656037ull;
+    for (const char* p = client; *p; p++) h = (h ^ (unsigned char)*p) * 1099511628211ull;
+    h = (h ^ 0xff) * 1099511628211ull;  // separator, "a"+"bc" != "ab"+"c"
+    for (const char* p = route; *p; p++) h = (h ^ (unsigned char)*p) * 1099511628211ull;
+    return h ? h : 1;
+}
+
+/* Take one token from the bucket of key, or tell how long until there is one */
+static gboolean take_token(uint64_t key, unsigned rate, unsigned burst, unsigned* retry_after) {
+    struct stripe* s = &stripes[key % NUM_STRIPES];
+    size_t start = (size_t)(key >> 32) % SLOTS_PER_STRIPE;
+    gint64 now = g_get_monotonic_time();
+    gboolean ok = TRUE;
+
+    pthread_mutex_lock(&s->mtx);
+
+    struct bucket* b = NULL;
+    struct bucket* oldest = NULL;
+    for (size_t i = 0; i < PROBE_LEN; i++) {
+        struct bucket* slot = &s->slots[(start + i) % SLOTS_PER_STRIPE];
+        if (slot->key == key) { b = slot; break; }
+        if (!oldest || slot->key == 0 || (oldest->key != 0 && slot->last_usec < oldest->last_usec)) oldest = slot;
+    }
+
+    if (!b) {
+        b = oldest;
+        b->key = key;
+        b->tokens = burst;
+    } else {
+        double elapsed = (double)(now - b->last_usec) / 1e6;
+        b->tokens += elapsed * rate;
+        if (b->tokens > burst) b->tokens = burst;
+    }
+    b->last_usec = now;
+
+    if (b->tokens >= 1.0) {
+        b->tokens -= 1.0;
+    } else {
+        // Whole seconds until the next token, at least one
+        double wait = (1.0 - b->tokens) / rate;
+        *retry_after = wait > 1.0 ? (unsigned)(wait + 0.999) : 1;
+        ok = FALSE;
+    }
+
+    pthread_mutex_unlock(&s->mtx);
+    return ok;
+}
+
+enum rate_limit_verdict rate_limit_admit(const char* client, const char* route, unsigned* retry_after) {
+    unsigned max = atomic_load(&cfg_max_in_flight);
+    unsigned rate = atomic_load(&cfg_rate);
+
+    *retry_after = 1;
+
+    // The cap first, a rejected request should not cost the client a token
+    if (atomic_fetch_add(&in_flight, 1) >= max && max > 0) {
+        atomic_fetch_sub(&in_flight, 1);
+        atomic_fetch_add(&busy_total, 1);
+        return RATE_LIMIT_BUSY;
+    }
+
+    if (rate > 0 && !take_token(bucket_key(client ? client : "", route ? route : ""), rate,
+                                atomic_load(&cfg_burst), retry_after)) {
+        atomic_fetch_sub(&in_flight, 1);
+        atomic_fetch_add(&throttled_total, 1);
+        return RATE_LIMIT_THROTTLED;
+    }
+
+    return RATE_LIMIT_ADMIT;
+}
+
+void rate_limit_release(void) {
+    atomic_fetch_sub(&in_flight, 1);
+}
+
+void rate_limit_counters(unsigned long* throttled, unsigned long* busy) {
+    *throttled = atomic_load(&throttled_total);
+    *busy = atomic_load(&busy_total);
+}
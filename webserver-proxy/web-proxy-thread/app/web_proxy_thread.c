@@ -2,6 +2,7 @@
  * Reverse-proxy web server with JSON endpoints using CivetWeb + AXParameter + Jansson
  */
 #include "civetweb.h"
+#include "json_body.h"
 #include <axsdk/axparameter.h>
 #include <glib-unix.h>
 #include <jansson.h>
@@ -15,18 +16,59 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "param_batch.h"
+#include "job_queue.h"
+#include "param_cache.h"
+#include "rate_limit.h"
+
 #define APP_NAME "web_proxy_thread"
 #define PORT     "2002"
 
+// Idle time a kept-alive connection waits for the next request
+#define KEEP_ALIVE_TIMEOUT_MS "5000"
+
+// How long a write request waits for its job before answering 202, ?wait= overrides
+#define JOB_WAIT_MS     2000
+#define JOB_MAX_WAIT_MS 10000
+#define JOBS_PATH       "/local/" APP_NAME "/api/jobs"
+
+#define INFO_PATH  "/local/" APP_NAME "/api/info"
+#define PARAM_PATH "/local/" APP_NAME "/api/param"
+#define BATCH_PATH "/local/" APP_NAME "/api/batch"
+
 // Reverse-proxied paths (camera side): /local/my_web_server/...
 // Backend (this server) receives just the suffix path, so we register handlers for:
 //   /info-acap.cgi   (GET)
 //   /param-acap.cgi  (POST)
 
-static volatile sig_atomic_t running = 1;
 static AXParameter* g_param = NULL;
 static pthread_mutex_t g_param_mtx = PTHREAD_MUTEX_INITIALIZER;
 
+// Every parameter of the app, kept in sync with manifest.json paramConfig
+static const struct param_decl g_params[] = {
+    {"MulticastAddress", "224.0.0.1", "string"},
+    {"MulticastPort",    "1024",      "string"},
+    // CivetWeb options, read once at startup
+    {"KeepAlive",        "yes",       "bool:no,yes"},
+    {"NumThreads",       "4",         "int:min=1;max=32"},
+    {"RequestTimeoutMs", "10000",     "int:min=1000;max=60000"},
+    // Admission control for /api/, applied as soon as they change
+    {"RateLimit",        "10",        "int:min=0;max=1000"},
+    {"RateBurst",        "20",        "int:min=1;max=1000"},
+    {"MaxInFlight",      "3",         "int:min=0;max=32"},
+};
+
+// Parameters served by InfoHandler, read from param_cache
+static const char* const g_cached_params[] = {"MulticastAddress", "MulticastPort"};
+
+static const char* const g_limit_params[] = {"RateLimit", "RateBurst", "MaxInFlight"};
+static unsigned g_limits[G_N_ELEMENTS(g_limit_params)];
+// Guards g_limits, so a batch and the change callbacks it triggers configure once
+static pthread_mutex_t g_limits_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+// Set by BeginRequest when the request holds an in-flight slot
+static __thread bool t_admitted = false;
+
 /* ---------- helpers ---------- */
 __attribute__((noreturn)) __attribute__((format(printf,1,2)))
 static void panic(const char* fmt, ...) {
@@ -35,7 +77,10 @@ static void panic(const char* fmt, ...) {
     exit(EXIT_FAILURE);
 }
 
-static void on_signal(int signo) { (void)signo; running = 0; }
+static gboolean on_signal(gpointer loop) {
+    g_main_loop_quit((GMainLoop*)loop);
+    return G_SOURCE_REMOVE;
+}
 
 /* ---------- AXParameter helpers (thread-safe) ---------- */
 static gboolean add_if_missing(const char* name, const char* def, const char* meta) {
@@ -51,16 +96,6 @@ static gboolean add_if_missing(const char* name, const char* def, const char* me
     return TRUE;
 }
 
-static char* get_param_dup(const char* name) {
-    GError* err = NULL;
-    char* out = NULL;
-    if (!ax_parameter_get(g_param, name, &out, &err)) {
-        if (err) { syslog(LOG_WARNING, "get(%s) failed: %s", name, err->message); g_error_free(err); }
-        return NULL;
-    }
-    return out; // must g_free by caller
-}
-
 static gboolean set_param(const char* name, const char* value) {
     GError* err = NULL;
     gboolean ok = ax_parameter_set(g_param, name, value, FALSE, &err);
@@ -72,56 +107,317 @@ static gboolean set_param(const char* name, const char* value) {
 }
 
 /* ---------- HTTP helpers ---------- */
+/*
+ * Responses carry Content-Length and no Connection: close, so the reverse
+ * proxy can reuse the connection for the next request.
+ */
 static void send_json(struct mg_connection* c, int status, json_t* obj) {
     char* body = json_dumps(obj, JSON_COMPACT);
+    const char* out = body ? body : "{}";
+    size_t len = strlen(out);
+
     mg_printf(c,
               "HTTP/1.1 %d OK\r\n"
               "Content-Type: application/json\r\n"
+              "Content-Length: %zu\r\n"
               "Cache-Control: no-store\r\n"
               "Access-Control-Allow-Origin: *\r\n"
-              "Access-Control-Allow-Headers: content-type\r\n"
-              "Connection: close\r\n\r\n"
-              "%s",
-              status, body ? body : "{}");
+              "Access-Control-Allow-Headers: content-type\r\n\r\n",
+              status, len);
+    mg_write(c, out, len);
     free(body);
 }
 
-static char* read_body(struct mg_connection* c) {
-    const char* len_str = mg_get_header(c, "Content-Length");
-    long len = len_str ? strtol(len_str, NULL, 10) : 0;
-    if (len <= 0 || len > (1<<20)) return NULL;
+// Answer from the pre-rendered snapshot body, 304 if the client has it
+static void send_cached(struct mg_connection* c, const struct param_snapshot* snap) {
+    if (param_snapshot_etag_matches(snap, mg_get_header(c, "If-None-Match"))) {
+        mg_printf(c,
+                  "HTTP/1.1 304 Not Modified\r\n"
+                  "ETag: %s\r\n"
+                  "Cache-Control: no-cache\r\n"
+                  "Access-Control-Allow-Origin: *\r\n\r\n",
+                  snap->etag);
+        return;
+    }
+
+    mg_printf(c,
+              "HTTP/1.1 200 OK\r\n"
+              "Content-Type: application/json\r\n"
+              "Content-Length: %zu\r\n"
+              "ETag: %s\r\n"
+              "Cache-Control: no-cache\r\n"
+              "Access-Control-Allow-Origin: *\r\n"
+              "Access-Control-Allow-Headers: content-type\r\n\r\n",
+              snap->body_len, snap->etag);
+    mg_write(c, snap->body, snap->body_len);
+}
+
+static int conn_read(void* conn, char* buf, size_t len) {
+    return mg_read((struct mg_connection*)conn, buf, len);
+}
+
+// Parse the body as a JSON object, or answer the request and return NULL
+static json_t* read_json_body(struct mg_connection* c) {
+    int status = 400;
+    const char* message = NULL;
+    json_t* root = json_body_load(conn_read, c,
+                                  mg_get_header(c, "Content-Length"),
+                                  mg_get_header(c, "Transfer-Encoding"),
+                                  &status, &message);
+    if (root && !json_is_object(root)) {
+        json_decref(root);
+        root = NULL;
+        status = 400;
+        message = "Expected a JSON object";
+    }
+    if (!root) {
+        json_t* err = json_pack("{s:s}", "error", message);
+        send_json(c, status, err);
+        json_decref(err);
+    }
+    return root;
+}
+
+/* ---------- Admission control ---------- */
 
-    char* buf = (char*)malloc((size_t)len + 1);
-    if (!buf) return NULL;
+// Behind the device's reverse proxy the peer is loopback, the proxy appends the client
+static const char* client_addr(const struct mg_connection* c, char* buf, size_t len) {
+    const char* peer = mg_get_request_info(c)->remote_addr;
+    const char* xff = mg_get_header(c, "X-Forwarded-For");
+    if (!xff || (strcmp(peer, "127.0.0.1") != 0 && strcmp(peer, "::1") != 0)) return peer;
 
-    long got = mg_read(c, buf, (size_t)len);
-    if (got < 0) got = 0;
-    buf[got] = '\0';
+    const char* last = strrchr(xff, ',');
+    last = last ? last + 1 : xff;
+    while (*last == ' ') last++;
+    g_strlcpy(buf, last, len);
     return buf;
 }
 
+/*
+ * Rate limit buckets are keyed on the label of the handler a request reaches.
+ * CivetWeb handlers also match every path below their own, so keying on the
+ * request path would give /api/info/1, /api/info/2, ... a bucket each.
+ */
+static const struct {
+    const char* path;
+    const char* label;
+} g_api_routes[] = {
+    {INFO_PATH,  "info"},
+    {PARAM_PATH, "param"},
+    {BATCH_PATH, "batch"},
+    {JOBS_PATH,  "jobs"},
+};
+
+// The same prefix match CivetWeb uses, API paths no handler owns share one label
+static const char* api_route_label(const char* uri) {
+    for (size_t i = 0; i < G_N_ELEMENTS(g_api_routes); i++) {
+        size_t len = strlen(g_api_routes[i].path);
+        if (strncmp(uri, g_api_routes[i].path, len) == 0 && (uri[len] == '\0' || uri[len] == '/'))
+            return g_api_routes[i].label;
+    }
+    return "other";
+}
+
+// CivetWeb begin_request: reject over-limit API calls before any handler runs
+static int BeginRequest(struct mg_connection* c) {
+    const char* uri = mg_get_request_info(c)->local_uri;
+    if (!strstr(uri, "/api/")) return 0;  // only the API is limited
+
+    char buf[64];
+    unsigned retry_after = 0;
+    enum rate_limit_verdict verdict = rate_limit_admit(client_addr(c, buf, sizeof(buf)), api_route_label(uri), &retry_after);
+    if (verdict == RATE_LIMIT_ADMIT) {
+        t_admitted = true;
+        return 0;
+    }
+
+    int status = verdict == RATE_LIMIT_BUSY ? 503 : 429;
+    const char* body = verdict == RATE_LIMIT_BUSY ? "{\"error\":\"Server busy\"}" : "{\"error\":\"Too many requests\"}";
+    mg_printf(c,
+              "HTTP/1.1 %d %s\r\n"
+              "Content-Type: application/json\r\n"
+              "Content-Length: %zu\r\n"
+              "Retry-After: %u\r\n"
+              "Cache-Control: no-store\r\n\r\n%s",
+              status, status == 503 ? "Service Unavailable" : "Too Many Requests",
+              strlen(body), retry_after, body);
+    return status;
+}
+
+static void EndRequest(const struct mg_connection* c __attribute__((unused)), int status __attribute__((unused))) {
+    if (t_admitted) rate_limit_release();
+    t_admitted = false;
+}
+
+// Take the admission limits from names/values, reconfigure only if one changed. Caller holds g_limits_mtx
+static void update_limits(const char* const* names, const char* const* values, size_t n) {
+    bool changed = false;
+    for (size_t i = 0; i < G_N_ELEMENTS(g_limit_params); i++) {
+        for (size_t j = 0; j < n; j++) {
+            if (strcmp(names[j], g_limit_params[i]) != 0) continue;
+            unsigned limit = (unsigned)atoi(values[j]);
+            changed |= limit != g_limits[i];
+            g_limits[i] = limit;
+        }
+    }
+    if (!changed) return;
+    rate_limit_configure(g_limits[0], g_limits[1], g_limits[2]);
+    syslog(LOG_INFO, "Rate limit %u/s, burst %u, max in flight %u", g_limits[0], g_limits[1], g_limits[2]);
+}
+
+static void OnLimitChanged(const gchar* name, const gchar* value, gpointer data __attribute__((unused))) {
+    const char* dot = strrchr(name, '.');
+    const char* short_name = dot ? dot + 1 : name;
+    pthread_mutex_lock(&g_limits_mtx);
+    update_limits(&short_name, &value, 1);
+    pthread_mutex_unlock(&g_limits_mtx);
+}
+
 /* ---------- Handlers ---------- */
 
+// param_cache renderer, runs once per parameter change
+static char* RenderInfo(const struct param_snapshot* snap) {
+    json_t* out = json_object();
+    for (size_t i = 0; i < snap->count; i++)
+        json_object_set_new(out, snap->names[i], snap->values[i] ? json_string(snap->values[i]) : json_null());
+    json_object_set_new(out, "version", json_integer((json_int_t)snap->version));
+    json_object_set_new(out, "ok", json_true());
+    char* body = json_dumps(out, JSON_COMPACT);
+    json_decref(out);
+    return body;
+}
+
 // GET /info-acap.cgi
 static int InfoHandler(struct mg_connection* c, void* ud __attribute__((unused))) {
     if (strcmp(mg_get_request_info(c)->request_method, "GET") != 0) return 0;
 
-    json_t* out = json_object();
+    // Lock-free snapshot, no round trip to the parameter service
+    unsigned token;
+    const struct param_snapshot* snap = param_cache_read_lock(&token);
+    if (snap && snap->body) {
+        send_cached(c, snap);
+    } else {
+        json_t* err = json_pack("{s:s}", "error", "Parameters not available");
+        send_json(c, 503, err);
+        json_decref(err);
+    }
+    param_cache_read_unlock(token);
+    return 1;
+}
+
+/* ---------- Jobs ---------- */
+
+// Parameter writes handed to the job thread, the strings are owned by the job
+struct param_write {
+    size_t n;
+    char* names[G_N_ELEMENTS(g_params)];
+    char* values[G_N_ELEMENTS(g_params)];
+};
+
+static void FreeParamWrite(gpointer data) {
+    struct param_write* w = data;
+    for (size_t i = 0; i < w->n; i++) { g_free(w->names[i]); g_free(w->values[i]); }
+    g_free(w);
+}
+
+// Job for /param: independent writes, reports whether any was stored
+static json_t* RunParamWrite(void* arg, int* status) {
+    struct param_write* w = arg;
+    bool stored[G_N_ELEMENTS(g_params)];
+    bool changed = false;
 
     pthread_mutex_lock(&g_param_mtx);
-    char* addr = get_param_dup("MulticastAddress");
-    char* port = get_param_dup("MulticastPort");
+    for (size_t i = 0; i < w->n; i++) stored[i] = set_param(w->names[i], w->values[i]);
     pthread_mutex_unlock(&g_param_mtx);
 
-    if (addr) { json_object_set_new(out, "MulticastAddress", json_string(addr)); g_free(addr); }
-    else      { json_object_set_new(out, "MulticastAddress", json_null()); }
+    // set_param skips the callbacks, so update the cache for what was stored
+    for (size_t i = 0; i < w->n; i++) {
+        if (!stored[i]) continue;
+        param_cache_update(w->names[i], w->values[i]);
+        changed = true;
+    }
 
-    if (port) { json_object_set_new(out, "MulticastPort", json_string(port)); g_free(port); }
-    else      { json_object_set_new(out, "MulticastPort", json_null()); }
+    *status = 200;
+    return json_pack("{s:b,s:b}", "ok", 1, "changed", changed);
+}
 
-    json_object_set_new(out, "ok", json_true());
-    send_json(c, 200, out);
-    json_decref(out);
+// Job for /batch: all values or none, validated before the job was queued
+static json_t* RunBatchWrite(void* arg, int* status) {
+    struct param_write* w = arg;
+    const char* const* names = (const char* const*)w->names;
+    const char* const* values = (const char* const*)w->values;
+    size_t failed = 0;
+
+    /*
+     * The sync reports every value to the change callbacks. They wait until
+     * the batch is published and then find nothing new, so readers and the
+     * rate limiter see one change for the whole batch.
+     */
+    pthread_mutex_lock(&g_limits_mtx);
+    param_cache_begin_batch();
+    bool applied = param_batch_apply(g_param, &g_param_mtx, names, values, w->n, &failed);
+    param_cache_end_batch(applied ? names : NULL, values, w->n);
+    if (applied) update_limits(names, values, w->n);
+    pthread_mutex_unlock(&g_limits_mtx);
+
+    if (!applied) {
+        *status = 500;
+        return json_pack("{s:b,s:s,s:s}", "ok", 0,
+                         "error", "Failed to set parameter, batch rolled back",
+                         "param", w->names[failed]);
+    }
+
+    *status = 200;
+    return json_pack("{s:b,s:I}", "ok", 1, "applied", (json_int_t)w->n);
+}
+
+static void send_accepted(struct mg_connection* c, unsigned long id, enum job_state state) {
+    json_t* res = json_pack("{s:b,s:I,s:s}", "ok", 1, "job", (json_int_t)id, "state", job_state_name(state));
+    char* body = json_dumps(res, JSON_COMPACT);
+    size_t len = body ? strlen(body) : 0;
+
+    mg_printf(c,
+              "HTTP/1.1 202 Accepted\r\n"
+              "Content-Type: application/json\r\n"
+              "Content-Length: %zu\r\n"
+              "Location: " JOBS_PATH "/%lu\r\n"
+              "Cache-Control: no-store\r\n\r\n",
+              len, id);
+    mg_write(c, body, len);
+    free(body);
+    json_decref(res);
+}
+
+/*
+ * Queue the write and wait a bounded time for it. A quick write is answered
+ * like before, a slow one with 202 and the job to poll, so slow D-Bus calls
+ * never hold the CivetWeb workers for long.
+ */
+static int RunJob(struct mg_connection* c, job_func fn, struct param_write* w) {
+    unsigned long id = job_queue_submit(fn, w, FreeParamWrite);
+    if (!id) {
+        FreeParamWrite(w);
+        json_t* err = json_pack("{s:s}", "error", "Too many pending jobs");
+        send_json(c, 503, err);
+        json_decref(err);
+        return 1;
+    }
+
+    const char* query = mg_get_request_info(c)->query_string;
+    char wait[16];
+    unsigned long wait_ms = JOB_WAIT_MS;
+    if (query && mg_get_var(query, strlen(query), "wait", wait, sizeof(wait)) > 0) wait_ms = strtoul(wait, NULL, 10);
+    if (wait_ms > JOB_MAX_WAIT_MS) wait_ms = JOB_MAX_WAIT_MS;
+
+    int status = 0;
+    json_t* result = NULL;
+    enum job_state state = job_queue_wait(id, (unsigned)wait_ms);
+    if (state == JOB_DONE && job_queue_result(id, &status, &result) == JOB_DONE) {
+        send_json(c, status, result);
+        json_decref(result);
+    } else {
+        send_accepted(c, id, state);
+    }
     return 1;
 }
 
@@ -129,77 +425,153 @@ static int InfoHandler(struct mg_connection* c, void* ud __attribute__((unused))
 static int ParamHandler(struct mg_connection* c, void* ud __attribute__((unused))) {
     if (strcmp(mg_get_request_info(c)->request_method, "POST") != 0) return 0;
 
-    char* body = read_body(c);
-    if (!body) {
-        json_t* err = json_pack("{s:s}", "error", "Missing or empty body");
-        send_json(c, 400, err);
-        json_decref(err);
-        return 1;
+    json_t* root = read_json_body(c);
+    if (!root) return 1;
+
+    struct param_write* w = g_new0(struct param_write, 1);
+    for (size_t i = 0; i < G_N_ELEMENTS(g_cached_params); i++) {
+        const json_t* jval = json_object_get(root, g_cached_params[i]);
+        if (!jval || !json_is_string(jval)) continue;
+        w->names[w->n] = g_strdup(g_cached_params[i]);
+        w->values[w->n] = g_strdup(json_string_value(jval));
+        w->n++;
     }
+    json_decref(root);
 
-    json_error_t jerr;
-    json_t* root = json_loads(body, 0, &jerr);
-    free(body);
+    return RunJob(c, RunParamWrite, w);
+}
+
+// POST /batch: any number of declared parameters, validated, applied as one change
+static int BatchHandler(struct mg_connection* c, void* ud __attribute__((unused))) {
+    if (strcmp(mg_get_request_info(c)->request_method, "POST") != 0) return 0;
+
+    json_t* root = read_json_body(c);
+    if (!root) return 1;
 
-    if (!root || !json_is_object(root)) {
-        if (root) json_decref(root);
-        json_t* err = json_pack("{s:s}", "error", "Invalid JSON");
+    if (json_object_size(root) == 0) {
+        json_decref(root);
+        json_t* err = json_pack("{s:s}", "error", "Expected a non-empty JSON object");
         send_json(c, 400, err);
         json_decref(err);
         return 1;
     }
 
-    const json_t* jAddr = json_object_get(root, "MulticastAddress");
-    const json_t* jPort = json_object_get(root, "MulticastPort");
+    const char* names[G_N_ELEMENTS(g_params)];
+    const char* values[G_N_ELEMENTS(g_params)];
+    char int_bufs[G_N_ELEMENTS(g_params)][32];
+    size_t n = 0;
+    json_t* errors = json_object();
+
+    const char* key;
+    json_t* jval;
+    json_object_foreach(root, key, jval) {
+        const struct param_decl* decl = param_decl_find(g_params, G_N_ELEMENTS(g_params), key);
+        const char* value = NULL;
+        const char* reason = NULL;
+
+        if (!decl) { json_object_set_new(errors, key, json_string("unknown parameter")); continue; }
+
+        if (json_is_string(jval)) {
+            value = json_string_value(jval);
+        } else if (json_is_integer(jval)) {
+            snprintf(int_bufs[n], sizeof(int_bufs[n]), "%" JSON_INTEGER_FORMAT, json_integer_value(jval));
+            value = int_bufs[n];
+        } else {
+            json_object_set_new(errors, key, json_string("must be a string or an integer"));
+            continue;
+        }
 
-    bool changed = false;
-    pthread_mutex_lock(&g_param_mtx);
-    if (jAddr && json_is_string(jAddr)) {
-        const char* s = json_string_value(jAddr);
-        changed |= set_param("MulticastAddress", s);
+        if (!param_decl_validate(decl, value, &reason)) {
+            json_object_set_new(errors, key, json_string(reason));
+            continue;
+        }
+        names[n] = decl->name;
+        values[n] = value;
+        n++;
     }
-    if (jPort && json_is_string(jPort)) {
-        const char* s = json_string_value(jPort);
-        changed |= set_param("MulticastPort", s);
+
+    if (json_object_size(errors) > 0) {
+        json_t* res = json_pack("{s:b,s:O}", "ok", 0, "errors", errors);
+        send_json(c, 400, res);
+        json_decref(res);
+        json_decref(errors);
+        json_decref(root);
+        return 1;
     }
-    pthread_mutex_unlock(&g_param_mtx);
+    json_decref(errors);
 
-    json_t* res = json_object();
-    json_object_set_new(res, "ok", json_true());
-    json_object_set_new(res, "changed", changed ? json_true() : json_false());
-    send_json(c, 200, res);
+    // Validated here, written on the job thread
+    struct param_write* w = g_new0(struct param_write, 1);
+    for (size_t i = 0; i < n; i++) {
+        w->names[i] = g_strdup(names[i]);
+        w->values[i] = g_strdup(values[i]);
+    }
+    w->n = n;
+    json_decref(root);
+
+    return RunJob(c, RunBatchWrite, w);
+}
 
+// GET /jobs/<id>: state of a queued write, and its result once done
+static int JobHandler(struct mg_connection* c, void* ud __attribute__((unused))) {
+    if (strcmp(mg_get_request_info(c)->request_method, "GET") != 0) return 0;
+
+    const char* uri = mg_get_request_info(c)->local_uri;
+    const char* slash = strrchr(uri, '/');
+    char* end = NULL;
+    unsigned long id = slash ? strtoul(slash + 1, &end, 10) : 0;
+
+    int status = 0;
+    json_t* result = NULL;
+    enum job_state state = (id && end && *end == '\0') ? job_queue_result(id, &status, &result) : JOB_UNKNOWN;
+    if (state == JOB_UNKNOWN) {
+        json_t* err = json_pack("{s:s}", "error", "Unknown or expired job");
+        send_json(c, 404, err);
+        json_decref(err);
+        return 1;
+    }
+
+    json_t* res = json_pack("{s:I,s:s}", "job", (json_int_t)id, "state", job_state_name(state));
+    if (state == JOB_DONE) {
+        json_object_set_new(res, "status", json_integer(status));
+        json_object_set_new(res, "result", result);
+    }
+    send_json(c, 200, res);
     json_decref(res);
-    json_decref(root);
     return 1;
 }
 
-// GET /
+// Paths no API handler takes. Browsers get html/ from the device, only api/ is proxied here
 static int RootHandler(struct mg_connection* c, void* ud __attribute__((unused))) {
-    // Serve html/index.html (same UI as web_parameter)
-    FILE* f = fopen("html/index.html", "r");
-    if (!f) {
-        mg_printf(c, "HTTP/1.1 500 Internal Server Error\r\n\r\n");
+    gchar* body = NULL;
+    gsize len = 0;
+    if (!g_file_get_contents("html/index.html", &body, &len, NULL)) {
+        mg_printf(c, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n");
         return 1;
     }
-    mg_printf(c, "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nConnection: close\r\n\r\n");
-    char buf[4096];
-    size_t n;
-    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
-        mg_write(c, buf, n);
-    }
-    fclose(f);
+    mg_printf(c, "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: %zu\r\n\r\n", (size_t)len);
+    mg_write(c, body, len);
+    g_free(body);
     return 1;
 }
 
+// Value of a declared parameter, or its default if it cannot be read
+static char* get_option(const char* name) {
+    GError* err = NULL;
+    char* value = NULL;
+    if (!ax_parameter_get(g_param, name, &value, &err)) {
+        syslog(LOG_WARNING, "get(%s) failed: %s", name, err ? err->message : "unknown");
+        g_clear_error(&err);
+        value = g_strdup(param_decl_find(g_params, G_N_ELEMENTS(g_params), name)->def);
+    }
+    return value;
+}
+
 /* ---------- main ---------- */
 int main(void) {
     openlog(APP_NAME, LOG_PID, LOG_USER);
     syslog(LOG_INFO, "Starting %s (CivetWeb reverse-proxy backend)", APP_NAME);
 
-    signal(SIGTERM, on_signal);
-    signal(SIGINT,  on_signal);
-
     // Init AXParameter
     GError* gerr = NULL;
     g_param = ax_parameter_new(APP_NAME, &gerr);
@@ -207,26 +579,70 @@ int main(void) {
 
     // Ensure parameters exist (idempotent)
     pthread_mutex_lock(&g_param_mtx);
-    if (!add_if_missing("MulticastAddress", "224.0.0.1", "string")) panic("add MulticastAddress failed");
-    if (!add_if_missing("MulticastPort",   "1024",      "string")) panic("add MulticastPort failed");
+    for (size_t i = 0; i < G_N_ELEMENTS(g_params); i++) {
+        if (!add_if_missing(g_params[i].name, g_params[i].def, g_params[i].meta))
+            panic("add %s failed", g_params[i].name);
+    }
+    pthread_mutex_unlock(&g_param_mtx);
+
+    if (!param_cache_init(g_param, &g_param_mtx, g_cached_params, G_N_ELEMENTS(g_cached_params), RenderInfo))
+        panic("Failed to set up parameter cache");
+
+    // Parameter writes run here, not on the CivetWeb workers
+    if (!job_queue_start())
+        panic("Failed to start job queue");
+
+    // Start CivetWeb, options come from parameters and apply after a restart
+    pthread_mutex_lock(&g_param_mtx);
+    for (size_t i = 0; i < G_N_ELEMENTS(g_limit_params); i++) {
+        char* value = get_option(g_limit_params[i]);
+        g_limits[i] = (unsigned)atoi(value);
+        g_free(value);
+        if (!ax_parameter_register_callback(g_param, g_limit_params[i], OnLimitChanged, NULL, &gerr)) {
+            syslog(LOG_WARNING, "callback for %s failed: %s", g_limit_params[i], gerr ? gerr->message : "unknown");
+            g_clear_error(&gerr);
+        }
+    }
+    char* keep_alive = get_option("KeepAlive");
+    char* num_threads = get_option("NumThreads");
+    char* timeout_ms = get_option("RequestTimeoutMs");
     pthread_mutex_unlock(&g_param_mtx);
 
-    // Start CivetWeb
-    const char* opts[] = {"listening_ports", PORT, "request_timeout_ms", "10000", "num_threads", "4", 0};
+    const char* opts[] = {"listening_ports",       PORT,
+                          "request_timeout_ms",    timeout_ms,
+                          "num_threads",           num_threads,
+                          "enable_keep_alive",     keep_alive,
+                          "keep_alive_timeout_ms", KEEP_ALIVE_TIMEOUT_MS,
+                          0};
     mg_init_library(0);
+    rate_limit_configure(g_limits[0], g_limits[1], g_limits[2]);
     struct mg_callbacks cb; memset(&cb, 0, sizeof(cb));
+    cb.begin_request = BeginRequest;
+    cb.end_request = EndRequest;
     struct mg_context* ctx = mg_start(&cb, NULL, opts);
     if (!ctx) panic("Failed to start CivetWeb on %s", PORT);
-    syslog(LOG_INFO, "CivetWeb listening on %s", PORT);
+    syslog(LOG_INFO, "CivetWeb listening on %s, %s threads, keep-alive %s", PORT, num_threads, keep_alive);
+    g_free(keep_alive);
+    g_free(num_threads);
+    g_free(timeout_ms);
 
     // Route handlers (proxy strips /local/my_web_server)
     mg_set_request_handler(ctx, "/",               RootHandler,  NULL);
-    mg_set_request_handler(ctx, "/local/web_proxy_thread/api/info",  InfoHandler,  NULL);
-    mg_set_request_handler(ctx, "/local/web_proxy_thread/api/param", ParamHandler, NULL);
+    mg_set_request_handler(ctx, INFO_PATH,  InfoHandler,  NULL);
+    mg_set_request_handler(ctx, PARAM_PATH, ParamHandler, NULL);
+    mg_set_request_handler(ctx, BATCH_PATH, BatchHandler, NULL);
+    mg_set_request_handler(ctx, JOBS_PATH,  JobHandler,   NULL);
 
-    while (running) sleep(1);
+    // The main loop delivers parameter change callbacks to the cache
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    g_unix_signal_add(SIGTERM, on_signal, loop);
+    g_unix_signal_add(SIGINT,  on_signal, loop);
+    g_main_loop_run(loop);
 
     mg_stop(ctx);
+    job_queue_stop();
+    g_main_loop_unref(loop);
+    param_cache_cleanup();
     ax_parameter_free(g_param);
     closelog();
     return EXIT_SUCCESS;
@@ -2,6 +2,7 @@
  * CivetWeb reverse-proxy backend with AXParameter + Jansson
  */
 #include "civetweb.h"
+#include "json_body.h"
 #include <axsdk/axparameter.h>
 #include <jansson.h>
 #include <glib-unix.h>
@@ -51,26 +52,36 @@ static void send_json(struct mg_connection* conn, int status, json_t* obj) {
     free(body);
 }
 
-static char* read_body(struct mg_connection* conn) { 
+static int conn_read(void* conn, char* buf, size_t len) {
 
-    const char* len_str = mg_get_header(conn, "Content-Length");
-    long len = len_str ? strtol(len_str, NULL, 10) : 0;
+    return mg_read((struct mg_connection*)conn, buf, len);
+}
 
-    if (len <= 0 || len > (1<<20)) 
-        return NULL;
+// Parse the body as a JSON object, or answer the request and return NULL
+static json_t* read_json_body(struct mg_connection* conn) {
 
-    char* buf = (char*)malloc((size_t)len + 1);
+    int status = 400;
+    const char* message = NULL;
 
-    if (!buf) 
-        return NULL;
+    json_t* root = json_body_load(conn_read, conn,
+                                  mg_get_header(conn, "Content-Length"),
+                                  mg_get_header(conn, "Transfer-Encoding"),
+                                  &status, &message);
 
-    long got = mg_read(conn, buf, (size_t)len);
+    if (root && !json_is_object(root)) {
+        json_decref(root);
+        root = NULL;
+        status = 400;
+        message = "Expected a JSON object";
+    }
 
-    if (got < 0) 
-        got = 0;
+    if (!root) {
+        json_t* error = json_pack("{s:s}", "error", message);
+        send_json(conn, status, error);
+        json_decref(error);
+    }
 
-    buf[got] = '\0';
-    return buf;
+    return root;
 }
 
 
@@ -135,31 +146,8 @@ static int ParamHandler(struct mg_connection* conn, void* ud __attribute__((unus
     if (strcmp(mg_get_request_info(conn)->request_method, "POST") != 0) 
         return 0;
 
-    char* body = read_body(conn);
-    if (!body) {
-
-        json_t* error = json_pack("{s:s}", "error", "Missing or empty body");
-
-        send_json(conn, 400, error);
-        json_decref(error);
-        return 1;
-    }
-
-    json_error_t jerror;
-    json_t* root = json_loads(body, 0, &jerror);
-    free(body);
-
-    if (!root || !json_is_object(root)) {
-        if (root) 
-            json_decref(root);
-
-        json_t* error = json_pack("{s:s}", "error", "Invalid JSON");
-        send_json(conn, 400, error);
-
-        json_decref(error);
-
-        return 1;
-    }
+    json_t* root = read_json_body(conn);
+    if (!root) return 1;
 
     const json_t* jAddr = json_object_get(root, "MulticastAddress");
     const json_t* jPort = json_object_get(root, "MulticastPort");